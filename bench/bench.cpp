@@ -0,0 +1,366 @@
+#include "../src/types.h"
+#include "../src/buffer.h"
+#include "../src/fileio.h"
+#include "../src/tokenizer.h"
+#include "../src/language.h"
+#include "../src/complete.h"
+#include "../src/globals.h"
+#include "bench_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* headless benchmarks for the buffer, file and tokenizer paths, no
+   window or gl context is created.
+
+   usage: codeze_bench [max file size in mb] [seed]
+
+   prints one json object per workload on stdout, the editor's own logs
+   go to stderr. files are generated
+   next to the executable and removed afterwards. the 1024mb file is
+   only generated when asked for explicitly. the tokenizer runs with the
+   c grammar when c.lang is found in the working directory.
+ */
+
+#define BENCH_DEFAULT_MAX_MB 64
+#define BENCH_TYPE_CHARS 1000000
+#define BENCH_CURSOR_JUMPS 100000
+#define BENCH_TOKENIZE_BYTES (4 * 1024 * 1024)
+#define BENCH_COMPLETE_WORDS 100000
+
+static b8 FirstResult = true;
+static FILE* Json;
+
+
+// allocation counting, the editor allocates through malloc directly so
+// the libc entry points are wrapped instead of operator new
+#ifdef LINUX_PLATFORM
+
+// the tokenizer, journal and follow threads allocate too
+static u64 Allocations;
+
+static inline void
+allocation_count() {
+
+	__atomic_fetch_add(&Allocations, 1, __ATOMIC_RELAXED);
+}
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+extern "C" void*
+malloc(size_t size) {
+
+	allocation_count();
+	return __libc_malloc(size);
+}
+
+extern "C" void*
+calloc(size_t count, size_t size) {
+
+	allocation_count();
+	return __libc_calloc(count, size);
+}
+
+extern "C" void*
+realloc(void* ptr, size_t size) {
+
+	allocation_count();
+	return __libc_realloc(ptr, size);
+}
+
+extern "C" void
+free(void* ptr) {
+
+	__libc_free(ptr);
+}
+
+static i64
+allocations_get() {
+
+	return (i64)__atomic_load_n(&Allocations, __ATOMIC_RELAXED);
+}
+
+#elif WINDOWS_PLATFORM
+
+static i64
+allocations_get() {
+
+	return -1;
+}
+
+#endif
+
+
+typedef struct BenchRun {
+
+	const char* name;
+	u64 start;
+	i64 allocations;
+
+} BenchRun;
+
+static BenchRun
+bench_begin(const char* name) {
+
+	BenchRun run;
+	run.name = name;
+	run.allocations = allocations_get();
+	run.start = bench_time_ns();
+
+	return run;
+}
+
+static void
+bench_end(BenchRun& run, sizet ops) {
+
+	u64 elapsed = bench_time_ns() - run.start;
+	i64 allocations = allocations_get();
+
+	if (allocations >= 0)
+		allocations -= run.allocations;
+
+	fprintf(Json, "%s{\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.2f, "
+		          "\"total_ms\": %.3f, \"allocations\": %lld, \"peak_rss_kb\": %lld}",
+		          FirstResult ? "[\n  " : ",\n  ",
+		          run.name, (unsigned long long)ops,
+		          ops ? (f64)elapsed / (f64)ops : 0.0,
+		          (f64)elapsed / 1000000.0,
+		          (long long)allocations, (long long)bench_peak_rss_kb());
+	fflush(Json);
+
+	FirstResult = false;
+}
+
+
+static void
+bench_typing() {
+
+	static Buffer typing;
+	typing = buffer_create_empthy();
+	CurBuffer = &typing;
+
+	BenchRun run = bench_begin("type_chars");
+
+	for (sizet i = 0; i < BENCH_TYPE_CHARS; ++i) {
+
+		if (i % 80 == 79)
+			buffer_insert_newline();
+		else
+			buffer_insert_char('a' + (char)(i % 26));
+	}
+
+	bench_end(run, BENCH_TYPE_CHARS);
+}
+
+static void
+bench_cursor_walk() {
+
+	// continues on the buffer typed by bench_typing
+	sizet length = buffer_length(CurBuffer);
+	i32 lines = CurBuffer->lineLengths.length;
+
+	BenchRun run = bench_begin("cursor_random_jump");
+
+	for (sizet i = 0; i < BENCH_CURSOR_JUMPS; ++i) {
+		buffer_set_cursor(CurBuffer, bench_random() % (length + 1));
+	}
+
+	bench_end(run, BENCH_CURSOR_JUMPS);
+
+	run = bench_begin("line_to_index");
+
+	sizet sum = 0;
+	for (sizet i = 0; i < BENCH_CURSOR_JUMPS; ++i) {
+		sum += buffer_index_based_on_line(CurBuffer, bench_random() % lines);
+	}
+
+	bench_end(run, BENCH_CURSOR_JUMPS);
+
+	run = bench_begin("index_to_line");
+
+	for (sizet i = 0; i < BENCH_CURSOR_JUMPS; ++i) {
+		sum += buffer_line_based_on_index(CurBuffer, bench_random() % (length + 1));
+	}
+
+	bench_end(run, BENCH_CURSOR_JUMPS);
+
+	buffer_free(CurBuffer);
+	CurBuffer = NULL;
+
+	// keeps the loops from being optimized out
+	if (sum == 0)
+		fprintf(stderr, "\n");
+}
+
+static void
+generate_file(const char* path, sizet bytes) {
+
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		fprintf(stderr, "failed to create %s \n", path);
+		return;
+	}
+
+	char line[128];
+	sizet written = 0;
+
+	while (written < bytes) {
+
+		i32 indent = bench_random() % 4;
+		i32 len = 0;
+
+		for (i32 i = 0; i < indent; ++i)
+			line[len++] = '\t';
+
+		i32 words = 1 + bench_random() % 8;
+		for (i32 w = 0; w < words; ++w) {
+
+			i32 wordLen = 1 + bench_random() % 10;
+			for (i32 i = 0; i < wordLen; ++i)
+				line[len++] = 'a' + bench_random() % 26;
+
+			line[len++] = ' ';
+		}
+		line[len++] = '\n';
+
+		fwrite(line, 1, len, fp);
+		written += len;
+	}
+
+	fclose(fp);
+}
+
+static void
+bench_files(sizet maxMb) {
+
+	const char* path = "codeze_bench_file.txt";
+	static char name[64];
+
+	for (sizet mb = 1; mb <= maxMb; mb *= 4) {
+
+		generate_file(path, mb * 1024 * 1024);
+
+		snprintf(name, sizeof(name), "file_open_%llumb", (unsigned long long)mb);
+		BenchRun run = bench_begin(name);
+
+		File file = file_open(path);
+		Buffer buf = buffer_create(file);
+
+		bench_end(run, 1);
+
+		CurBuffer = &buf;
+
+		snprintf(name, sizeof(name), "file_save_%llumb", (unsigned long long)mb);
+		run = bench_begin(name);
+
+		file_save();
+
+		bench_end(run, 1);
+
+		// the buffer owns file.buffer after buffer_create
+		buffer_free(&buf);
+
+		if (mb == maxMb)
+			break;
+
+		if (mb * 4 > maxMb)
+			mb = maxMb / 4;
+	}
+
+	remove(path);
+}
+
+static void
+bench_tokenize() {
+
+	static const char* lines[] = {
+		"#include \"buffer.h\"\n",
+		"static i32 counter = 42;\n",
+		"void\nfunction_name(Buffer* buf, i32 line) {\n",
+		"\t// comment about the loop below\n",
+		"\tfor (i32 i = 0; i < line; ++i) {\n",
+		"\t\tbuf->text[i] = \"string literal\";\n",
+		"\t}\n",
+		"\treturn;\n}\n\n",
+	};
+
+	String text = str_create((sizet)BENCH_TOKENIZE_BYTES + 256);
+	sizet lineCount = sizeof(lines) / sizeof(lines[0]);
+
+	while (text.length < BENCH_TOKENIZE_BYTES) {
+		const char* line = lines[bench_random() % lineCount];
+		while (*line)
+			str_push(&text, *line++);
+	}
+
+	Language* lang = language_load("c.lang");
+	if (!lang)
+		lang = language_plain();
+
+	BenchRun run = bench_begin("tokenize_4mb");
+
+	TokenStream tokens = tokens_make(text, lang);
+
+	bench_end(run, tokens.tokens.length);
+
+	tokens_free(&tokens);
+	str_free(&text);
+}
+
+static void
+bench_completion() {
+
+	completion_init();
+
+	char word[16];
+	BenchRun run = bench_begin("completion_add");
+
+	for (sizet i = 0; i < BENCH_COMPLETE_WORDS; ++i) {
+
+		i32 len = 3 + bench_random() % 10;
+		for (i32 c = 0; c < len; ++c)
+			word[c] = 'a' + bench_random() % 26;
+		word[len] = '\0';
+
+		String str = str_create(word);
+		completion_add(str);
+		str_free(&str);
+	}
+
+	bench_end(run, BENCH_COMPLETE_WORDS);
+
+	completion_reset();
+}
+
+
+i32
+main(int argc, char* argv[]) {
+
+	sizet maxMb = BENCH_DEFAULT_MAX_MB;
+
+	if (argc > 1)
+		maxMb = (sizet)atoi(argv[1]);
+
+	if (argc > 2)
+		bench_random_seed((u32)atoi(argv[2]));
+
+	if (maxMb == 0)
+		maxMb = 1;
+
+	Json = bench_json_stream();
+	buffers_init();
+
+	bench_typing();
+	bench_cursor_walk();
+	bench_files(maxMb);
+	bench_tokenize();
+	bench_completion();
+
+	fprintf(Json, "\n]\n");
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include "bench_util.h"
+
+#ifdef LINUX_PLATFORM
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#include <psapi.h>
+#include <io.h>
+#endif
+
+static u32 Seed = 1;
+
+u64
+bench_time_ns() {
+#ifdef LINUX_PLATFORM
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#elif WINDOWS_PLATFORM
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	QueryPerformanceCounter(&counter);
+
+	return (u64)((f64)counter.QuadPart * 1000000000.0 / (f64)frequency.QuadPart);
+#endif
+}
+
+i64
+bench_peak_rss_kb() {
+#ifdef LINUX_PLATFORM
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (i64)usage.ru_maxrss;
+#elif WINDOWS_PLATFORM
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+
+	return (i64)(counters.PeakWorkingSetSize / 1024);
+#endif
+}
+
+u32
+bench_random() {
+
+	// xorshift32, deterministic for a given seed
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+
+	return Seed;
+}
+
+void
+bench_random_seed(u32 seed) {
+
+	Seed = seed ? seed : 1;
+}
+
+// the editor logs with printf, so stdout is pointed at stderr and the
+// json is written to what stdout was before
+FILE*
+bench_json_stream() {
+
+	fflush(stdout);
+#ifdef LINUX_PLATFORM
+	i32 json = dup(fileno(stdout));
+	if (json < 0 || dup2(fileno(stderr), fileno(stdout)) < 0)
+		return stdout;
+
+	FILE* stream = fdopen(json, "w");
+#elif WINDOWS_PLATFORM
+	i32 json = _dup(_fileno(stdout));
+	if (json < 0 || _dup2(_fileno(stderr), _fileno(stdout)) < 0)
+		return stdout;
+
+	FILE* stream = _fdopen(json, "w");
+#endif
+
+	return stream ? stream : stdout;
+}
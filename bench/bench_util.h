@@ -0,0 +1,10 @@
+#pragma once
+#include "../src/types.h"
+
+#include <stdio.h>
+
+u64 bench_time_ns();
+i64 bench_peak_rss_kb();
+u32 bench_random();
+void bench_random_seed(u32 seed);
+FILE* bench_json_stream();
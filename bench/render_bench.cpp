@@ -0,0 +1,296 @@
+#include "../src/types.h"
+#include "../src/buffer.h"
+#include "../src/window.h"
+#include "../src/renderer.h"
+#include "../src/command.h"
+#include "../src/modes.h"
+#include "../src/tokenizer.h"
+#include "../src/language.h"
+#include "../src/syntax.h"
+#include "../src/globals.h"
+#include "bench_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* replays an edit session against a file and renders every step into
+   the in memory vertex batch, no window or gl context is created.
+
+   usage: codeze_render_bench <file> [session] [width] [height]
+
+   a session is a text file with one step per line:
+
+	   # comment
+	   [count] <command name> [arguments]
+	   [count] type <text>
+
+   command names are the ones used in config.txt, type inserts text at
+   the cursor with \n and \t escapes. every executed step renders one
+   frame. without a session file a scroll through the whole file is
+   replayed. grammars are loaded from the working directory like the
+   editor does from config.txt, lexing runs on the tokenizer thread as
+   in the editor so frame times only hold the main thread's share. the
+   json goes to stdout, the editor's own logs to stderr.
+ */
+
+#define RENDER_BENCH_FONT_SIZE 18
+#define SESSION_LINE_MAX 1024
+
+typedef struct FrameStats {
+
+	u64 ns;
+	RenderStats render;
+
+} FrameStats;
+
+static Array<FrameStats> Frames;
+static FILE* Json;
+
+
+static void
+frame_render() {
+
+	renderer_stats_reset();
+	u64 start = bench_time_ns();
+
+	renderer_begin();
+	window_render_all();
+	Modes[InputMod]->update();
+	renderer_end();
+
+	FrameStats frame;
+	frame.ns = bench_time_ns() - start;
+	frame.render = renderer_stats();
+
+	array_push(&Frames, frame);
+}
+
+static void
+session_type(const char* text) {
+
+	for (sizet i = 0; text[i] != '\0'; ++i) {
+
+		char c = text[i];
+		if (c == '\\' && text[i + 1] != '\0') {
+
+			i++;
+			if (text[i] == 'n') c = '\n';
+			else if (text[i] == 't') c = '\t';
+			else c = text[i];
+		}
+
+		if (c == '\n')
+			buffer_insert_newline();
+		else if (c == '\t')
+			buffer_insert_tab();
+		else
+			buffer_insert_char(c);
+	}
+}
+
+static void
+session_step(char* line) {
+
+	char* name = line;
+	while (*name == ' ' || *name == '\t')
+		name++;
+
+	if (*name == '#' || *name == '\0')
+		return;
+
+	i32 count = 1;
+	if (*name >= '0' && *name <= '9') {
+
+		count = atoi(name);
+		while (*name >= '0' && *name <= '9')
+			name++;
+		while (*name == ' ')
+			name++;
+	}
+
+	char* args = name;
+	while (*args != ' ' && *args != '\0')
+		args++;
+
+	if (*args == ' ')
+		*args++ = '\0';
+
+	if (cstr_equal(name, "type")) {
+
+		for (i32 i = 0; i < count; ++i) {
+			session_type(args);
+			frame_render();
+		}
+		return;
+	}
+
+	String cmdname = str_create(name);
+	Command* cmd = command_get(cmdname);
+	if (!cmd->cmd) {
+
+		fprintf(stderr, "unknown command in session: %s \n", name);
+		return;
+	}
+
+	List<char> argList;
+	list_init(&argList);
+	for (sizet i = 0; args[i] != '\0'; ++i)
+		list_add(&argList, args[i]);
+
+	for (i32 i = 0; i < count; ++i) {
+
+		if (cmd->minArgs == 0 || argList.head)
+			cmd->cmd(&argList);
+		frame_render();
+	}
+
+	list_free(&argList);
+}
+
+static void
+session_replay(const char* path) {
+
+	FILE* fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "failed to open session %s \n", path);
+		return;
+	}
+
+	char line[SESSION_LINE_MAX];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+
+		sizet len = strlen(line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+
+		session_step(line);
+	}
+
+	fclose(fp);
+}
+
+static void
+session_default() {
+
+	char down[] = "page-down";
+	char up[] = "page-up";
+	i32 pages = CurBuffer->lineLengths.length / window_visible_lines(FocusedWindow) + 1;
+
+	for (i32 i = 0; i < pages; ++i)
+		session_step(down);
+
+	for (i32 i = 0; i < pages; ++i)
+		session_step(up);
+}
+
+static int
+compare_ns(const void* a, const void* b) {
+
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+report() {
+
+	if (!Frames.length) {
+		fprintf(Json, "{\"frames\": []}\n");
+		return;
+	}
+
+	u64* sorted = (u64*)malloc(sizeof(u64) * Frames.length);
+	u64 totalNs = 0;
+	u64 totalVertices = 0;
+	u64 totalBytes = 0;
+	u64 totalFlushes = 0;
+
+	fprintf(Json, "{\"frames\": [\n");
+
+	for (sizet i = 0; i < Frames.length; ++i) {
+
+		FrameStats& f = Frames[i];
+		fprintf(Json, "  {\"cpu_us\": %.2f, \"vertices\": %u, \"draw_calls\": %u, "
+			          "\"flushes\": %u, \"bytes_uploaded\": %llu}%s\n",
+			          (f64)f.ns / 1000.0, f.render.vertices, f.render.drawCalls,
+			          f.render.flushes, (unsigned long long)f.render.bytesUploaded,
+			          i + 1 < Frames.length ? "," : "");
+
+		sorted[i] = f.ns;
+		totalNs += f.ns;
+		totalVertices += f.render.vertices;
+		totalBytes += f.render.bytesUploaded;
+		totalFlushes += f.render.flushes;
+	}
+
+	qsort(sorted, Frames.length, sizeof(u64), compare_ns);
+
+	fprintf(Json, "],\n\"summary\": {\"frames\": %llu, \"cpu_us_mean\": %.2f, "
+		          "\"cpu_us_p50\": %.2f, \"cpu_us_p99\": %.2f, \"cpu_us_max\": %.2f, "
+		          "\"vertices\": %llu, \"flushes\": %llu, \"bytes_uploaded\": %llu, "
+		          "\"peak_rss_kb\": %lld}}\n",
+		          (unsigned long long)Frames.length,
+		          (f64)totalNs / Frames.length / 1000.0,
+		          (f64)sorted[Frames.length / 2] / 1000.0,
+		          (f64)sorted[(Frames.length * 99) / 100] / 1000.0,
+		          (f64)sorted[Frames.length - 1] / 1000.0,
+		          (unsigned long long)totalVertices, (unsigned long long)totalFlushes,
+		          (unsigned long long)totalBytes, (long long)bench_peak_rss_kb());
+
+	free(sorted);
+}
+
+
+i32
+main(int argc, char* argv[]) {
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: codeze_render_bench <file> [session] [width] [height] \n");
+		return 1;
+	}
+
+	Json = bench_json_stream();
+
+	InputMod = MODE_NAVIGATION;
+	TheWidth = argc > 3 ? atoi(argv[3]) : 1024;
+	TheHeight = argc > 4 ? atoi(argv[4]) : 768;
+
+	renderer_initialize_headless(TheWidth, TheHeight, RENDER_BENCH_FONT_SIZE);
+	commands_init();
+	syntax_init(NULL);
+
+	language_load("c.lang");
+	language_load("python.lang");
+	language_load("markdown.lang");
+
+	File file = file_open(argv[1]);
+	if (!file.buffer)
+		return 1;
+
+	buffers_init();
+	CurBuffer = buffer_add(file);
+
+	windows_init(CurBuffer);
+
+	for (sizet i = 0; i < MODES_TOTAL; ++i) {
+		Modes[i]->on_init();
+	}
+
+	array_init(&Frames, 256);
+
+	// first frame with the file as opened
+	frame_render();
+
+	if (argc > 2)
+		session_replay(argv[2]);
+	else
+		session_default();
+
+	report();
+
+	syntax_shutdown();
+
+	return 0;
+}
@@ -65,3 +65,124 @@ project "codeze"
 		   defines {"NDEBUG"}
 		   optimize "On"
 		   
+
+
+project "codeze_bench"
+
+    kind "ConsoleApp"
+	language "C++"
+	staticruntime "on"
+
+	-- headless, only the modules that do not need a window or gl context
+	files {
+	   "bench/bench.cpp",
+	   "bench/bench_util.cpp",
+	   "src/buffer.cpp",
+	   "src/wrap.cpp",
+	   "src/tokenizer.cpp",
+	   "src/language.cpp",
+	   "src/syntax.cpp",
+	   "src/brackets.cpp",
+	   "src/fold.cpp",
+	   "src/complete.cpp",
+	   "src/journal.cpp",
+	   "src/largefile.cpp",
+	   "src/reload.cpp",
+	   "src/fileio.cpp",
+	   "src/my_string.cpp",
+	   "src/math.cpp",
+	   "src/globals.cpp"
+	}
+
+	targetdir "bin/"
+	objdir "bin/bench/"
+
+	filter "system:windows"
+
+	    links {"psapi.lib"}
+
+		defines {
+		   "WINDOWS_PLATFORM"
+		}
+
+
+	filter "system:linux"
+
+	    buildoptions {"-g", "-fPIC"}
+
+	    links {"m", "pthread"}
+
+		defines {
+		   "LINUX_PLATFORM"
+		}
+
+
+	filter "configurations:Debug"
+		   defines {"DEBUG"}
+		   optimize "Off"
+		   symbols "On"
+	
+	filter "configurations:Release"
+		   defines {"NDEBUG"}
+		   optimize "On"
+
+
+project "codeze_render_bench"
+
+    kind "ConsoleApp"
+	language "C++"
+	staticruntime "on"
+
+	-- the whole editor except main, rendering into the headless batch
+	files {
+	   "bench/render_bench.cpp",
+	   "bench/bench_util.cpp",
+	   "src/*.cpp",
+	   "src/*.h"
+	}
+
+	removefiles {
+	   "src/editor.cpp"
+	}
+
+	includedirs {
+	   "%{IncludeDir.glfw}",
+	   "%{IncludeDir.freetype}",
+	   "%{IncludeDir.glad}"
+	}
+
+	targetdir "bin/"
+	objdir "bin/render_bench/"
+
+	defines {
+	   "GLFW_INCLUDE_NONE"
+	}
+
+	filter "system:windows"
+
+	    links {"glad", "glfw", "freetype.lib", "opengl32.lib", "psapi.lib"}
+
+		defines {
+		   "WINDOWS_PLATFORM"
+		}
+
+
+	filter "system:linux"
+
+	    buildoptions {"-g", "-fPIC"}
+
+	    links {"glad", "glfw", "GL", "freetype", "dl", "pthread", "m"}
+
+		defines {
+		   "LINUX_PLATFORM"
+		}
+
+
+	filter "configurations:Debug"
+		   defines {"DEBUG"}
+		   optimize "Off"
+		   symbols "On"
+	
+	filter "configurations:Release"
+		   defines {"NDEBUG"}
+		   optimize "On"
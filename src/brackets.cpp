@@ -0,0 +1,425 @@
+#include "brackets.h"
+#include "buffer.h"
+#include "syntax.h"
+#include "debug.h"
+
+#include <string.h>
+
+#define BRACKET_STALE_MIN 16
+
+/* brackets are matched as a balanced sequence: opens are +1, closes -1.
+   the worker summarizes every line of a token set, edits after it splice
+   the line spans and mark the touched lines stale, only those are
+   summarized again from their own tokens. a query walks the rest of its
+   own line and then descends the tree to the one line that holds the
+   match, so it never looks at the lines in between.
+ */
+
+static i32
+bracket_delta(u8 type) {
+
+	switch (type) {
+	case TOK_OPEN_PAREN:
+	case TOK_OPEN_CURLY:
+	case TOK_OPEN_SQUARE:
+		return 1;
+	case TOK_CLOSED_PAREN:
+	case TOK_CLOSED_CURLY:
+	case TOK_CLOSED_SQUARE:
+		return -1;
+	}
+
+	return 0;
+}
+
+static BracketSpan
+span_of(Token* tokens, u32 count) {
+
+	BracketSpan span = {0, 0};
+
+	for (u32 i = 0; i < count; ++i) {
+
+		span.excess += bracket_delta(tokens[i].type);
+		if (span.excess < span.lowest)
+			span.lowest = span.excess;
+	}
+
+	return span;
+}
+
+static BracketSpan
+span_join(BracketSpan left, BracketSpan right) {
+
+	BracketSpan span;
+	span.excess = left.excess + right.excess;
+	span.lowest = left.excess + right.lowest < left.lowest ?
+		left.excess + right.lowest : left.lowest;
+
+	return span;
+}
+
+static void
+tree_build(BracketIndex* index) {
+
+	u32 leaves = 1;
+	while (leaves < index->lines.length)
+		leaves *= 2;
+
+	if (!index->tree.data)
+		array_init(&index->tree, leaves * 2);
+	while (index->tree.capacity < leaves * 2)
+		array_expand(&index->tree);
+
+	index->tree.length = leaves * 2;
+	index->leaves = leaves;
+
+	BracketSpan empty = {0, 0};
+	for (u32 i = 0; i < leaves; ++i)
+		index->tree.data[leaves + i] = i < index->lines.length ? index->lines.data[i] : empty;
+
+	for (u32 i = leaves - 1; i > 0; --i)
+		index->tree.data[i] = span_join(index->tree.data[i * 2], index->tree.data[i * 2 + 1]);
+
+	index->treeDirty = false;
+}
+
+static void
+span_set(BracketIndex* index, i32 line, BracketSpan span) {
+
+	index->lines.data[line] = span;
+	if (index->treeDirty) return;
+
+	u32 node = index->leaves + line;
+	index->tree.data[node] = span;
+
+	for (node /= 2; node > 0; node /= 2)
+		index->tree.data[node] = span_join(index->tree.data[node * 2], index->tree.data[node * 2 + 1]);
+}
+
+// first line at or after from where the depth, counted from the start of
+// from, drops below zero, depth is left at the start of that line
+static i32
+tree_forward(BracketIndex* index, u32 node, u32 low, u32 high, u32 from, i32* depth) {
+
+	if (high <= from) return -1;
+
+	BracketSpan* span = &index->tree.data[node];
+	if (low >= from && *depth + span->lowest >= 0) {
+		*depth += span->excess;
+		return -1;
+	}
+
+	if (high - low == 1)
+		return (i32)low;
+
+	u32 mid = (low + high) / 2;
+	i32 found = tree_forward(index, node * 2, low, mid, from, depth);
+	if (found >= 0)
+		return found;
+
+	return tree_forward(index, node * 2 + 1, mid, high, from, depth);
+}
+
+// last line before to that holds an open not closed again before to,
+// depth counts opens minus closes from the end of that line on
+static i32
+tree_backward(BracketIndex* index, u32 node, u32 low, u32 high, u32 to, i32* depth) {
+
+	if (low >= to) return -1;
+
+	// the highest depth a suffix reaches is the excess minus the lowest prefix
+	BracketSpan* span = &index->tree.data[node];
+	if (high <= to && *depth + span->excess - span->lowest <= 0) {
+		*depth += span->excess;
+		return -1;
+	}
+
+	if (high - low == 1)
+		return (i32)low;
+
+	u32 mid = (low + high) / 2;
+	i32 found = tree_backward(index, node * 2 + 1, mid, high, to, depth);
+	if (found >= 0)
+		return found;
+
+	return tree_backward(index, node * 2, low, mid, to, depth);
+}
+
+static void
+index_refresh(Buffer* buf, BracketIndex* index) {
+
+	for (sizet i = 0; i < index->stale.length; ++i) {
+
+		i32 line = index->stale.data[i];
+
+		u32 count;
+		Token* tokens = syntax_line(buf, line, buffer_index_based_on_line(buf, line), &count);
+		span_set(index, line, span_of(tokens, count));
+	}
+
+	array_reset(&index->stale);
+
+	if (index->treeDirty)
+		tree_build(index);
+}
+
+// first token of the line starting at or after offset
+static u32
+token_at(Token* tokens, u32 count, u32 offset) {
+
+	u32 low = 0;
+	u32 high = count;
+	while (low < high) {
+
+		u32 mid = (low + high) / 2;
+		if (tokens[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+// the close of the scope open at token from - 1 of the line
+static b8
+find_close(Buffer* buf, BracketIndex* index, i32 line, sizet lineStart,
+		   Token* tokens, u32 count, u32 from, sizet* out) {
+
+	i32 depth = 0;
+	for (u32 i = from; i < count; ++i) {
+
+		depth += bracket_delta(tokens[i].type);
+		if (depth < 0) {
+			*out = lineStart + tokens[i].offset;
+			return true;
+		}
+	}
+
+	i32 found = tree_forward(index, 1, 0, index->leaves, (u32)line + 1, &depth);
+	if (found < 0)
+		return false;
+
+	lineStart = buffer_index_based_on_line(buf, found);
+	tokens = syntax_line(buf, found, lineStart, &count);
+
+	for (u32 i = 0; i < count; ++i) {
+
+		depth += bracket_delta(tokens[i].type);
+		if (depth < 0) {
+			*out = lineStart + tokens[i].offset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// the innermost open of the line, or a line above it, not closed again
+// before token to
+static b8
+find_open(Buffer* buf, BracketIndex* index, i32 line, sizet lineStart,
+		  Token* tokens, u32 to, sizet* out) {
+
+	i32 depth = 0;
+	for (u32 i = to; i-- > 0;) {
+
+		depth += bracket_delta(tokens[i].type);
+		if (depth > 0) {
+			*out = lineStart + tokens[i].offset;
+			return true;
+		}
+	}
+
+	i32 found = tree_backward(index, 1, 0, index->leaves, (u32)line, &depth);
+	if (found < 0)
+		return false;
+
+	u32 count;
+	lineStart = buffer_index_based_on_line(buf, found);
+	tokens = syntax_line(buf, found, lineStart, &count);
+
+	for (u32 i = count; i-- > 0;) {
+
+		depth += bracket_delta(tokens[i].type);
+		if (depth > 0) {
+			*out = lineStart + tokens[i].offset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static BracketIndex*
+index_get(Buffer* buf) {
+
+	BracketIndex* index = syntax_brackets(buf);
+	if (!index) return NULL;
+
+	index_refresh(buf, index);
+	return index;
+}
+
+
+// one span per line of the token set, padded or cut to the line count of
+// the buffer the text came from
+Array<BracketSpan>
+brackets_lines(TokenStream* tokens, sizet lineCount) {
+
+	Array<BracketSpan> lines;
+	array_init(&lines, lineCount);
+
+	u32 tokenLines = tokens_line_count(tokens);
+	BracketSpan empty = {0, 0};
+
+	for (sizet line = 0; line < lineCount; ++line) {
+
+		if (line >= tokenLines) {
+			array_push(&lines, empty);
+			continue;
+		}
+
+		u32 first = tokens->lineFirst.data[line];
+		u32 count = tokens->lineFirst.data[line + 1] - first;
+		array_push(&lines, span_of(tokens->tokens.data + first, count));
+	}
+
+	return lines;
+}
+
+// takes the lines of a new token set, edits after its version are
+// followed again on the next query
+void
+brackets_reset(BracketIndex* index, Array<BracketSpan> lines, u32 version) {
+
+	if (index->lines.data)
+		array_free(&index->lines);
+
+	if (!index->stale.data)
+		array_init(&index->stale, BRACKET_STALE_MIN);
+
+	index->lines = lines;
+	index->version = version;
+	index->valid = true;
+	index->treeDirty = true;
+	array_reset(&index->stale);
+}
+
+void
+brackets_follow_edits(BracketIndex* index, Buffer* buf) {
+
+	if (!index->valid || index->version == buf->version)
+		return;
+
+	for (sizet i = 0; i < buf->edits.length; ++i) {
+
+		LineEdit* edit = &buf->edits[i];
+		if (edit->version <= index->version)
+			continue;
+
+		// the log overflowed, nothing is known until the next token set
+		if (edit->line < 0 || edit->line + edit->removed > (i32)index->lines.length) {
+			index->valid = false;
+			return;
+		}
+
+		sizet length = index->lines.length - edit->removed + edit->added;
+		while (index->lines.capacity < length)
+			array_expand(&index->lines);
+
+		BracketSpan* at = index->lines.data + edit->line;
+		memmove(at + edit->added, at + edit->removed,
+				(index->lines.length - edit->line - edit->removed) * sizeof(BracketSpan));
+		memset(at, 0, edit->added * sizeof(BracketSpan));
+		index->lines.length = length;
+
+		// stale lines below the edit move with it, the ones it replaced
+		// are pushed again as its added lines
+		sizet kept = 0;
+		for (sizet s = 0; s < index->stale.length; ++s) {
+
+			i32 line = index->stale.data[s];
+			if (line >= edit->line + edit->removed)
+				line += edit->added - edit->removed;
+			else if (line >= edit->line)
+				continue;
+
+			index->stale.data[kept++] = line;
+		}
+		index->stale.length = kept;
+
+		for (i32 line = 0; line < edit->added; ++line)
+			array_push(&index->stale, edit->line + line);
+
+		if (edit->removed != edit->added)
+			index->treeDirty = true;
+	}
+
+	index->version = buf->version;
+
+	if (index->lines.length != buf->lineLengths.length)
+		index->valid = false;
+}
+
+void
+brackets_free(BracketIndex* index) {
+
+	if (index->lines.data)
+		array_free(&index->lines);
+	if (index->stale.data)
+		array_free(&index->stale);
+	if (index->tree.data)
+		array_free(&index->tree);
+
+	memset(index, 0, sizeof(BracketIndex));
+}
+
+// the bracket matching the one at index, false when there is none there
+// or it is unbalanced
+b8
+brackets_match(Buffer* buf, sizet index, sizet* match) {
+
+	BracketIndex* brackets = index_get(buf);
+	if (!brackets) return false;
+
+	i32 line = buffer_line_based_on_index(buf, index);
+	sizet lineStart = buffer_index_based_on_line(buf, line);
+
+	u32 count;
+	Token* tokens = syntax_line(buf, line, lineStart, &count);
+
+	u32 at = token_at(tokens, count, (u32)(index - lineStart));
+	if (at == count || tokens[at].offset != index - lineStart)
+		return false;
+
+	i32 delta = bracket_delta(tokens[at].type);
+
+	if (delta > 0)
+		return find_close(buf, brackets, line, lineStart, tokens, count, at + 1, match);
+	if (delta < 0)
+		return find_open(buf, brackets, line, lineStart, tokens, at, match);
+
+	return false;
+}
+
+// innermost pair of brackets around index, an open bracket at index
+// starts a scope inside of it
+b8
+brackets_enclosing(Buffer* buf, sizet index, sizet* open, sizet* close) {
+
+	BracketIndex* brackets = index_get(buf);
+	if (!brackets) return false;
+
+	i32 line = buffer_line_based_on_index(buf, index);
+	sizet lineStart = buffer_index_based_on_line(buf, line);
+
+	u32 count;
+	Token* tokens = syntax_line(buf, line, lineStart, &count);
+
+	u32 before = token_at(tokens, count, (u32)(index - lineStart));
+	if (!find_open(buf, brackets, line, lineStart, tokens, before, open))
+		return false;
+
+	return brackets_match(buf, *open, close);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "types.h"
+#include "container.h"
+#include "tokenizer.h"
+
+struct Buffer;
+
+// depth change over a run of brackets and the lowest depth reached inside
+// it, opens count +1 and closes -1 whatever their kind
+typedef struct BracketSpan {
+
+	i32 excess;
+	// lowest depth of any prefix, the empty one included so never above 0
+	i32 lowest;
+
+} BracketSpan;
+
+// one span per line and a min excess tree over them, a matching bracket is
+// found by descending the tree to the line where the depth first drops
+// and scanning only that line's tokens
+typedef struct BracketIndex {
+
+	// buffer version the lines are up to date with
+	u32 version;
+	b8 valid;
+
+	Array<BracketSpan> lines;
+	// lines edited since the token set, summarized again on the next query
+	Array<i32> stale;
+
+	// implicit tree, node 1 is the root, leaves start at leaves
+	Array<BracketSpan> tree;
+	u32 leaves;
+	// rebuilt lazily when lines are inserted or erased
+	b8 treeDirty;
+
+} BracketIndex;
+
+
+Array<BracketSpan> brackets_lines(TokenStream* tokens, sizet lineCount);
+void brackets_reset(BracketIndex* index, Array<BracketSpan> lines, u32 version);
+void brackets_follow_edits(BracketIndex* index, Buffer* buf);
+void brackets_free(BracketIndex* index);
+
+b8 brackets_match(Buffer* buf, sizet index, sizet* match);
+b8 brackets_enclosing(Buffer* buf, sizet index, sizet* open, sizet* close);
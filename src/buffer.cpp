@@ -3,18 +3,329 @@
 #include "math.h"
 #include "config.h"
 #include "globals.h"
+#include "wrap.h"
+#include "syntax.h"
+#include "fold.h"
+#include "journal.h"
+#include "largefile.h"
+#include "reload.h"
 
 #include <string.h>
 
 #define BUFFER_RESIZE_FACTOR 2
 #define BUFFER_EMPTHY_SIZE 20
+#define BUFFER_REGISTRY_MIN 64
+#define BUFFER_BUDGET_DEFAULT (512 * 1024 * 1024)
 
+// list members never move, a Buffer* stays valid as a handle for as long
+// as the buffer is open
 static List<Buffer> Buffers;
 
+// open addressing on the hash of the path, or of the name for buffers
+// without a file, the hash is computed once when the buffer is added
+typedef struct BufferSlot {
+
+	u32 hash;
+	Buffer* buffer;
+
+} BufferSlot;
+
+static Array<BufferSlot> Registry;
+static sizet RegistryCount;
+
+/* a buffer is resident while its text is in memory and dirty once edited
+   since it was read or saved. resident buffers that no window shows are
+   unloaded, least recently viewed first, when the text of all of them
+   goes over the budget. an unloaded buffer keeps its path, cursors, folds
+   and line count and reads its file again when it is shown.
+ */
+static sizet Budget = BUFFER_BUDGET_DEFAULT;
+static u64 ViewClock;
+
+static f32 CharAdvance[128];
+// bumped on every font load, invalidates all cached cursor positions
+static u32 FontGeneration = 1;
+
+static void
+line_index_build(Buffer* buf) {
+
+	sizet count = buf->lineLengths.length;
+
+	array_reset(&buf->lineIndex);
+	while (buf->lineIndex.capacity < count + 1)
+		array_expand(&buf->lineIndex);
+
+	buf->lineIndex.length = count + 1;
+	buf->lineIndex.data[0] = 0;
+	for (sizet i = 1; i <= count; ++i)
+		buf->lineIndex.data[i] = buf->lineLengths.data[i - 1];
+
+	for (sizet i = 1; i <= count; ++i) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->lineIndex.data[parent] += buf->lineIndex.data[i];
+	}
+
+	buf->lineIndexDirty = false;
+}
+
+// rebuilds the nodes after line once lines were inserted or erased there,
+// a node before it only covers lines before it and stays. the nodes before
+// line with a parent after it are the ones a prefix query of line walks.
+static void
+line_index_shift(Buffer* buf, i32 line) {
+
+	if (buf->lineIndexDirty) return;
+
+	sizet count = buf->lineLengths.length;
+	while (buf->lineIndex.capacity < count + 1)
+		array_expand(&buf->lineIndex);
+	buf->lineIndex.length = count + 1;
+
+	for (sizet i = line + 1; i <= count; ++i)
+		buf->lineIndex.data[i] = buf->lineLengths.data[i - 1];
+
+	for (sizet i = line; i > 0; i -= i & (~i + 1)) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->lineIndex.data[parent] += buf->lineIndex.data[i];
+	}
+
+	for (sizet i = line + 1; i <= count; ++i) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->lineIndex.data[parent] += buf->lineIndex.data[i];
+	}
+}
+
+static void
+line_index_add(Buffer* buf, i32 line, i32 delta) {
+
+	// a tree not built yet is built whole on the next query
+	if (buf->lineIndexDirty) return;
+
+	for (sizet i = line + 1; i < buf->lineIndex.length; i += i & (~i + 1))
+		buf->lineIndex.data[i] += delta;
+}
+
+// extends the tree by one line at the end
+static void
+line_index_push(Buffer* buf, i32 length) {
+
+	if (buf->lineIndexDirty) return;
+
+	// node i covers the lines after i minus its low bit, the walk down
+	// from i - 1 adds exactly those
+	sizet i = buf->lineIndex.length;
+	sizet low = i - (i & (~i + 1));
+	sizet sum = length;
+	for (sizet k = i - 1; k > low; k -= k & (~k + 1))
+		sum += buf->lineIndex.data[k];
+
+	array_push(&buf->lineIndex, sum);
+}
+
+static void
+column_cache_init(Buffer* buf) {
+
+	for (sizet i = 0; i < COLUMN_CACHE_SIZE; ++i) {
+
+		buf->columnCache[i].line = -1;
+		buf->columnCache[i].generation = 0;
+		buf->columnCache[i].checkpoints.data = NULL;
+	}
+}
+
+static void
+column_cache_reset(Buffer* buf) {
+
+	for (sizet i = 0; i < COLUMN_CACHE_SIZE; ++i)
+		buf->columnCache[i].line = -1;
+}
+
+static void
+column_cache_invalidate(Buffer* buf, i32 line) {
+
+	ColumnIndex* entry = &buf->columnCache[line % COLUMN_CACHE_SIZE];
+	if (entry->line == line)
+		entry->line = -1;
+}
+
+static ColumnIndex*
+column_index_get(Buffer* buf, i32 line) {
+
+	ColumnIndex* entry = &buf->columnCache[line % COLUMN_CACHE_SIZE];
+	if (entry->line == line && entry->generation == FontGeneration)
+		return entry;
+
+	if (entry->checkpoints.data)
+		array_reset(&entry->checkpoints);
+	else
+		array_init(&entry->checkpoints, 16);
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	i32 length = buf->lineLengths[line];
+	ColumnCheckpoint checkpoint = {0, 0.0f};
+
+	for (i32 i = 0; i < length; ++i) {
+
+		if (i % COLUMN_CHECKPOINT_STRIDE == 0)
+			array_push(&entry->checkpoints, checkpoint);
+
+		char c = buffer_char_at(buf, start + i);
+		checkpoint.column += c == '\t' ? TAB_SIZE : 1;
+		checkpoint.pixelX += buffer_char_advance(c);
+	}
+
+	entry->line = line;
+	entry->generation = FontGeneration;
+
+	return entry;
+}
+
+static u32
+key_hash(const char* key, sizet length) {
+
+	u32 hash = 2166136261u;
+	for (sizet i = 0; i < length; ++i) {
+		hash ^= (u8)key[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// path of a buffer on disk, its name otherwise
+static String*
+buffer_key(Buffer* buf) {
+
+	return buf->path.length ? &buf->path : &buf->name;
+}
+
+static Buffer*
+registry_find(const char* key, sizet length) {
+
+	u32 hash = key_hash(key, length);
+	sizet mask = Registry.length - 1;
+
+	for (sizet i = hash & mask;; i = (i + 1) & mask) {
+
+		BufferSlot* slot = &Registry.data[i];
+		if (!slot->buffer)
+			return NULL;
+
+		String* slotKey = buffer_key(slot->buffer);
+		if (slot->hash == hash && slotKey->length == length &&
+			memcmp(slotKey->data, key, length) == 0)
+			return slot->buffer;
+	}
+}
+
+static void
+registry_place(BufferSlot slot) {
+
+	sizet mask = Registry.length - 1;
+	sizet i = slot.hash & mask;
+	while (Registry.data[i].buffer)
+		i = (i + 1) & mask;
+
+	Registry.data[i] = slot;
+}
+
+static void
+registry_add(Buffer* buf) {
+
+	// kept under three quarters full so probes stay short
+	if ((RegistryCount + 1) * 4 > Registry.length * 3) {
+
+		Array<BufferSlot> old = Registry;
+		array_init(&Registry, old.length * 2);
+		Registry.length = old.length * 2;
+
+		for (sizet i = 0; i < old.length; ++i)
+			if (old.data[i].buffer)
+				registry_place(old.data[i]);
+
+		array_free(&old);
+	}
+
+	String* key = buffer_key(buf);
+	BufferSlot slot = {key_hash(key->data, key->length), buf};
+	registry_place(slot);
+	RegistryCount++;
+}
+
 void
 buffers_init() {
 	
 	list_init(&Buffers);
+
+	array_init(&Registry, BUFFER_REGISTRY_MIN);
+	Registry.length = BUFFER_REGISTRY_MIN;
+	RegistryCount = 0;
+}
+
+void
+buffers_get_all(Array<Buffer*>* buffers) {
+
+	array_init(buffers, 16);
+
+	for (Member<Buffer>* node = Buffers.head; node; node = node->next)
+		array_push(buffers, &node->data);
+}
+
+void
+buffers_set_font_advances(const f32* advances) {
+
+	memcpy(CharAdvance, advances, sizeof(CharAdvance));
+	FontGeneration++;
+}
+
+f32
+buffer_char_advance(char c) {
+
+	if ((u8)c >= 128)
+		return 0.0f;
+
+	return CharAdvance[(u8)c];
+}
+
+f32
+buffer_cursor_pixel_x(Buffer* buf) {
+
+	if (buf->cursorPixelGeneration != FontGeneration) {
+
+		sizet lineStart = buffer_index_based_on_line(buf, buf->currentLine);
+		buf->cursorPixelX = 0.0f;
+		for (sizet i = lineStart; i < buf->cursor; ++i)
+			buf->cursorPixelX += buffer_char_advance(buffer_char_at(buf, i));
+
+		buf->cursorPixelGeneration = FontGeneration;
+	}
+
+	return buf->cursorPixelX;
+}
+
+void
+buffer_cursor_pixel_set(Buffer* buf, f32 pixelX) {
+
+	buf->cursorPixelX = pixelX;
+	buf->cursorPixelGeneration = FontGeneration;
+}
+
+u32
+buffers_font_generation() {
+
+	return FontGeneration;
+}
+
+void
+buffer_cursor_pixel_invalidate(Buffer* buf) {
+
+	buf->cursorPixelGeneration = 0;
 }
 
 
@@ -37,23 +348,25 @@ get_filestr_from_path(String& filepath) {
 Buffer*
 buffer_add(File& file) {
 
-	String key = get_filestr_from_path(file.path);
-
-
-	Member<Buffer>* Node = Buffers.head;
-
-	while (Node) {
-		if (Node->data.path == file.path)  {
-			NORMAL_MSG("File already loaded : %s \n", file.path.as_cstr());
-			return &Node->data;
-		}
-
-		Node = Node->next;
+	Buffer* loaded = registry_find(file.path.data, file.path.length);
+	if (loaded) {
+		NORMAL_MSG("File already loaded : %s \n", file.path.as_cstr());
+		return loaded;
 	}
 
+	String key = get_filestr_from_path(file.path);
+
 	NORMAL_MSG("Added file: %s \n", file.path.as_cstr());
 	list_add(&Buffers, buffer_create(file));
 	Buffers.tail->data.name = str_create(key.as_cstr());
+	registry_add(&Buffers.tail->data);
+	Buffers.tail->data.lastViewed = ++ViewClock;
+	file_stamp(file.path.as_cstr(), &Buffers.tail->data.fileTime, &Buffers.tail->data.fileSize);
+	journal_replay(&Buffers.tail->data);
+	reload_watch(&Buffers.tail->data);
+
+	str_free(&key);
+	buffers_trim();
 
 	return &Buffers.tail->data;
 }
@@ -69,6 +382,7 @@ buffer_add_empthy() {
 
 	list_add(&Buffers, buffer_create_empthy());
 	Buffers.tail->data.name = str_create(bufferName);
+	registry_add(&Buffers.tail->data);
 
 	index++;
 }
@@ -78,23 +392,15 @@ buffer_add_empthy(const char* bufferName) {
 
 	list_add(&Buffers, buffer_create_empthy());
 	Buffers.tail->data.name = str_create(bufferName);
+	registry_add(&Buffers.tail->data);
 }
 
 
+// by path, or by name for buffers without a file
 Buffer*
 buffer_get(const char* key) {
 
-	String keystr = str_create(key);
-
-	Member<Buffer>* Node = Buffers.head;
-	while (Node) {
-		if (Node->data.path == key) 
-			return &Node->data;
-
-		Node = Node->next;
-	}
-
-	return NULL;
+	return registry_find(key, strlen(key));
 }
 
 
@@ -105,13 +411,39 @@ buffer_create(File& file) {
 
 	buf.preLen = 0;
 	buf.gapLen = 0;
+	buf.cursor = 0;
 	buf.cursorXtabed = 0;
 	buf.curX = 0;
 	buf.currentLine = 0;
+	buf.cursorPixelX = 0.0f;
+	buf.cursorPixelGeneration = FontGeneration;
 	buf.postLen = file.size;
 	buf.path = file.path;
+	buf.language = language_for_path(file.path.as_cstr());
+	buf.version = 0;
+	array_init(&buf.edits, 16);
+	buf.syntax = NULL;
+	buf.journal = NULL;
+	buf.large = NULL;
+	buf.followed = false;
+	array_init(&buf.folds, 4);
+	array_init(&buf.foldIndex, 2);
+	buf.foldIndexDirty = true;
+	buf.foldIndexStale = INT32_MAX;
 	array_init(&buf.lineLengths, file.lineCount);
 	array_init(&buf.cursorLines, file.lineCount);
+	array_init(&buf.lineIndex, file.lineCount + 1);
+	buf.lineIndexDirty = true;
+	column_cache_init(&buf);
+	buf.wrapCache = NULL;
+	array_init(&buf.cursors, 1);
+	array_init(&buf.views, 2);
+	buf.activeView = -1;
+	buf.state = BUFFER_RESIDENT;
+	buf.lastViewed = 0;
+	buf.lineCount = 0;
+	buf.fileTime = 0;
+	buf.fileSize = 0;
 
 	sizet i = 0;
 	// foreach line
@@ -146,7 +478,7 @@ buffer_create(File& file) {
 		buf.text = file.buffer;
 		buf.text = (char*)malloc(sizeof(char) * buf.size);
 
-		for (sizet i = buf.preLen; i < buf.size; i++) 
+		for (sizet i = 0; i < file.size; i++) 
 			buf.text[i + buf.gapLen] = file.buffer[i];
 
 		buf.text[buf.size - 1] = '\n';
@@ -171,12 +503,38 @@ buffer_create_empthy() {
 
 	buf.preLen = 0;
 	buf.gapLen = BUFFER_EMPTHY_SIZE;
+	buf.cursor = 0;
 	buf.cursorXtabed = 0;
 	buf.curX = 0;
 	buf.currentLine = 0;
+	buf.cursorPixelX = 0.0f;
+	buf.cursorPixelGeneration = FontGeneration;
 	buf.postLen = 0;
 	array_init(&buf.cursorLines, 1);
 	array_init(&buf.lineLengths, 1);
+	array_init(&buf.lineIndex, 2);
+	buf.lineIndexDirty = true;
+	column_cache_init(&buf);
+	buf.wrapCache = NULL;
+	array_init(&buf.cursors, 1);
+	array_init(&buf.views, 2);
+	buf.activeView = -1;
+	buf.state = BUFFER_RESIDENT;
+	buf.lastViewed = 0;
+	buf.lineCount = 0;
+	buf.fileTime = 0;
+	buf.fileSize = 0;
+	buf.language = language_plain();
+	buf.version = 0;
+	array_init(&buf.edits, 16);
+	buf.syntax = NULL;
+	buf.journal = NULL;
+	buf.large = NULL;
+	buf.followed = false;
+	array_init(&buf.folds, 4);
+	array_init(&buf.foldIndex, 2);
+	buf.foldIndexDirty = true;
+	buf.foldIndexStale = INT32_MAX;
 
 
 	array_push(&buf.lineLengths, 0);
@@ -192,23 +550,64 @@ buffer_create_empthy() {
 
 }
 
+// where pos ends up after deleteLen bytes at every one of the sorted
+// positions are replaced by insertLen bytes, a position inside a deleted
+// run goes to its start
+static sizet
+position_follow(sizet pos, const sizet* positions, sizet count,
+				sizet deleteLen, sizet insertLen) {
+
+	sizet low = 0;
+	sizet high = count;
+	while (low < high) {
+
+		sizet mid = (low + high) / 2;
+		if (positions[mid] < pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (!low) return pos;
+
+	i64 delta = (i64)insertLen - (i64)deleteLen;
+	sizet last = low - 1;
+
+	if (pos < positions[last] + deleteLen)
+		return positions[last] + last * delta;
+
+	return pos + low * delta;
+}
+
+// the cursors of views other than the active one are kept on the same
+// text across an edit
+static void
+views_follow(Buffer* buf, const sizet* positions, sizet count,
+			 sizet deleteLen, sizet insertLen) {
+
+	for (sizet i = 0; i < buf->views.length; ++i) {
+
+		BufferView* view = &buf->views[i];
+		if (!view->open || (i32)i == buf->activeView)
+			continue;
+
+		view->cursor = position_follow(view->cursor, positions, count, deleteLen, insertLen);
+		for (sizet k = 0; k < view->cursors.length; ++k)
+			view->cursors[k] = position_follow(view->cursors[k], positions, count,
+											   deleteLen, insertLen);
+	}
+}
+
 void
 buffer_forward() {
 	
-	CurBuffer->text[CurBuffer->preLen]
-		= CurBuffer->text[CurBuffer->preLen + CurBuffer->gapLen];
-	CurBuffer->preLen++;
-	CurBuffer->postLen--;
-
+	CurBuffer->cursor++;
 }
 
 void
 buffer_backward() {
 	
-	CurBuffer->text[CurBuffer->preLen + CurBuffer->gapLen - 1] = CurBuffer->text[CurBuffer->preLen - 1];
-	CurBuffer->preLen--;
-	CurBuffer->postLen++;
-
+	CurBuffer->cursor--;
 }
 
 String
@@ -216,13 +615,9 @@ buffer_get_text_copy(Buffer* buf) {
 	
 	String out = str_create(buf->preLen + buf->postLen);
 
-	for (sizet i = 0; i < buf->preLen; ++i) {
-		str_push(&out, buf->text[i]);
-	}
-
-	for (sizet i = buf->preLen; i + buf->gapLen < buf->size; ++i) {
-		str_push(&out, buf->text[i + buf->gapLen]);
-	}
+	memcpy(out.data, buf->text, buf->preLen);
+	memcpy(out.data + buf->preLen, buf->text + buf->preLen + buf->gapLen, buf->postLen);
+	out.length = buf->preLen + buf->postLen;
 
 	return out;
 
@@ -232,6 +627,11 @@ buffer_get_text_copy(Buffer* buf) {
 void
 buffer_insert_char(char c) {
 	
+	sizet at = CurBuffer->cursor;
+	journal_edit(CurBuffer, &at, 1, 0, &c, 1);
+	views_follow(CurBuffer, &at, 1, 0, 1);
+	buffer_move_gap(CurBuffer, at);
+
 	if (CurBuffer->gapLen == 0) {
 		
 		//sizet gap = CurBuffer->preLen + CurBuffer->postLen;
@@ -263,12 +663,19 @@ buffer_insert_char(char c) {
 
 	CurBuffer->text[CurBuffer->preLen] = c;
 	CurBuffer->preLen++;
+	CurBuffer->cursor++;
 	CurBuffer->cursorLines[CurBuffer->currentLine]++;
 	CurBuffer->lineLengths[CurBuffer->currentLine]++;
+	line_index_add(CurBuffer, CurBuffer->currentLine, 1);
+	column_cache_invalidate(CurBuffer, CurBuffer->currentLine);
+	wrap_cache_invalidate(CurBuffer, CurBuffer->currentLine);
 
 	CurBuffer->cursorXtabed++;
 	CurBuffer->curX++;
+	CurBuffer->cursorPixelX += buffer_char_advance(c);
 	CurBuffer->gapLen--;
+
+	buffer_edit(CurBuffer, CurBuffer->currentLine, 1, 1);
 }
 
 void
@@ -286,6 +693,8 @@ buffer_insert_newline() {
 	buffer_insert_char('\n');
 	array_insert(&CurBuffer->cursorLines, 0, CurBuffer->currentLine);
 	array_insert(&CurBuffer->lineLengths, 0, CurBuffer->currentLine);
+	column_cache_reset(CurBuffer);
+	wrap_cache_reset(CurBuffer);
 
 	if (CurBuffer->cursorLines[CurBuffer->currentLine] != CurBuffer->cursorXtabed) {
 
@@ -297,10 +706,14 @@ buffer_insert_newline() {
 		CurBuffer->lineLengths[CurBuffer->currentLine] -= splitLineLen;
 		CurBuffer->lineLengths[CurBuffer->currentLine + 1] += splitLineLen;
 	}
+	line_index_shift(CurBuffer, CurBuffer->currentLine);
+
+	buffer_edit(CurBuffer, CurBuffer->currentLine, 1, 2);
 
 	CurBuffer->currentLine++;
 	CurBuffer->cursorXtabed = 0;
 	CurBuffer->curX = 0;
+	CurBuffer->cursorPixelX = 0.0f;
 }
 
 sizet
@@ -312,7 +725,12 @@ buffer_length(Buffer* buf) {
 void
 buffer_backspace_delete() {
 	
-	if (CurBuffer->preLen == 0) return;
+	if (CurBuffer->cursor == 0 || CurBuffer->large) return;
+
+	sizet at = CurBuffer->cursor - 1;
+	journal_edit(CurBuffer, &at, 1, 1, "", 0);
+	views_follow(CurBuffer, &at, 1, 1, 0);
+	buffer_move_gap(CurBuffer, CurBuffer->cursor);
 
 #ifdef DEBUG
 	//	CurBuffer->text[CurBuffer->preLen] = '%';
@@ -320,14 +738,19 @@ buffer_backspace_delete() {
 
 	CurBuffer->preLen--;
 	CurBuffer->gapLen++;
+	CurBuffer->cursor--;
 
-	if (CurBuffer->text[CurBuffer->preLen] == '\n') {
+	b8 joined = CurBuffer->text[CurBuffer->preLen] == '\n';
+
+	if (joined) {
 
 		i32 delCurosrLine = CurBuffer->cursorLines[CurBuffer->currentLine];
 		i32 delLine = CurBuffer->lineLengths[CurBuffer->currentLine];
 
 		array_erase(&CurBuffer->cursorLines, CurBuffer->currentLine);
 		array_erase(&CurBuffer->lineLengths, CurBuffer->currentLine);
+		column_cache_reset(CurBuffer);
+		wrap_cache_reset(CurBuffer);
 
 		CurBuffer->currentLine--;
 
@@ -335,6 +758,10 @@ buffer_backspace_delete() {
 		CurBuffer->curX = CurBuffer->lineLengths[CurBuffer->currentLine];
 		CurBuffer->cursorLines[CurBuffer->currentLine] += delCurosrLine;
 		CurBuffer->lineLengths[CurBuffer->currentLine] += delLine;
+		line_index_shift(CurBuffer, CurBuffer->currentLine);
+
+		// cursor jumps to the end of the previous line
+		buffer_cursor_pixel_invalidate(CurBuffer);
 
 
 	}
@@ -343,11 +770,17 @@ buffer_backspace_delete() {
 		CurBuffer->cursorXtabed -= TAB_SIZE - 1;
 	}
 
+	CurBuffer->cursorPixelX -= buffer_char_advance(CurBuffer->text[CurBuffer->preLen]);
+
 	CurBuffer->cursorXtabed--;
 	CurBuffer->curX--;
 	CurBuffer->cursorLines[CurBuffer->currentLine]--;
 	CurBuffer->lineLengths[CurBuffer->currentLine]--;
+	line_index_add(CurBuffer, CurBuffer->currentLine, -1);
+	column_cache_invalidate(CurBuffer, CurBuffer->currentLine);
+	wrap_cache_invalidate(CurBuffer, CurBuffer->currentLine);
 
+	buffer_edit(CurBuffer, CurBuffer->currentLine, joined ? 2 : 1, 1);
 }
 
 
@@ -355,36 +788,707 @@ buffer_backspace_delete() {
 sizet
 buffer_index_based_on_line(Buffer* buf, i32 line) {
 
+	if (buf->lineIndexDirty)
+		line_index_build(buf);
+
+	if (line > (i32)buf->lineLengths.length)
+		line = buf->lineLengths.length;
+
 	sizet result = 0;
-	for (sizet i = 0; i < line; ++i) {
+	for (sizet i = line; i > 0; i -= i & (~i + 1)) {
 		
-		result += buf->lineLengths[i];
+		result += buf->lineIndex.data[i];
 	}
 
 	return result;
 }
 
+i32
+buffer_line_based_on_index(Buffer* buf, sizet index) {
+
+	if (buf->lineIndexDirty)
+		line_index_build(buf);
+
+	sizet count = buf->lineLengths.length;
+	sizet step = 1;
+	while (step * 2 <= count)
+		step *= 2;
+
+	// descend the tree looking for the last line starting at or before index
+	sizet line = 0;
+	for (; step > 0; step /= 2) {
+
+		if (line + step <= count && buf->lineIndex.data[line + step] <= index) {
+			line += step;
+			index -= buf->lineIndex.data[line];
+		}
+	}
+
+	if (line >= count && count > 0)
+		line = count - 1;
+
+	return (i32)line;
+}
+
+i32
+buffer_column_from_tabbed(Buffer* buf, i32 line, i32 tabbedX, i32* outTabbed) {
+
+	i32 maxCol = buf->lineLengths[line] - 1;
+	if (maxCol < 0)
+		maxCol = 0;
+
+	// no tabs on the line, tabbed and real columns are the same
+	if (buf->cursorLines[line] == buf->lineLengths[line]) {
+
+		i32 col = tabbedX < maxCol ? tabbedX : maxCol;
+		*outTabbed = col;
+		return col;
+	}
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	i32 col = 0;
+	i32 x = 0;
+	while (col < maxCol && x < tabbedX) {
+
+		if (buffer_char_at(buf, start + col) == '\t')
+			x += TAB_SIZE;
+		else
+			x++;
+		col++;
+	}
+
+	*outTabbed = x;
+	return col;
+}
+
+i32
+buffer_offset_at_column(Buffer* buf, i32 line, i32 column, i32* outColumn, f32* outPixelX) {
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	i32 length = buf->lineLengths[line];
+	i32 offset = 0;
+	i32 col = 0;
+	f32 pixelX = 0.0f;
+
+	if (column > 0 && length > COLUMN_CHECKPOINT_STRIDE) {
+
+		ColumnIndex* index = column_index_get(buf, line);
+
+		// last checkpoint at or before the column
+		sizet low = 0;
+		sizet high = index->checkpoints.length;
+		while (high - low > 1) {
+
+			sizet mid = (low + high) / 2;
+			if (index->checkpoints[mid].column <= column)
+				low = mid;
+			else
+				high = mid;
+		}
+
+		offset = low * COLUMN_CHECKPOINT_STRIDE;
+		col = index->checkpoints[low].column;
+		pixelX = index->checkpoints[low].pixelX;
+	}
+
+	sizet bufLength = buffer_length(buf);
+	while (offset < length && start + offset < bufLength) {
+
+		char c = buffer_char_at(buf, start + offset);
+		i32 width = c == '\t' ? TAB_SIZE : 1;
+		if (col + width > column)
+			break;
+
+		col += width;
+		pixelX += buffer_char_advance(c);
+		offset++;
+	}
+
+	*outColumn = col;
+	*outPixelX = pixelX;
+	return offset;
+}
+
+static void
+scan_to_offset(Buffer* buf, i32 line, i32 offset, i32* outColumn, f32* outPixelX) {
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	i32 i = 0;
+	i32 column = 0;
+	f32 pixelX = 0.0f;
+
+	if (buf->lineLengths[line] > COLUMN_CHECKPOINT_STRIDE) {
+
+		ColumnIndex* index = column_index_get(buf, line);
+		sizet checkpoint = offset / COLUMN_CHECKPOINT_STRIDE;
+		if (checkpoint >= index->checkpoints.length)
+			checkpoint = index->checkpoints.length - 1;
+
+		i = checkpoint * COLUMN_CHECKPOINT_STRIDE;
+		column = index->checkpoints[checkpoint].column;
+		pixelX = index->checkpoints[checkpoint].pixelX;
+	}
+
+	for (; i < offset; ++i) {
+
+		char c = buffer_char_at(buf, start + i);
+		if (c == '\t')
+			column += TAB_SIZE;
+		else
+			column++;
+		pixelX += buffer_char_advance(c);
+	}
+
+	*outColumn = column;
+	*outPixelX = pixelX;
+}
+
+i32
+buffer_column_at_offset(Buffer* buf, i32 line, i32 offset) {
+
+	i32 column;
+	f32 pixelX;
+	scan_to_offset(buf, line, offset, &column, &pixelX);
+
+	return column;
+}
+
+f32
+buffer_pixel_at_offset(Buffer* buf, i32 line, i32 offset) {
+
+	i32 column;
+	f32 pixelX;
+	scan_to_offset(buf, line, offset, &column, &pixelX);
+
+	return pixelX;
+}
+
+char
+buffer_char_at(Buffer* buf, sizet index) {
+
+	if (index < buf->preLen)
+		return buf->text[index];
+
+	return buf->text[index + buf->gapLen];
+}
+
 void
-buffer_switch(const char* key) {
-	
-	Member<Buffer>* Node = Buffers.head;
-	while (Node) {
-		if (Node->data.path == key) {
+buffer_move_gap(Buffer* buf, sizet index) {
 
-			CurBuffer = &Node->data;
+	if (index > buffer_length(buf))
+		index = buffer_length(buf);
+
+	if (index < buf->preLen) {
+
+		sizet count = buf->preLen - index;
+		memmove(buf->text + index + buf->gapLen, buf->text + index, count);
+		buf->preLen -= count;
+		buf->postLen += count;
+	}
+	else if (index > buf->preLen) {
+
+		sizet count = index - buf->preLen;
+		memmove(buf->text + buf->preLen, buf->text + buf->preLen + buf->gapLen, count);
+		buf->preLen += count;
+		buf->postLen -= count;
+	}
+}
+
+void
+buffer_rebuild_lines(Buffer* buf) {
+
+	array_reset(&buf->lineLengths);
+	array_reset(&buf->cursorLines);
+	array_push(&buf->lineLengths, 0);
+	array_push(&buf->cursorLines, 0);
+
+	sizet length = buffer_length(buf);
+	sizet line = 0;
+	for (sizet i = 0; i < length; ++i) {
+
+		char c = buffer_char_at(buf, i);
+		buf->lineLengths.data[line]++;
+		buf->cursorLines.data[line] += c == '\t' ? TAB_SIZE : 1;
+
+		if (c == '\n') {
+			array_push(&buf->lineLengths, 0);
+			array_push(&buf->cursorLines, 0);
+			line++;
 		}
-		Node = Node->next;
 	}
+
+	buf->lineIndexDirty = true;
+	column_cache_reset(buf);
+	wrap_cache_reset(buf);
+
+	buffer_set_cursor(buf, buf->cursor);
 }
 
+// replaces text at pos without touching the line tables, the caller
+// rebuilds them once after a run of these
+void
+buffer_splice(Buffer* buf, sizet pos, sizet deleteLen, const char* insert, sizet insertLen) {
+
+	buffer_move_gap(buf, pos);
+
+	if (deleteLen > buf->postLen)
+		deleteLen = buf->postLen;
+	buf->postLen -= deleteLen;
+	buf->gapLen += deleteLen;
+
+	if (buf->gapLen < insertLen) {
+
+		sizet size = buf->size * BUFFER_RESIZE_FACTOR;
+		if (size < buf->preLen + buf->postLen + insertLen)
+			size = buf->preLen + buf->postLen + insertLen + BUFFER_EMPTHY_SIZE;
+
+		buf->text = (char*)realloc(buf->text, sizeof(char) * size);
+		memmove(buf->text + size - buf->postLen, buf->text + buf->preLen + buf->gapLen, buf->postLen);
+		buf->gapLen = size - buf->preLen - buf->postLen;
+		buf->size = size;
+	}
+
+	memcpy(buf->text + buf->preLen, insert, insertLen);
+	buf->preLen += insertLen;
+	buf->gapLen -= insertLen;
+}
+
+void
+buffer_set_cursor(Buffer* buf, sizet index) {
+
+	if (index > buffer_length(buf))
+		index = buffer_length(buf);
+
+	buf->cursor = index;
+	buf->currentLine = buffer_line_based_on_index(buf, buf->cursor);
+	buf->curX = buf->cursor - buffer_index_based_on_line(buf, buf->currentLine);
+	buf->cursorXtabed = buffer_column_at_offset(buf, buf->currentLine, buf->curX);
+	buffer_cursor_pixel_invalidate(buf);
+}
+
+// gap has to be at the end of the text
+static void
+buffer_reserve(Buffer* buf, sizet length) {
+
+	if (length < buf->size) return;
+
+	sizet size = buf->size * BUFFER_RESIZE_FACTOR;
+	if (size <= length)
+		size = length + BUFFER_EMPTHY_SIZE;
+
+	buf->text = (char*)realloc(buf->text, sizeof(char) * size);
+	buf->gapLen += size - buf->size;
+	buf->size = size;
+}
+
+// adds text read from outside at the end, the lines it extends and adds
+// are counted in place, the buffer still matches its file after
+void
+buffer_append(Buffer* buf, const char* text, sizet length) {
+
+	if (!length) return;
+
+	sizet end = buffer_length(buf);
+	buffer_move_gap(buf, end);
+	buffer_reserve(buf, end + length);
+
+	memcpy(buf->text + buf->preLen, text, length);
+	buf->preLen += length;
+	buf->gapLen -= length;
+
+	i32 first = (i32)buf->lineLengths.length - 1;
+	i32 firstLength = buf->lineLengths.data[first];
+	i32 line = first;
+
+	for (sizet i = 0; i < length; ++i) {
+
+		char c = text[i];
+		buf->lineLengths.data[line]++;
+		buf->cursorLines.data[line] += c == '\t' ? TAB_SIZE : 1;
+
+		if (c == '\n') {
+
+			if (line != first)
+				line_index_push(buf, buf->lineLengths.data[line]);
+
+			array_push(&buf->lineLengths, 0);
+			array_push(&buf->cursorLines, 0);
+			line++;
+			column_cache_invalidate(buf, line);
+			wrap_cache_invalidate(buf, line);
+		}
+	}
+
+	// the first line is in the tree already, it grew under the new ones
+	if (line != first)
+		line_index_push(buf, buf->lineLengths.data[line]);
+	line_index_add(buf, first, buf->lineLengths.data[first] - firstLength);
+	column_cache_invalidate(buf, first);
+	wrap_cache_invalidate(buf, first);
+
+	BufferState state = buf->state;
+	buffer_edit(buf, first, 1, line - first + 1);
+	buf->state = state;
+}
+
+// where pos ends up after the sorted hunks are applied, a position inside
+// a replaced run keeps its offset into it as far as the new text goes
+static sizet
+position_patch(sizet pos, const BufferHunk* hunks, sizet count) {
+
+	i64 delta = 0;
+	for (sizet i = 0; i < count && hunks[i].pos <= pos; ++i) {
+
+		const BufferHunk* hunk = &hunks[i];
+		if (pos < hunk->pos + hunk->deleteLen) {
+
+			sizet into = pos - hunk->pos;
+			return hunk->pos + delta + (into < hunk->insertLen ? into : hunk->insertLen);
+		}
+
+		delta += (i64)hunk->insertLen - (i64)hunk->deleteLen;
+	}
+
+	return pos + delta;
+}
+
+static void
+cursors_patch(Array<sizet>* cursors, const BufferHunk* hunks, sizet count) {
+
+	sizet kept = 0;
+	for (sizet i = 0; i < cursors->length; ++i) {
+
+		sizet pos = position_patch(cursors->data[i], hunks, count);
+		// cursors in one replaced run can land on the same spot
+		if (kept && cursors->data[kept - 1] == pos)
+			continue;
+		cursors->data[kept++] = pos;
+	}
+	cursors->length = kept;
+}
+
+// the table entries of lines [from, to) of buf, as many as there are
+static void
+lines_copy(Buffer* buf, Array<i32>* lengths, Array<i32>* columns, i32 from, i32 to) {
+
+	if (to > (i32)buf->lineLengths.length)
+		to = (i32)buf->lineLengths.length;
+
+	for (i32 line = from; line < to; ++line) {
+		array_push(lengths, buf->lineLengths.data[line]);
+		array_push(columns, buf->cursorLines.data[line]);
+	}
+}
+
+// the lines of text, the part after the last newline only at the end of
+// the text, where it is the last line even when empty
+static void
+lines_count(Array<i32>* lengths, Array<i32>* columns, const char* text, sizet length, b8 end) {
+
+	i32 lineLength = 0;
+	i32 lineColumns = 0;
+
+	for (sizet i = 0; i < length; ++i) {
+
+		lineLength++;
+		lineColumns += text[i] == '\t' ? TAB_SIZE : 1;
+
+		if (text[i] == '\n') {
+			array_push(lengths, lineLength);
+			array_push(columns, lineColumns);
+			lineLength = 0;
+			lineColumns = 0;
+		}
+	}
+
+	if (end) {
+		array_push(lengths, lineLength);
+		array_push(columns, lineColumns);
+	}
+}
+
+// applies the sorted, disjoint hunks of whole lines without journaling
+// them, only the lines they touch are counted and given to the edit log,
+// so state built for the rest of the text stays valid, cursors stay on
+// the text they were on
+void
+buffer_patch(Buffer* buf, const BufferHunk* hunks, sizet count) {
+
+	if (!count || buf->large) return;
+
+	sizet cursor = position_patch(buf->cursor, hunks, count);
+	cursors_patch(&buf->cursors, hunks, count);
+
+	for (sizet i = 0; i < buf->views.length; ++i) {
+
+		BufferView* view = &buf->views[i];
+		if (!view->open || (i32)i == buf->activeView)
+			continue;
+
+		view->cursor = position_patch(view->cursor, hunks, count);
+		cursors_patch(&view->cursors, hunks, count);
+	}
+
+	sizet length = buffer_length(buf);
+
+	// back to front, the gap only ever moves toward the start
+	for (sizet i = count; i-- > 0;)
+		buffer_splice(buf, hunks[i].pos, hunks[i].deleteLen, hunks[i].insert, hunks[i].insertLen);
+
+	// the lines between hunks are carried over, only the inserted ones are
+	// counted, a hunk at the end of the text takes every line after it
+	Array<i32> lengths;
+	Array<i32> columns;
+	array_init(&lengths, buf->lineLengths.length + 1);
+	array_init(&columns, buf->lineLengths.length + 1);
+
+	i32 from = 0;
+	for (sizet i = 0; i < count; ++i) {
+
+		const BufferHunk* hunk = &hunks[i];
+		b8 end = hunk->pos + hunk->deleteLen >= length;
+
+		lines_copy(buf, &lengths, &columns, from, hunk->line);
+		lines_count(&lengths, &columns, hunk->insert, hunk->insertLen, end);
+		from = end ? INT32_MAX : hunk->line + hunk->removed;
+	}
+	lines_copy(buf, &lengths, &columns, from, INT32_MAX);
+
+	array_free(&buf->lineLengths);
+	array_free(&buf->cursorLines);
+	buf->lineLengths = lengths;
+	buf->cursorLines = columns;
+
+	buf->lineIndexDirty = true;
+	column_cache_reset(buf);
+	wrap_cache_reset(buf);
+	buffer_set_cursor(buf, cursor);
+
+	BufferState state = buf->state;
+	i32 shift = 0;
+	for (sizet i = 0; i < count; ++i) {
+
+		buffer_edit(buf, hunks[i].line + shift, hunks[i].removed, hunks[i].added);
+		shift += hunks[i].added - hunks[i].removed;
+	}
+	buf->state = state;
+}
+
+void
+buffer_replace_at(Buffer* buf, Array<sizet>* positions, sizet deleteLen,
+				  const char* insert, sizet insertLen) {
+
+	sizet count = positions->length;
+	if (count == 0 || buf->large) return;
+
+	// sorted and disjoint, what journal_replay checks a record for
+	for (sizet i = 1; i < count; ++i) {
+		ASSERT((*positions)[i - 1] < (*positions)[i] &&
+			   (*positions)[i - 1] + deleteLen <= (*positions)[i]);
+	}
+
+	journal_edit(buf, positions->data, count, deleteLen, insert, insertLen);
+
+	sizet length = buffer_length(buf);
+	i64 delta = (i64)insertLen - (i64)deleteLen;
+	sizet newLength = length + count * delta;
+
+	// lines from the first to the last touched position are replaced,
+	// counted before the line tables go stale
+	i32 firstLine = buffer_line_based_on_index(buf, (*positions)[0]);
+	i32 lastLine = buffer_line_based_on_index(buf, (*positions)[count - 1] + deleteLen);
+	i32 lineDelta = 0;
+	for (sizet i = 0; i < insertLen; ++i)
+		lineDelta += insert[i] == '\n';
+	lineDelta *= (i32)count;
+	for (sizet i = 0; i < count; ++i)
+		for (sizet k = 0; k < deleteLen; ++k)
+			lineDelta -= buffer_char_at(buf, (*positions)[i] + k) == '\n';
+
+	views_follow(buf, positions->data, count, deleteLen, insertLen);
+
+	// one gap move to the end, after that every byte is moved at most once
+	buffer_move_gap(buf, length);
+	buffer_reserve(buf, newLength);
+
+	char* text = buf->text;
+
+	if (delta > 0) {
+
+		// growing, walk back to front so nothing is overwritten
+		sizet src = length;
+		sizet dst = newLength;
+		for (sizet i = count; i-- > 0;) {
+
+			sizet tail = (*positions)[i] + deleteLen;
+			dst -= src - tail;
+			memmove(text + dst, text + tail, src - tail);
+			dst -= insertLen;
+			memcpy(text + dst, insert, insertLen);
+			src = (*positions)[i];
+		}
+	}
+	else {
+
+		// shrinking or same size, walk front to back
+		sizet dst = (*positions)[0];
+		for (sizet i = 0; i < count; ++i) {
+
+			memcpy(text + dst, insert, insertLen);
+			dst += insertLen;
+
+			sizet tail = (*positions)[i] + deleteLen;
+			sizet end = i + 1 < count ? (*positions)[i + 1] : length;
+			memmove(text + dst, text + tail, end - tail);
+			dst += end - tail;
+		}
+	}
+
+	// every position ends up after its inserted text
+	for (sizet i = 0; i < count; ++i)
+		(*positions)[i] += i * delta + insertLen;
+
+	buf->preLen = newLength;
+	buf->postLen = 0;
+	buf->gapLen = buf->size - newLength;
+
+	i32 removed = lastLine - firstLine + 1;
+	buffer_edit(buf, firstLine, removed, removed + lineDelta);
+}
+
+void
+buffer_cursor_add(Buffer* buf, sizet index) {
+
+	if (index == buf->cursor) return;
+
+	sizet pos = 0;
+	while (pos < buf->cursors.length && buf->cursors[pos] < index)
+		pos++;
+
+	if (pos < buf->cursors.length && buf->cursors[pos] == index) return;
+
+	array_insert(&buf->cursors, index, pos);
+}
+
+void
+buffer_cursors_clear(Buffer* buf) {
+
+	array_reset(&buf->cursors);
+}
+
+// applies one edit at the main cursor and every extra cursor in one pass
+static void
+cursors_replace(sizet deleteBefore, const char* insert, sizet insertLen) {
+
+	Array<sizet> positions;
+	array_init(&positions, CurBuffer->cursors.length + 1);
+
+	// cursors that collapsed onto each other, the main one included, are
+	// one cursor, the runs they delete may not overlap
+	sizet apart = deleteBefore ? deleteBefore : 1;
+
+	sizet main = -1;
+	b8 mainAdded = false;
+	b8 mainStays = false;
+	// cursors with less than deleteBefore in front of them, they come first
+	sizet stays = 0;
+	for (sizet i = 0; i <= CurBuffer->cursors.length; ++i) {
+
+		if (!mainAdded &&
+			(i == CurBuffer->cursors.length || CurBuffer->cursor < CurBuffer->cursors[i])) {
+
+			mainAdded = true;
+			if (CurBuffer->cursor >= deleteBefore) {
+
+				sizet pos = CurBuffer->cursor - deleteBefore;
+				if (positions.length && positions[positions.length - 1] + apart > pos) {
+					main = positions.length - 1;
+				}
+				else {
+					main = positions.length;
+					array_push(&positions, pos);
+				}
+			}
+			else {
+				mainStays = true;
+			}
+		}
+
+		if (i < CurBuffer->cursors.length) {
+
+			if (CurBuffer->cursors[i] < deleteBefore) {
+				stays++;
+				continue;
+			}
+
+			sizet pos = CurBuffer->cursors[i] - deleteBefore;
+			if (positions.length == 0 || positions[positions.length - 1] + apart <= pos)
+				array_push(&positions, pos);
+		}
+	}
+
+	sizet first = positions.length ? positions[0] : (sizet)-1;
+	buffer_replace_at(CurBuffer, &positions, deleteBefore, insert, insertLen);
+
+	// a cursor with too little in front of it deletes nothing and stays,
+	// one the first run deletes over ends up where that run does
+	if (mainStays && CurBuffer->cursor >= first)
+		main = 0;
+	sizet mainIndex = main == (sizet)-1 ? CurBuffer->cursor : positions[main];
+
+	sizet kept = 0;
+	for (sizet i = 0; i < stays; ++i) {
+
+		sizet pos = CurBuffer->cursors[i];
+		if (pos >= first)
+			break;
+		if (main == (sizet)-1 && pos == mainIndex)
+			continue;
+
+		CurBuffer->cursors.data[kept++] = pos;
+	}
+	CurBuffer->cursors.length = kept;
+
+	for (sizet i = 0; i < positions.length; ++i) {
+
+		if (i != main)
+			array_push(&CurBuffer->cursors, positions[i]);
+	}
+
+	CurBuffer->cursor = mainIndex;
+	buffer_rebuild_lines(CurBuffer);
+
+	array_free(&positions);
+}
+
+void
+buffer_cursors_insert(const char* text, sizet length) {
+
+	cursors_replace(0, text, length);
+}
+
+void
+buffer_cursors_backspace() {
+
+	cursors_replace(1, "", 0);
+}
+
+
 
 void
 buffer_clear(Buffer* buf) {
 
+	sizet start = 0;
+	journal_edit(buf, &start, 1, buffer_length(buf), "", 0);
+	buffer_edit(buf, 0, (i32)buf->lineLengths.length, 1);
+
 	array_reset(&buf->lineLengths);
 	array_reset(&buf->cursorLines);
 	array_push(&buf->lineLengths, 0);
 	array_push(&buf->cursorLines, 0);
+	buf->lineIndexDirty = true;
+	column_cache_reset(buf);
+	wrap_cache_reset(buf);
 
 	if (buf->path.data) {
 		str_free(&buf->path);
@@ -396,7 +1500,350 @@ buffer_clear(Buffer* buf) {
 	buf->gapLen = buf->size;
 	buf->preLen = 0;
 	buf->postLen = 0;
+	buf->cursor = 0;
 	buf->currentLine = 0;
 	buf->curX = 0;
 	buf->cursorXtabed = 0;
+	buf->cursorPixelX = 0.0f;
+	array_reset(&buf->cursors);
+
+	for (sizet i = 0; i < buf->views.length; ++i) {
+
+		buf->views[i].cursor = 0;
+		if (buf->views[i].open)
+			array_reset(&buf->views[i].cursors);
+	}
+}
+
+// the text and everything built from it, what is left describes the
+// buffer without its contents
+static void
+buffer_text_free(Buffer* buf) {
+
+	syntax_release(buf);
+	large_close(buf);
+
+	free(buf->text);
+	buf->text = NULL;
+
+	array_free(&buf->cursorLines);
+	array_free(&buf->lineLengths);
+	array_free(&buf->lineIndex);
+	buf->cursorLines.data = NULL;
+	buf->lineLengths.data = NULL;
+	buf->lineIndex.data = NULL;
+
+	for (sizet i = 0; i < COLUMN_CACHE_SIZE; ++i) {
+		if (buf->columnCache[i].checkpoints.data)
+			array_free(&buf->columnCache[i].checkpoints);
+	}
+	column_cache_init(buf);
+
+	if (buf->wrapCache) {
+		for (sizet i = 0; i < WRAP_CACHE_SIZE; ++i) {
+			if (buf->wrapCache[i].rows.data)
+				array_free(&buf->wrapCache[i].rows);
+		}
+		free(buf->wrapCache);
+		buf->wrapCache = NULL;
+	}
+}
+
+// releases the text and every line table of the buffer, the path and
+// name strings are left to the owner
+void
+buffer_free(Buffer* buf) {
+
+	buffer_text_free(buf);
+
+	array_free(&buf->cursors);
+	array_free(&buf->edits);
+
+	for (sizet i = 0; i < buf->views.length; ++i)
+		if (buf->views[i].open)
+			array_free(&buf->views[i].cursors);
+	array_free(&buf->views);
+	array_free(&buf->folds);
+	array_free(&buf->foldIndex);
+}
+
+// records that lines [line, line + removed) became [line, line + added),
+// a full log collapses into one edit over the whole text
+void
+buffer_edit(Buffer* buf, i32 line, i32 removed, i32 added) {
+
+	buf->version++;
+	buf->state = BUFFER_DIRTY;
+
+	// folds follow the real edit, only the log is collapsed
+	folds_follow_edit(buf, line, removed, added);
+
+	if (buf->edits.length >= BUFFER_EDITS_MAX) {
+
+		array_reset(&buf->edits);
+		line = 0;
+		removed = INT32_MAX / 2;
+		added = INT32_MAX / 2;
+	}
+
+	LineEdit edit = {buf->version, line, removed, added};
+	array_push(&buf->edits, edit);
+}
+
+// drops the edits already contained in version
+void
+buffer_edits_trim(Buffer* buf, u32 version) {
+
+	sizet keep = 0;
+	while (keep < buf->edits.length && buf->edits[keep].version <= version)
+		keep++;
+
+	if (!keep) return;
+
+	memmove(buf->edits.data, buf->edits.data + keep,
+			(buf->edits.length - keep) * sizeof(LineEdit));
+	buf->edits.length -= keep;
+}
+
+// bytes held for the text and its line tables
+static sizet
+buffer_memory(Buffer* buf) {
+
+	return buf->size +
+		(buf->lineLengths.capacity + buf->cursorLines.capacity) * sizeof(i32) +
+		buf->lineIndex.capacity * sizeof(sizet);
+}
+
+static b8
+buffer_viewed(Buffer* buf) {
+
+	for (sizet i = 0; i < buf->views.length; ++i)
+		if (buf->views[i].open)
+			return true;
+
+	return buf == CurBuffer || buf == PrevBuffer;
+}
+
+static void
+buffer_unload(Buffer* buf) {
+
+	buf->lineCount = buf->lineLengths.length;
+	buffer_text_free(buf);
+	array_reset(&buf->edits);
+
+	buf->state = BUFFER_UNLOADED;
+}
+
+// reads the text back from the file, cursors are kept and clamped to what
+// is there now, folds only when the file did not change since
+static void
+buffer_load(Buffer* buf) {
+
+	u64 time = 0;
+	sizet size = 0;
+	file_stamp(buf->path.as_cstr(), &time, &size);
+	if (time != buf->fileTime || size != buf->fileSize)
+		folds_clear(buf);
+
+	buf->fileTime = time;
+	buf->fileSize = size;
+
+	// a large file is paged in after, it is never read whole
+	b8 large = large_file_size(size);
+
+	File file = {};
+	if (!large)
+		file = file_open(buf->path.as_cstr());
+	if (!file.buffer && !large) {
+		WARN_MSG("reloading %s as an empty buffer \n", buf->path.as_cstr());
+	}
+
+	Buffer loaded = file.buffer ? buffer_create(file) : buffer_create_empthy();
+
+	buf->text = loaded.text;
+	buf->size = loaded.size;
+	buf->preLen = loaded.preLen;
+	buf->postLen = loaded.postLen;
+	buf->gapLen = loaded.gapLen;
+	buf->lineLengths = loaded.lineLengths;
+	buf->cursorLines = loaded.cursorLines;
+	buf->lineIndex = loaded.lineIndex;
+	buf->lineIndexDirty = true;
+	buf->foldIndexDirty = true;
+	buffer_cursor_pixel_invalidate(buf);
+
+	array_free(&loaded.cursors);
+	array_free(&loaded.edits);
+	array_free(&loaded.views);
+	array_free(&loaded.folds);
+	array_free(&loaded.foldIndex);
+
+	// buf keeps its own path, the one file_open made is shared with
+	// loaded, which lets go of it first
+	loaded.path = String();
+	if (file.buffer)
+		str_free(&file.path);
+
+	buf->state = BUFFER_RESIDENT;
+	if (!large) {
+		journal_replay(buf);
+	}
+	else if (!large_open(buf)) {
+		WARN_MSG("reloading %s as an empty buffer \n", buf->path.as_cstr());
+	}
+
+	for (sizet i = 0; i < buf->views.length; ++i)
+		if (buf->views[i].cursor > buffer_length(buf))
+			buf->views[i].cursor = buffer_length(buf);
+
+	buffer_set_cursor(buf, buf->cursor);
+	array_reset(&buf->cursors);
+
+	buf->version++;
+}
+
+void
+buffers_set_budget(sizet bytes) {
+
+	Budget = bytes;
+}
+
+// unloads clean buffers no window shows, least recently viewed first,
+// until the text in memory fits the budget
+void
+buffers_trim() {
+
+	sizet resident = 0;
+	for (Member<Buffer>* node = Buffers.head; node; node = node->next)
+		if (node->data.state != BUFFER_UNLOADED)
+			resident += buffer_memory(&node->data);
+
+	while (resident > Budget) {
+
+		Buffer* oldest = NULL;
+		for (Member<Buffer>* node = Buffers.head; node; node = node->next) {
+
+			Buffer* buf = &node->data;
+			if (buf->state != BUFFER_RESIDENT || !buf->path.length || buf->large || buffer_viewed(buf))
+				continue;
+
+			if (!oldest || buf->lastViewed < oldest->lastViewed)
+				oldest = buf;
+		}
+
+		if (!oldest) return;
+
+		NORMAL_MSG("Unloaded file: %s \n", oldest->path.as_cstr());
+		resident -= buffer_memory(oldest);
+		buffer_unload(oldest);
+	}
+}
+
+// registers the file without reading it, the text is loaded when a
+// window first shows the buffer
+Buffer*
+buffer_open(const char* path) {
+
+	Buffer* known = buffer_get(path);
+	if (known)
+		return known;
+
+	String pathstr = str_create(path);
+	String key = get_filestr_from_path(pathstr);
+
+	list_add(&Buffers, buffer_create_empthy());
+	Buffer* buf = &Buffers.tail->data;
+	buf->name = str_create(key.as_cstr());
+	buf->path = pathstr;
+	buf->language = language_for_path(path);
+	registry_add(buf);
+	file_stamp(path, &buf->fileTime, &buf->fileSize);
+	reload_watch(buf);
+
+	buffer_unload(buf);
+	buf->lineCount = 0;
+
+	str_free(&key);
+
+	return buf;
+}
+
+// a view for one more window on the buffer, starting at the live cursor,
+// an unloaded buffer is read back first
+i32
+buffer_view_open(Buffer* buf) {
+
+	if (buf->state == BUFFER_UNLOADED)
+		buffer_load(buf);
+
+	buf->lastViewed = ++ViewClock;
+
+	BufferView view;
+	view.cursor = buf->cursor;
+	view.open = true;
+	array_init(&view.cursors, 1);
+
+	// closed slots are taken again before the array grows
+	i32 slot = -1;
+	for (sizet i = 0; i < buf->views.length; ++i) {
+		if (!buf->views[i].open) {
+			slot = (i32)i;
+			break;
+		}
+	}
+
+	if (slot < 0) {
+		array_push(&buf->views, view);
+		slot = (i32)buf->views.length - 1;
+	}
+	else {
+		buf->views[slot] = view;
+	}
+
+	if (buf->activeView < 0)
+		buf->activeView = slot;
+
+	return slot;
+}
+
+void
+buffer_view_close(Buffer* buf, i32 view) {
+
+	array_free(&buf->views[view].cursors);
+	buf->views[view].open = false;
+	buf->lastViewed = ++ViewClock;
+
+	if (buf->activeView == view)
+		buf->activeView = -1;
+
+	buffers_trim();
+}
+
+// stores the live cursors in the active view and takes over the ones of
+// view, the text and the gap stay where they are
+void
+buffer_view_activate(Buffer* buf, i32 view) {
+
+	if (buf->activeView == view) return;
+
+	Array<sizet> spare;
+
+	if (buf->activeView >= 0) {
+
+		BufferView* active = &buf->views[buf->activeView];
+		active->cursor = buf->cursor;
+
+		spare = active->cursors;
+		active->cursors = buf->cursors;
+		buf->cursors = spare;
+	}
+
+	BufferView* next = &buf->views[view];
+	spare = next->cursors;
+	next->cursors = buf->cursors;
+	buf->cursors = spare;
+
+	buf->activeView = view;
+	buf->lastViewed = ++ViewClock;
+	buffer_set_cursor(buf, next->cursor);
 }
@@ -4,8 +4,106 @@
 #include "math.h"
 #include "fileio.h"
 #include "container.h"
+#include "language.h"
 
 #define TAB_SIZE 4
+#define COLUMN_CHECKPOINT_STRIDE 1024
+#define COLUMN_CACHE_SIZE 16
+#define WRAP_CACHE_SIZE 256
+#define BUFFER_EDITS_MAX 1024
+
+struct SyntaxState;
+struct Journal;
+struct LargeFile;
+
+typedef struct ColumnCheckpoint {
+
+	i32 column;
+	f32 pixelX;
+
+} ColumnCheckpoint;
+
+// tabbed column and pixel offset of every COLUMN_CHECKPOINT_STRIDE-th
+// character of one line
+typedef struct ColumnIndex {
+
+	i32 line;
+	u32 generation;
+	Array<ColumnCheckpoint> checkpoints;
+
+} ColumnIndex;
+
+typedef struct WrapRow {
+
+	i32 offset;
+	f32 pixelX;
+
+} WrapRow;
+
+// start of every visual row of one soft wrapped line, rows[0] is the
+// line start
+typedef struct WrapLine {
+
+	i32 line;
+	f32 width;
+	u32 generation;
+	Array<WrapRow> rows;
+
+} WrapLine;
+
+// lines [line, line + removed) were replaced by [line, line + added),
+// lets state built from an older version find its lines in the text
+typedef struct LineEdit {
+
+	u32 version;
+	i32 line;
+	i32 removed;
+	i32 added;
+
+} LineEdit;
+
+// deleteLen bytes at pos replaced by insertLen bytes of insert, whole lines
+// [line, line + removed) that become [line, line + added), positions and
+// lines as they were before any hunk of the patch
+typedef struct BufferHunk {
+
+	sizet pos;
+	sizet deleteLen;
+	const char* insert;
+	sizet insertLen;
+	i32 line;
+	i32 removed;
+	i32 added;
+
+} BufferHunk;
+
+// lines (header, end] are hidden, the header stays on screen
+typedef struct FoldRange {
+
+	i32 header;
+	i32 end;
+
+} FoldRange;
+
+// where a window on the buffer left its cursors, moved along with the
+// edits made from other windows
+typedef struct BufferView {
+
+	sizet cursor;
+	Array<sizet> cursors;
+	b8 open;
+
+} BufferView;
+
+enum BufferState {
+
+	// only the path, cursors, folds and line count are kept
+	BUFFER_UNLOADED,
+	// the text matches the file
+	BUFFER_RESIDENT,
+	// edited since it was read or saved, never unloaded
+	BUFFER_DIRTY,
+};
 
 typedef struct Buffer {
   
@@ -17,24 +115,91 @@ typedef struct Buffer {
 	sizet gapLen;
 	sizet size;
 
+	// main cursor as a logical offset, the gap is only moved to it by an
+	// edit, so moving around and switching views never touch the text
+	sizet cursor;
+
 	i32 currentLine;
 	Array<i32> cursorLines;
 	Array<i32> lineLengths;
 
+	// fenwick tree over lineLengths, rebuilt lazily when lines are
+	// inserted or erased
+	Array<sizet> lineIndex;
+	b8 lineIndexDirty;
+
+	// direct mapped by line number, only filled for long lines
+	ColumnIndex columnCache[COLUMN_CACHE_SIZE];
+
+	// direct mapped by line number, allocated once a window wraps the buffer
+	WrapLine* wrapCache;
+
+	// extra cursors as sorted logical positions
+	Array<sizet> cursors;
+
+	// one per window on the buffer, the cursors of activeView are the ones
+	// above, the others are stored in their view
+	Array<BufferView> views;
+	i32 activeView;
+
+	BufferState state;
+	// view clock when a window last showed the buffer
+	u64 lastViewed;
+	// line count when it was unloaded
+	i32 lineCount;
+
 	i32 curX;
 	i32 cursorXtabed;
 
+	// pixel offset of the cursor from the start of its line, updated on
+	// every motion and edit, valid while generation matches the font
+	f32 cursorPixelX;
+	u32 cursorPixelGeneration;
+
 	String path;
+	// modification time and size of the file when it was last read or
+	// saved, zero for a file that could not be read
+	u64 fileTime;
+	sizet fileSize;
+
+	// grammar picked from the file extension
+	Language* language;
+
+	// bumped by every edit, edits since the oldest version still in use
+	// are kept in order
+	u32 version;
+	Array<LineEdit> edits;
+
+	SyntaxState* syntax;
+	Journal* journal;
+	// set for a file over the large file threshold, the text is one read
+	// only slice of it
+	LargeFile* large;
+	// appended to by the follow module, changes to its file are left to it
+	b8 followed;
+
+	// sorted and disjoint
+	Array<FoldRange> folds;
+	// fenwick tree over the visibility of every line, maps between line
+	// numbers and rows on screen, rebuilt lazily when folds or the line
+	// count change
+	Array<i32> foldIndex;
+	b8 foldIndexDirty;
+	// first line an edit left stale, the nodes before it still hold
+	i32 foldIndexStale;
 
 } Buffer;
 
 
 void buffers_init();
+void buffers_get_all(Array<Buffer*>* buffers);
 void buffer_add_empthy();
 Buffer* buffer_add(File& file);
 Buffer* buffer_get(const char* key);
+Buffer* buffer_open(const char* path);
+void buffers_set_budget(sizet bytes);
+void buffers_trim();
 Buffer buffer_create_empthy();
-void buffer_switch(const char* key);
 
 void buffer_forward();
 void buffer_backward();
@@ -46,5 +211,35 @@ void buffer_insert_tab();
 void buffer_insert_newline();
 void buffer_backspace_delete();
 sizet buffer_index_based_on_line(Buffer* buf, i32 line);
+i32 buffer_line_based_on_index(Buffer* buf, sizet index);
+i32 buffer_column_from_tabbed(Buffer* buf, i32 line, i32 tabbedX, i32* outTabbed);
+i32 buffer_offset_at_column(Buffer* buf, i32 line, i32 column, i32* outColumn, f32* outPixelX);
+void buffer_move_gap(Buffer* buf, sizet index);
+char buffer_char_at(Buffer* buf, sizet index);
 void buffer_clear(Buffer* buf);
+void buffer_free(Buffer* buf);
 sizet buffer_length(Buffer* buf);
+void buffers_set_font_advances(const f32* advances);
+f32 buffer_char_advance(char c);
+u32 buffers_font_generation();
+f32 buffer_cursor_pixel_x(Buffer* buf);
+void buffer_cursor_pixel_set(Buffer* buf, f32 pixelX);
+void buffer_cursor_pixel_invalidate(Buffer* buf);
+i32 buffer_column_at_offset(Buffer* buf, i32 line, i32 offset);
+f32 buffer_pixel_at_offset(Buffer* buf, i32 line, i32 offset);
+void buffer_set_cursor(Buffer* buf, sizet index);
+void buffer_rebuild_lines(Buffer* buf);
+void buffer_splice(Buffer* buf, sizet pos, sizet deleteLen, const char* insert, sizet insertLen);
+void buffer_append(Buffer* buf, const char* text, sizet length);
+void buffer_patch(Buffer* buf, const BufferHunk* hunks, sizet count);
+void buffer_replace_at(Buffer* buf, Array<sizet>* positions, sizet deleteLen,
+					   const char* insert, sizet insertLen);
+void buffer_cursor_add(Buffer* buf, sizet index);
+void buffer_cursors_clear(Buffer* buf);
+void buffer_cursors_insert(const char* text, sizet length);
+void buffer_cursors_backspace();
+void buffer_edit(Buffer* buf, i32 line, i32 removed, i32 added);
+void buffer_edits_trim(Buffer* buf, u32 version);
+i32 buffer_view_open(Buffer* buf);
+void buffer_view_close(Buffer* buf, i32 view);
+void buffer_view_activate(Buffer* buf, i32 view);
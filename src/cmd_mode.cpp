@@ -60,7 +60,7 @@ cmdmode_backspace() {
 static void
 insert_char(char c) {
 
-	if (c > 32 && c < 126) {
+	if (c >= 32 && c < 126) {
 
 		buffer_insert_char(c);
 	}
@@ -170,19 +170,32 @@ static void
 handle_command() {
 
 	Text = buffer_get_text_copy(CurBuffer);
-	Command* cmd = command_get(Text);
+
+	// everything after the first space is passed as arguments
+	sizet nameEnd = 0;
+	while (nameEnd < Text.length && Text[nameEnd] != ' ')
+		nameEnd++;
+
+	String name = str_substring(&Text, 0, nameEnd);
+	Command* cmd = command_get(name);
 	if (cmd->cmd) {
-		if (Text == "find-file") {
+		if (name == "find-file") {
 
 			change_minor_mode_to(MODE_FIND_FILE);
 		}
 		else{
 			
+			List<char> args;
+			list_init(&args);
+			for (sizet i = nameEnd + 1; i < Text.length; ++i)
+				list_add(&args, Text[i]);
+
 			exit();
-			if (cmd->minArgs == 0) {
+			if (cmd->minArgs == 0 || args.head) {
 
-				cmd->cmd(NULL);
+				cmd->cmd(&args);
 			}
+			list_free(&args);
 		}
 	}
 	else {
@@ -257,10 +270,9 @@ findfile_open_file() {
 		String filename = FieldNames[SelectedFieldId];
 		if (file_exists(filepath.as_cstr())) {
 
-			File file = file_open(filepath.as_cstr());
-			Buffer* buffer = buffer_add(file);
+			Buffer* buffer = buffer_open(filepath.as_cstr());
 			PrevBuffer = buffer;
-			FocusedWindow->key = buffer->path.as_cstr();
+			window_set_buffer(FocusedWindow, buffer);
 			exit();
 		}
 		else {
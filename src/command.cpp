@@ -5,6 +5,10 @@
 #include "editor.h"
 #include "globals.h"
 #include "container.h"
+#include "profiler.h"
+#include "largefile.h"
+#include "follow.h"
+#include "debug.h"
 
 static HashTable<Command> Commands;
 
@@ -32,6 +36,60 @@ cmd_cursor_down(List<char>* args) {
 	cursor_down();
 }
 
+static void
+cmd_page_up(List<char>* args) {
+
+	cursor_page_up();
+}
+
+static void
+cmd_page_down(List<char>* args) {
+
+	cursor_page_down();
+}
+
+static void
+cmd_line_start(List<char>* args) {
+
+	cursor_line_start();
+}
+
+static void
+cmd_line_end(List<char>* args) {
+
+	cursor_line_end();
+}
+
+static void
+cmd_toggle_wrap(List<char>* args) {
+
+	window_toggle_wrap();
+}
+
+static void
+cmd_goto_line(List<char>* args) {
+
+	if (!args) return;
+
+	i32 line = 0;
+	Member<char>* node = args->head;
+	while (node) {
+
+		if (node->data >= '0' && node->data <= '9')
+			line = line * 10 + (node->data - '0');
+		node = node->next;
+	}
+
+	// lines are shown 1 based, in a large file counted from its top
+	if (CurBuffer->large) {
+		i32 relative;
+		windows_shift_lines(CurBuffer, large_goto_line(CurBuffer, line > 0 ? line - 1 : 0, &relative));
+		line = relative + 1;
+	}
+
+	cursor_goto_line(line - 1);
+}
+
 static void 
 cmd_window_split_vertical(List<char>* args) {
 
@@ -78,6 +136,11 @@ cmd_window_close(List<char>* args) {
 static void
 cmd_enter_edit_mode(List<char>* args) {
 
+	if (CurBuffer->large) {
+		WARN_MSG("%s is too large to edit, it is read only \n", CurBuffer->name.as_cstr());
+		return;
+	}
+
     just_entered_edit_mode = true;
 	editor_change_mode(MODE_NORMAL);
 }
@@ -109,9 +172,118 @@ cmd_save_file(List<char>* args) {
 static void
 cmd_backspace_delete(List<char>* args) {
 	
-	buffer_backspace_delete();
+	if (CurBuffer->cursors.length)
+		buffer_cursors_backspace();
+	else
+		buffer_backspace_delete();
+}
+
+static void
+cmd_cursor_add_all_matches(List<char>* args) {
+
+	cursor_add_all_matches();
+}
+
+static void
+cmd_cursor_add_next_match(List<char>* args) {
+
+	cursor_add_next_match();
+}
+
+static void
+cmd_cursors_clear(List<char>* args) {
+
+	buffer_cursors_clear(CurBuffer);
+}
+
+static void
+cmd_bracket_match(List<char>* args) {
+
+	cursor_bracket_match();
+}
+
+static void
+cmd_scope_start(List<char>* args) {
+
+	cursor_scope_start();
 }
 
+static void
+cmd_scope_end(List<char>* args) {
+
+	cursor_scope_end();
+}
+
+static void
+cmd_fold_toggle(List<char>* args) {
+
+	cursor_fold_toggle();
+}
+
+static void
+cmd_folds_clear(List<char>* args) {
+
+	cursor_folds_clear();
+}
+
+static void
+cmd_rename(List<char>* args) {
+
+	if (!args) return;
+
+	char name[256];
+	sizet length = 0;
+	Member<char>* node = args->head;
+	while (node && length < sizeof(name)) {
+
+		if (node->data != ' ')
+			name[length++] = node->data;
+		node = node->next;
+	}
+
+	if (length)
+		cursor_rename_word(name, length);
+}
+
+static void
+cmd_toggle_profiler(List<char>* args) {
+
+	profiler_toggle();
+}
+
+static void
+cmd_profiler_export(List<char>* args) {
+
+	char path[256] = "codeze_trace.json";
+	sizet length = 0;
+
+	if (args) {
+
+		Member<char>* node = args->head;
+		while (node && length < sizeof(path) - 1) {
+
+			if (node->data != ' ')
+				path[length++] = node->data;
+			node = node->next;
+		}
+		if (length)
+			path[length] = '\0';
+	}
+
+	profiler_export(path);
+}
+
+static void
+cmd_latency_report(List<char>* args) {
+
+	profiler_latency_report();
+}
+
+static void
+cmd_follow(List<char>* args) {
+
+	follow_toggle(CurBuffer);
+}
 
 static Array<String> CommandNames;
 
@@ -133,6 +305,18 @@ commands_init() {
 	array_push(&CommandNames, temp);
 	temp = "cursor-down";
 	array_push(&CommandNames, temp);
+	temp = "page-up";
+	array_push(&CommandNames, temp);
+	temp = "page-down";
+	array_push(&CommandNames, temp);
+	temp = "goto-line";
+	array_push(&CommandNames, temp);
+	temp = "line-start";
+	array_push(&CommandNames, temp);
+	temp = "line-end";
+	array_push(&CommandNames, temp);
+	temp = "toggle-wrap";
+	array_push(&CommandNames, temp);
 	temp = "window-split-vertical";
 	array_push(&CommandNames, temp);
 	temp = "window-split-horizontal";
@@ -151,12 +335,44 @@ commands_init() {
 	array_push(&CommandNames, temp);
 	temp = "backspace-delete";
 	array_push(&CommandNames, temp);
+	temp = "cursor-add-all-matches";
+	array_push(&CommandNames, temp);
+	temp = "cursor-add-next-match";
+	array_push(&CommandNames, temp);
+	temp = "cursors-clear";
+	array_push(&CommandNames, temp);
+	temp = "bracket-match";
+	array_push(&CommandNames, temp);
+	temp = "scope-start";
+	array_push(&CommandNames, temp);
+	temp = "scope-end";
+	array_push(&CommandNames, temp);
+	temp = "fold-toggle";
+	array_push(&CommandNames, temp);
+	temp = "folds-clear";
+	array_push(&CommandNames, temp);
+	temp = "rename";
+	array_push(&CommandNames, temp);
+	temp = "toggle-profiler";
+	array_push(&CommandNames, temp);
+	temp = "profiler-export";
+	array_push(&CommandNames, temp);
+	temp = "latency-report";
+	array_push(&CommandNames, temp);
+	temp = "follow";
+	array_push(&CommandNames, temp);
 
 	hash_table_init(&Commands);
 	hash_table_put(&Commands, "cursor-left", {cmd_cursor_left, 0, 0});
 	hash_table_put(&Commands, "cursor-right", {cmd_cursor_right, 0, 0});
 	hash_table_put(&Commands, "cursor-up", {cmd_cursor_up, 0, 0});
 	hash_table_put(&Commands, "cursor-down", {cmd_cursor_down, 0, 0});
+	hash_table_put(&Commands, "page-up", {cmd_page_up, 0, 0});
+	hash_table_put(&Commands, "page-down", {cmd_page_down, 0, 0});
+	hash_table_put(&Commands, "goto-line", {cmd_goto_line, 1, 1});
+	hash_table_put(&Commands, "line-start", {cmd_line_start, 0, 0});
+	hash_table_put(&Commands, "line-end", {cmd_line_end, 0, 0});
+	hash_table_put(&Commands, "toggle-wrap", {cmd_toggle_wrap, 0, 0});
 	hash_table_put(&Commands, "window-split-vertical", {cmd_window_split_vertical, 0, 0});
 	hash_table_put(&Commands, "window-split-horizontal", {cmd_window_split_horizontal, 0, 0});
 	hash_table_put(&Commands, "window-switch-up", {cmd_window_switch_up, 0, 0});
@@ -170,6 +386,19 @@ commands_init() {
 	hash_table_put(&Commands, "find-file", {cmd_find_file, 0, 0});
 	hash_table_put(&Commands, "file-save", {cmd_save_file, 0, 0});
 	hash_table_put(&Commands, "backspace-delete", {cmd_backspace_delete, 0, 0});
+	hash_table_put(&Commands, "cursor-add-all-matches", {cmd_cursor_add_all_matches, 0, 0});
+	hash_table_put(&Commands, "cursor-add-next-match", {cmd_cursor_add_next_match, 0, 0});
+	hash_table_put(&Commands, "cursors-clear", {cmd_cursors_clear, 0, 0});
+	hash_table_put(&Commands, "bracket-match", {cmd_bracket_match, 0, 0});
+	hash_table_put(&Commands, "scope-start", {cmd_scope_start, 0, 0});
+	hash_table_put(&Commands, "scope-end", {cmd_scope_end, 0, 0});
+	hash_table_put(&Commands, "fold-toggle", {cmd_fold_toggle, 0, 0});
+	hash_table_put(&Commands, "folds-clear", {cmd_folds_clear, 0, 0});
+	hash_table_put(&Commands, "rename", {cmd_rename, 1, 1});
+	hash_table_put(&Commands, "toggle-profiler", {cmd_toggle_profiler, 0, 0});
+	hash_table_put(&Commands, "profiler-export", {cmd_profiler_export, 0, 1});
+	hash_table_put(&Commands, "latency-report", {cmd_latency_report, 0, 0});
+	hash_table_put(&Commands, "follow", {cmd_follow, 0, 0});
 }
 
 Command* 
@@ -2,6 +2,12 @@
 #include "command.h"
 #include "editor.h"
 #include "bind.h"
+#include "language.h"
+#include "buffer.h"
+#include "largefile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
 
 #ifdef LINUX_PLATFORM
 	#include <unistd.h>
@@ -107,6 +113,29 @@ config_handle_bind(String line, i32 &cursor, InputMode mode) {
 	
 }
 
+// grammar files are looked up next to the config file
+static void
+config_handle_language(const char* configPath, String& file) {
+
+	char path[4096];
+	sizet dirLength = 0;
+
+	for (sizet i = 0; configPath[i] != '\0'; ++i)
+		if (configPath[i] == '/' || configPath[i] == '\\')
+			dirLength = i + 1;
+
+	if (dirLength + file.length + 1 > sizeof(path)) {
+		WARN_MSG("language path too long: %s \n", file.as_cstr());
+		return;
+	}
+
+	memcpy(path, configPath, dirLength);
+	memcpy(path + dirLength, file.data, file.length);
+	path[dirLength + file.length] = '\0';
+
+	language_load(path);
+}
+
 static i32
 index_of_first_char(const char* str) {
 
@@ -137,6 +166,11 @@ config_read(const char* path) {
 			i += 4;
 			config_handle_bind(strline, i, currentMode);
 		}
+		else if (word == "language") {
+
+			String file = next_word(strline, i);
+			config_handle_language(path, file);
+		}
 		else if (word == "mode") {
 
 			String mode = next_word(strline, i);
@@ -145,6 +179,18 @@ config_read(const char* path) {
 			else if (mode == "navigation") 
 				currentMode = MODE_NAVIGATION;
 		}
+		else if (word == "buffer-budget") {
+
+			// megabytes of unshown file text kept in memory
+			String megabytes = next_word(strline, i);
+			buffers_set_budget((sizet)atoi(megabytes.as_cstr()) * 1024 * 1024);
+		}
+		else if (word == "large-file") {
+
+			// megabytes from which a file is paged in read only
+			String megabytes = next_word(strline, i);
+			large_set_threshold((u64)atoi(megabytes.as_cstr()) * 1024 * 1024);
+		}
 		lineNum++;
 	}
 }
@@ -1,6 +1,5 @@
 #pragma once
 #include "types.h"
-#include "event.h"
 #include "container.h"
 #include "debug.h"
 #include <stdlib.h>
@@ -81,7 +80,7 @@ template <typename T> T&
 array_pop(Array<T>* arr) {
 
 	arr->length -= 1;
-	return arr->data[arr->length + 1];
+	return arr->data[arr->length];
 }
 
 template <typename T> void 
@@ -93,7 +92,7 @@ array_insert(Array<T>* arr, const T& item, sizet pos) {
 		array_expand(arr);
 	}
 
-	memcpy(arr->data + (pos + 1), arr->data + pos, (arr->length - pos) * sizeof(T));
+	memmove(arr->data + (pos + 1), arr->data + pos, (arr->length - pos) * sizeof(T));
 	arr->data[pos] = item;
 
 	arr->length += 1;
@@ -105,7 +104,7 @@ array_erase(Array<T>* arr, sizet pos) {
 
 	ASSERT(arr->length >= 1);
 
-	memcpy(arr->data + pos, arr->data + (pos + 1), (arr->length - pos) * sizeof(T));
+	memmove(arr->data + pos, arr->data + (pos + 1), (arr->length - pos - 1) * sizeof(T));
 	arr->length -= 1;
 }
 
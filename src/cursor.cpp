@@ -4,46 +4,38 @@
 #include "renderer.h"
 #include "buffer.h"
 #include "globals.h"
-
-static String
-string_before_cursor(Buffer* buf) {
-	
-	String out = str_create(buf->lineLengths[CurBuffer->currentLine]);
-
-	i32 i = buf->preLen - 1;
-	if (buf->currentLine == 0) {
-		while (i >= 0) {
-			str_push(&out, buf->text[i]);
-			i--;
-		}
-	}
-	else {
-		while (buf->text[i] != '\n')  {
-			str_push(&out, buf->text[i]);
-			i--;
-		}
-	}
-
-	return out;
-}
+#include "window.h"
+#include "wrap.h"
+#include "brackets.h"
+#include "fold.h"
 
 Vec2
 cursor_render_pos(Buffer* buf, Window* win) {
   
-	String cursorString = string_before_cursor(buf);
 	Vec2 pos;
-	pos.x = win->position.x;
-	pos.y = win->position.y +
-		renderer_font_size() *
-		(buf->currentLine - win->renderView.start);
 
-	GlyphData* glyphs = renderer_get_glyphs();
+	if (win->softWrap) {
 
-	for (sizet i = 0; i < cursorString.length; ++i) {
+		WrapLine* wrap = wrap_line_get(buf, buf->currentLine, win->size.w);
+		i32 row = wrap_row_of_offset(wrap, buf->curX);
 
-		pos.x += glyphs[cursorString[i]].advanceX;
+		pos.x = win->position.x + buffer_cursor_pixel_x(buf) - wrap->rows[row].pixelX;
+		pos.y = win->position.y + renderer_font_size() *
+			window_rows_before(win, buf, buf->currentLine, row);
+
+		return pos;
 	}
 
+	// pixel offset of the first visible column on the cursor line
+	i32 column;
+	f32 viewX;
+	buffer_offset_at_column(buf, buf->currentLine, win->columnStart, &column, &viewX);
+
+	pos.x = win->position.x + buffer_cursor_pixel_x(buf) - viewX;
+	pos.y = win->position.y +
+		renderer_font_size() *
+		window_rows_before(win, buf, buf->currentLine, 0);
+
 	return pos;
 }
 
@@ -69,10 +61,10 @@ cursor_render_size(CursorStyle style) {
 char
 char_under_cursor() {
 
-	if (CurBuffer->postLen > 0)
-		return CurBuffer->text[CurBuffer->preLen + CurBuffer->gapLen];
+	if (CurBuffer->cursor < buffer_length(CurBuffer))
+		return buffer_char_at(CurBuffer, CurBuffer->cursor);
 	else 
-		return CurBuffer->text[CurBuffer->preLen - 1];
+		return buffer_char_at(CurBuffer, CurBuffer->cursor - 1);
 }
 
 
@@ -80,7 +72,7 @@ void
 cursor_right() {
   
 	if (char_under_cursor() == '\n'
-		|| CurBuffer->postLen <= 0) {
+		|| CurBuffer->cursor >= buffer_length(CurBuffer)) {
 		return;
 	}
 
@@ -90,105 +82,430 @@ cursor_right() {
 		CurBuffer->cursorXtabed++;
 
 	CurBuffer->curX++;
+	CurBuffer->cursorPixelX += buffer_char_advance(char_under_cursor());
 	buffer_forward();
 }
 
 void
 cursor_left() {
 
-	if (CurBuffer->preLen == 0) return;
+	if (CurBuffer->cursor == 0) return;
 
-	if (CurBuffer->text[CurBuffer->preLen - 1] == '\n')
+	char before = buffer_char_at(CurBuffer, CurBuffer->cursor - 1);
+
+	if (before == '\n')
 		return;
-	else if (CurBuffer->text[CurBuffer->preLen - 1] == '\t')
+	else if (before == '\t')
 		CurBuffer->cursorXtabed -= TAB_SIZE;
 	else 
 		CurBuffer->cursorXtabed--;
 
 	CurBuffer->curX--;
+	CurBuffer->cursorPixelX -= buffer_char_advance(before);
 	buffer_backward();
 
 }
 
+static void
+cursor_move_to_line(i32 line) {
+
+	if (line < 0)
+		line = 0;
+	if (line > (i32)CurBuffer->lineLengths.length - 1)
+		line = CurBuffer->lineLengths.length - 1;
+
+	i32 tabbed;
+	i32 col = buffer_column_from_tabbed(CurBuffer, line, CurBuffer->cursorXtabed, &tabbed);
+
+	CurBuffer->cursor = buffer_index_based_on_line(CurBuffer, line) + col;
+	CurBuffer->currentLine = line;
+	CurBuffer->curX = col;
+	CurBuffer->cursorXtabed = tabbed;
+	buffer_cursor_pixel_invalidate(CurBuffer);
+
+	window_scroll_to_line(FocusedWindow, CurBuffer, line);
+}
+
+// moves one visual row in a soft wrapped window, keeping the pixel column
+static void
+cursor_move_row(i32 direction) {
+
+	f32 width = FocusedWindow->size.w;
+	i32 line = CurBuffer->currentLine;
+	WrapLine* wrap = wrap_line_get(CurBuffer, line, width);
+	i32 row = wrap_row_of_offset(wrap, CurBuffer->curX);
+	f32 targetX = buffer_cursor_pixel_x(CurBuffer) - wrap->rows[row].pixelX;
+
+	row += direction;
+	if (row < 0) {
+
+		if (line == 0) return;
+		line = fold_prev_line(CurBuffer, line);
+		wrap = wrap_line_get(CurBuffer, line, width);
+		row = wrap->rows.length - 1;
+	}
+	else if (row >= (i32)wrap->rows.length) {
+
+		line = fold_next_line(CurBuffer, line);
+		if (line >= (i32)CurBuffer->lineLengths.length) return;
+		wrap = wrap_line_get(CurBuffer, line, width);
+		row = 0;
+	}
+
+	// a row ends where the next one starts, the last row ends before
+	// the newline
+	i32 rowEnd = wrap_row_end(CurBuffer, wrap, row) - 1;
+	if (rowEnd < wrap->rows[row].offset)
+		rowEnd = wrap->rows[row].offset;
+
+	sizet lineStart = buffer_index_based_on_line(CurBuffer, line);
+	i32 offset = wrap->rows[row].offset;
+	f32 pixelX = wrap->rows[row].pixelX;
+
+	while (offset < rowEnd) {
+
+		f32 advance = buffer_char_advance(buffer_char_at(CurBuffer, lineStart + offset));
+		if (pixelX + advance / 2.0f > wrap->rows[row].pixelX + targetX)
+			break;
+
+		pixelX += advance;
+		offset++;
+	}
+
+	CurBuffer->cursor = lineStart + offset;
+	CurBuffer->currentLine = line;
+	CurBuffer->curX = offset;
+	CurBuffer->cursorXtabed = buffer_column_at_offset(CurBuffer, line, offset);
+	buffer_cursor_pixel_set(CurBuffer, pixelX);
+}
+
 void
 cursor_down() {
 	
-	if (CurBuffer->currentLine == CurBuffer->cursorLines.length - 1) return;
+	if (FocusedWindow->softWrap) {
+		cursor_move_row(1);
+		return;
+	}
+
+	i32 next = fold_next_line(CurBuffer, CurBuffer->currentLine);
+	if (next >= (i32)CurBuffer->lineLengths.length) return;
 
+	cursor_move_to_line(next);
+}
 
-	while (char_under_cursor() != '\n') {
-		buffer_forward();
+void
+cursor_up() {
+	
+	if (FocusedWindow->softWrap) {
+		cursor_move_row(-1);
+		return;
 	}
-	buffer_forward();
-	CurBuffer->currentLine++;
 
-	u32 currLineLen = CurBuffer->cursorLines[CurBuffer->currentLine] - 1;
+	i32 prev = fold_prev_line(CurBuffer, CurBuffer->currentLine);
+	if (prev < 0) return;
 
-	if (currLineLen >= CurBuffer->cursorXtabed) {
+	cursor_move_to_line(prev);
+}
 
-		sizet prevX = CurBuffer->cursorXtabed;
-		while (prevX > 0) {
+void
+cursor_page_down() {
 
-			if (char_under_cursor() == '\t') {
-				buffer_forward();
-				prevX -= TAB_SIZE;
-			}
-			else {
-				buffer_forward();
-				prevX--;
-			}
-				
-		}
-	}
-	else {
+	// pages are counted in rows on screen, folded lines are skipped
+	i32 page = window_visible_lines(FocusedWindow);
+	i32 start = fold_row_of_line(CurBuffer, FocusedWindow->renderView.start);
+
+	FocusedWindow->renderView.start = fold_line_of_row(CurBuffer, start + page);
+
+	cursor_move_to_line(fold_line_of_row(CurBuffer,
+		fold_row_of_line(CurBuffer, CurBuffer->currentLine) + page));
+}
+
+void
+cursor_page_up() {
+
+	i32 page = window_visible_lines(FocusedWindow);
+	i32 start = fold_row_of_line(CurBuffer, FocusedWindow->renderView.start);
+
+	FocusedWindow->renderView.start = fold_line_of_row(CurBuffer, start - page);
 
+	cursor_move_to_line(fold_line_of_row(CurBuffer,
+		fold_row_of_line(CurBuffer, CurBuffer->currentLine) - page));
+}
+
+void
+cursor_line_start() {
+
+	CurBuffer->cursor = buffer_index_based_on_line(CurBuffer, CurBuffer->currentLine);
+	CurBuffer->curX = 0;
+	CurBuffer->cursorXtabed = 0;
+	CurBuffer->cursorPixelX = 0.0f;
+}
+
+void
+cursor_line_end() {
+
+	i32 line = CurBuffer->currentLine;
+	i32 lastColumn = CurBuffer->lineLengths[line] - 1;
+	if (lastColumn < 0)
+		lastColumn = 0;
+
+	sizet lineStart = buffer_index_based_on_line(CurBuffer, line);
+	CurBuffer->cursor = lineStart + lastColumn;
+
+	CurBuffer->curX = CurBuffer->cursor - lineStart;
+	CurBuffer->cursorXtabed = CurBuffer->cursorLines[line] - 1;
+	if (CurBuffer->cursorXtabed < 0)
 		CurBuffer->cursorXtabed = 0;
-		CurBuffer->curX = 0;
-		while (char_under_cursor() != '\n') {
-			
-			if (char_under_cursor() == '\t') {
-				CurBuffer->cursorXtabed += TAB_SIZE;
-			}
-			else {
-				CurBuffer->cursorXtabed++;
-			}
-			CurBuffer->curX++;
-			buffer_forward();
+	buffer_cursor_pixel_invalidate(CurBuffer);
+}
+
+static inline b8
+is_word_char(char c) {
+
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		(c >= '0' && c <= '9') || c == '_';
+}
+
+// bounds of the word under or right before the cursor
+static b8
+word_at_cursor(sizet* outStart, sizet* outEnd) {
+
+	sizet length = buffer_length(CurBuffer);
+	sizet start = CurBuffer->cursor;
+	sizet end = CurBuffer->cursor;
+
+	while (start > 0 && is_word_char(buffer_char_at(CurBuffer, start - 1)))
+		start--;
+	while (end < length && is_word_char(buffer_char_at(CurBuffer, end)))
+		end++;
+
+	*outStart = start;
+	*outEnd = end;
+	return end > start;
+}
+
+static b8
+is_word_at(String& word, sizet index, sizet length) {
+
+	if (index + word.length > length)
+		return false;
+	if (index > 0 && is_word_char(buffer_char_at(CurBuffer, index - 1)))
+		return false;
+	if (index + word.length < length &&
+		is_word_char(buffer_char_at(CurBuffer, index + word.length)))
+		return false;
+
+	for (sizet i = 0; i < word.length; ++i) {
+
+		if (buffer_char_at(CurBuffer, index + i) != word[i])
+			return false;
+	}
+
+	return true;
+}
+
+static String
+word_copy(sizet start, sizet end) {
+
+	String word = str_create(end - start);
+	for (sizet i = start; i < end; ++i)
+		str_push(&word, buffer_char_at(CurBuffer, i));
+
+	return word;
+}
+
+static Array<sizet>
+word_matches(String& word) {
+
+	Array<sizet> matches;
+	array_init(&matches, 16);
+
+	sizet length = buffer_length(CurBuffer);
+	for (sizet i = 0; i + word.length <= length; ++i) {
+
+		if (buffer_char_at(CurBuffer, i) == word[0] && is_word_at(word, i, length)) {
+			array_push(&matches, i);
+			i += word.length - 1;
 		}
 	}
 
+	return matches;
 }
 
 void
-cursor_up() {
-	
-	if (CurBuffer->currentLine == 0) return;
+cursor_add_all_matches() {
+
+	sizet start, end;
+	if (!word_at_cursor(&start, &end)) return;
+
+	String word = word_copy(start, end);
+	Array<sizet> matches = word_matches(word);
 
-	while (CurBuffer->text[CurBuffer->preLen - 1] != '\n') {
+	// every cursor sits at the end of its match
+	buffer_set_cursor(CurBuffer, end);
+	buffer_cursors_clear(CurBuffer);
+	for (sizet i = 0; i < matches.length; ++i) {
 
-		buffer_backward();
+		if (matches[i] != start)
+			array_push(&CurBuffer->cursors, matches[i] + word.length);
 	}
-	buffer_backward();
-	CurBuffer->currentLine--;
 
-	i32 backwardSteps = (CurBuffer->cursorLines[CurBuffer->currentLine] - 1) - CurBuffer->cursorXtabed;
+	array_free(&matches);
+	str_free(&word);
+}
 
-	if (backwardSteps > 0) {
+void
+cursor_add_next_match() {
+
+	sizet start, end;
+	if (!word_at_cursor(&start, &end)) return;
+
+	String word = word_copy(start, end);
+	sizet length = buffer_length(CurBuffer);
+
+	sizet from = end;
+	if (CurBuffer->cursors.length && CurBuffer->cursors[CurBuffer->cursors.length - 1] > from)
+		from = CurBuffer->cursors[CurBuffer->cursors.length - 1];
+
+	for (sizet i = from; i + word.length <= length; ++i) {
 
-		while (backwardSteps > 0) {
+		if (is_word_at(word, i, length)) {
 
-			buffer_backward();
-			if (CurBuffer->text[CurBuffer->preLen] == '\t')
-				backwardSteps -= TAB_SIZE;
-			else
-				backwardSteps--;
+			buffer_set_cursor(CurBuffer, end);
+			array_push(&CurBuffer->cursors, i + word.length);
+			break;
 		}
 	}
+
+	str_free(&word);
+}
+
+void
+cursor_rename_word(const char* name, sizet length) {
+
+	sizet start, end;
+	if (!word_at_cursor(&start, &end)) return;
+
+	String word = word_copy(start, end);
+	Array<sizet> matches = word_matches(word);
+
+	sizet main = 0;
+	for (sizet i = 0; i < matches.length; ++i) {
+
+		if (matches[i] == start)
+			main = i;
+	}
+
+	// all occurrences are rewritten in one pass over the buffer
+	buffer_cursors_clear(CurBuffer);
+	buffer_replace_at(CurBuffer, &matches, word.length, name, length);
+	CurBuffer->cursor = matches[main];
+	buffer_rebuild_lines(CurBuffer);
+
+	array_free(&matches);
+	str_free(&word);
+}
+
+b8
+cursor_screen_pos(Buffer* buf, Window* win, sizet index, Vec2* out) {
+
+	i32 line = buffer_line_based_on_index(buf, index);
+	if (fold_hidden(buf, line))
+		return false;
+
+	i32 offset = index - buffer_index_based_on_line(buf, line);
+	f32 pixelX = buffer_pixel_at_offset(buf, line, offset);
+
+	if (win->softWrap) {
+
+		WrapLine* wrap = wrap_line_get(buf, line, win->size.w);
+		i32 row = wrap_row_of_offset(wrap, offset);
+
+		out->x = win->position.x + pixelX - wrap->rows[row].pixelX;
+		out->y = win->position.y + renderer_font_size() *
+			window_rows_before(win, buf, line, row);
+	}
 	else {
-		
-		CurBuffer->cursorXtabed = CurBuffer->cursorLines[CurBuffer->currentLine] - 1;
-		CurBuffer->curX = CurBuffer->lineLengths[CurBuffer->currentLine] - 1;
+
+		i32 column;
+		f32 viewX;
+		buffer_offset_at_column(buf, line, win->columnStart, &column, &viewX);
+
+		out->x = win->position.x + pixelX - viewX;
+		out->y = win->position.y + renderer_font_size() * window_rows_before(win, buf, line, 0);
 	}
 
+	return out->x >= win->position.x && out->x < win->position.x + win->size.w &&
+		out->y >= win->position.y && out->y < win->position.y + win->size.h;
+}
+
+void
+cursor_goto_line(i32 line) {
+
+	CurBuffer->cursorXtabed = 0;
+	fold_reveal(CurBuffer, line);
+	cursor_move_to_line(line);
+}
+
+// the bracket under the cursor, or the one right before it, and its match
+b8
+cursor_bracket_pair(Buffer* buf, sizet* bracket, sizet* match) {
+
+	*bracket = buf->cursor;
+	if (brackets_match(buf, *bracket, match))
+		return true;
+
+	if (buf->cursor == 0) return false;
+
+	*bracket = buf->cursor - 1;
+	return brackets_match(buf, *bracket, match);
+}
+
+void
+cursor_bracket_match() {
+
+	sizet bracket, match;
+	if (cursor_bracket_pair(CurBuffer, &bracket, &match))
+		buffer_set_cursor(CurBuffer, match);
+}
+
+void
+cursor_scope_start() {
+
+	sizet open, close;
+	if (brackets_enclosing(CurBuffer, CurBuffer->cursor, &open, &close))
+		buffer_set_cursor(CurBuffer, open);
+}
+
+void
+cursor_scope_end() {
+
+	sizet open, close;
+	if (!brackets_enclosing(CurBuffer, CurBuffer->cursor, &open, &close))
+		return;
+
+	// already on the close, the next scope out
+	if (close == CurBuffer->cursor &&
+		!brackets_enclosing(CurBuffer, CurBuffer->cursor + 1, &open, &close))
+		return;
+
+	buffer_set_cursor(CurBuffer, close);
+}
+
+void
+cursor_fold_toggle() {
+
+	if (!fold_toggle(CurBuffer, CurBuffer->cursor))
+		return;
+
+	// folding the scope around the cursor hides its line
+	i32 line = fold_visible_line(CurBuffer, CurBuffer->currentLine);
+	if (line != CurBuffer->currentLine)
+		cursor_move_to_line(line);
 }
 
+void
+cursor_folds_clear() {
+
+	folds_clear(CurBuffer);
+}
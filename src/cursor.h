@@ -16,5 +16,20 @@ void cursor_right();
 void cursor_left();
 void cursor_up();
 void cursor_down();
+void cursor_page_up();
+void cursor_page_down();
+void cursor_goto_line(i32 line);
+void cursor_line_start();
+void cursor_line_end();
+void cursor_add_all_matches();
+void cursor_add_next_match();
+void cursor_rename_word(const char* name, sizet length);
+b8 cursor_screen_pos(Buffer* buf, Node* win, sizet index, Vec2* out);
 char char_under_cursor();
+b8 cursor_bracket_pair(Buffer* buf, sizet* bracket, sizet* match);
+void cursor_bracket_match();
+void cursor_scope_start();
+void cursor_scope_end();
+void cursor_fold_toggle();
+void cursor_folds_clear();
 
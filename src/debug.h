@@ -44,7 +44,7 @@
         #else
 
 			#define ASSERT(condition) 
-			#define ASSERT_MSG(condition) 
+			#define ASSERT_MSG(condition, message) 
 
         #endif
 
@@ -8,19 +8,15 @@
 #include "command.h"
 #include "bind.h"
 #include "config.h"
+#include "profiler.h"
+#include "syntax.h"
+#include "session.h"
+#include "journal.h"
+#include "follow.h"
+#include "reload.h"
 
 #include "globals.h"
 
-Buffer* CurBuffer;
-Window* FocusedWindow;
-Buffer* PrevBuffer;
-i32 TheWidth;
-i32 TheHeight;
-InputMode InputMod;
-bool just_entered_edit_mode;
-Node* WinTree;
-Array<Token> Tokens;
-
 /* TODO:
    - red black trees
    - undo redo
@@ -28,16 +24,56 @@ Array<Token> Tokens;
  */
 
 
+#ifdef WINDOWS_PLATFORM
+#define SESSION_FILE "\\session.dat"
+#elif LINUX_PLATFORM
+#define SESSION_FILE "/session.dat"
+#endif
+
 static GLFWwindow* GLFWwin;
 
-void 
-editor_change_mode(InputMode mode) {
+// kept where the editor was started, find-file changes the cwd
+static String SessionPath;
+
+// input events handled this frame, their latency is recorded after swap
+#define FRAME_INPUTS_MAX 64
+static u64 FrameInputs[FRAME_INPUTS_MAX];
+static i32 FrameInputCount;
+
+
+// called from the tokenizer thread when a token set is done, glfwWaitEvents
+// would sleep through it otherwise
+static void
+wake_main_thread() {
 
-	Modes[InputMod]->on_end();
-	Modes[mode]->on_start();
-	InputMod = mode;
+	glfwPostEmptyEvent();
 }
 
+static void
+open_test_file() {
+
+	const char* testFileName = 
+#ifdef WINDOWS_PLATFORM 
+    "\\test_file.txt";
+#else LINUX_PLATFORM 
+    "/test_file.txt";
+#endif
+	String filepath = str_create(10);
+
+	String cwd = fileio_get_cwd();
+	for (sizet i = 0; i < cwd.length; ++i) {
+		str_push(&filepath, cwd[i]);
+	}
+	for (sizet i = 0; i < strlen(testFileName); ++i) {
+
+		str_push(&filepath, testFileName[i]);
+	}
+
+	File testFile = file_open(filepath.as_cstr());
+	CurBuffer = buffer_add(testFile);
+
+	windows_init(CurBuffer);
+}
 
 i32
 main(int argc, char* argv[]) {
@@ -57,63 +93,86 @@ main(int argc, char* argv[]) {
 	renderer_load_font("assets/CONSOLA.ttf", 18);
 #endif
 
+	profiler_init();
+	syntax_init(wake_main_thread);
+	journal_init();
+	follow_init(wake_main_thread);
+	reload_init(wake_main_thread);
 	fileio_update_cwd();
+	SessionPath = str_create(fileio_get_cwd());
+	str_concat(&SessionPath, (char*)SESSION_FILE);
 	commands_init();
 	bindings_init();
 
 	config_read("config.txt");
-
-	const char* testFileName = 
-#ifdef WINDOWS_PLATFORM 
-    "\\test_file.txt";
-#else LINUX_PLATFORM 
-    "/test_file.txt";
-#endif
-	String filepath = str_create(10);
-
-	String cwd = fileio_get_cwd();
-	for (sizet i = 0; i < cwd.length; ++i) {
-		str_push(&filepath, cwd[i]);
-	}
-	for (sizet i = 0; i < strlen(testFileName); ++i) {
-
-		str_push(&filepath, testFileName[i]);
-	}
-
-	File testFile = file_open(filepath.as_cstr());
 	buffers_init();
-	buffer_add(testFile);
-	CurBuffer = buffer_get(filepath.as_cstr());
 
-	windows_init(CurBuffer);
+	// the last session, or the test file when there is none
+	if (!session_restore(SessionPath.as_cstr()))
+		open_test_file();
 
 	for (sizet i = 0; i < MODES_TOTAL; ++i) {
 		Modes[i]->on_init();
 	}
 
 
+	// the button events carry no position, the last move has it
+	Vec2i mouse = {0, 0};
+
 	while (!glfwWindowShouldClose(GLFWwin)) {
 		
 		Event event;
-		while(event_queue_next(&event)) { 
-			Modes[InputMod]->on_event(event);
-
-			if	(event.type == WINDOW_RESIZED) {
-
-				TheWidth = event.width;
-				TheHeight = event.height;
-				renderer_on_window_resize(event.width, event.height);
-			}
-		} 
-
-        Tokens = tokens_make(buffer_get_text_copy(CurBuffer));
-
+		{
+			PROFILE_ZONE("events");
+			while(event_queue_next(&event)) { 
+				Modes[InputMod]->on_event(event);
+
+				// a typed character also comes as a char event after its
+				// key, one sample per keystroke
+				if ((event.type == KEY_PRESSED || event.type == KEY_REPEAT) &&
+					FrameInputCount < FRAME_INPUTS_MAX)
+					FrameInputs[FrameInputCount++] = event.time;
+
+				if (event.type == MOUSE_MOVED) {
+
+					mouse.x = event.x;
+					mouse.y = event.y;
+				}
+
+				if (event.type == MOUSE_BUTTON_PRESSED && event.button == MOUSE_LEFT)
+					window_focus(window_at_point(mouse));
+
+				if	(event.type == WINDOW_RESIZED) {
+
+					TheWidth = event.width;
+					TheHeight = event.height;
+					renderer_on_window_resize(event.width, event.height);
+				}
+			} 
+		}
+
+		{
+			PROFILE_ZONE("follow");
+			// a burst longer than one read is picked up on the next frame
+			if (follow_poll())
+				wake_main_thread();
+		}
+		{
+			PROFILE_ZONE("reload");
+			reload_poll();
+		}
 
 		renderer_begin();
 
 
-		window_render_all();
-		Modes[InputMod]->update();
+		{
+			PROFILE_ZONE("window_render_all");
+			window_render_all();
+		}
+		{
+			PROFILE_ZONE("mode update");
+			Modes[InputMod]->update();
+		}
 
 #ifdef DEBUG
 		Vec2 pos;
@@ -130,9 +189,10 @@ main(int argc, char* argv[]) {
 		DEBUG_TEXT(pos, "pre length %i", (i32)CurBuffer->preLen); pos.y += 20.0f;
 		DEBUG_TEXT(pos, "post length %i", (i32)CurBuffer->postLen); pos.y += 20.0f;
 		DEBUG_TEXT(pos, "gap length %i", (i32)CurBuffer->gapLen); pos.y += 20.0f;
-		if (CurBuffer->preLen != 0) 
-			DEBUG_TEXT(pos, "char before cursor %c", (i32)CurBuffer->text[CurBuffer->preLen - 1]); pos.y += 20.0f;
-		DEBUG_TEXT(pos, "char under cursor %c", (i32)CurBuffer->text[CurBuffer->preLen + CurBuffer->gapLen]); pos.y += 20.0f;
+		DEBUG_TEXT(pos, "cursor %i", (i32)CurBuffer->cursor); pos.y += 20.0f;
+		if (CurBuffer->cursor != 0) 
+			DEBUG_TEXT(pos, "char before cursor %c", (i32)buffer_char_at(CurBuffer, CurBuffer->cursor - 1)); pos.y += 20.0f;
+		DEBUG_TEXT(pos, "char under cursor %c", (i32)buffer_char_at(CurBuffer, CurBuffer->cursor)); pos.y += 20.0f;
 		DEBUG_TEXT(pos, "RenderView start %i", FocusedWindow->renderView.start); pos.y += 20.0f;
 		DEBUG_TEXT(pos, "RenderView  end %i", FocusedWindow->renderView.end); pos.y += 20.0f;
 		DEBUG_TEXT(pos, "Width %i", TheWidth); pos.y += 20.0f;
@@ -142,16 +202,32 @@ main(int argc, char* argv[]) {
 		DEBUG_TEXT(pos, "Mode %s", mode.data); pos.y += 20.0f;
 #endif
 
-		renderer_end();
+		profiler_render({10.0f, 10.0f});
+
+		{
+			PROFILE_ZONE("renderer_end");
+			renderer_end();
+		}
 
-        array_free(&Tokens);
+		{
+			PROFILE_ZONE("swap");
+			glfwSwapBuffers(GLFWwin);
+		}
 
-		glfwSwapBuffers(GLFWwin);
+		for (i32 i = 0; i < FrameInputCount; ++i)
+			profiler_latency_record(FrameInputs[i]);
+		FrameInputCount = 0;
 
 		glfwWaitEvents();
 
 	}
 
+	session_save(SessionPath.as_cstr());
+	reload_shutdown();
+	follow_shutdown();
+	journal_shutdown();
+	syntax_shutdown();
+
 	return 0;
 }
 /*
@@ -1,4 +1,5 @@
 #include "event.h"
+#include "profiler.h"
 
 #include <glad/glad.h>
 #include <stdlib.h>
@@ -16,6 +17,7 @@ cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
 	gEventQueue.tail->type = MOUSE_MOVED;
 	gEventQueue.tail->x = xpos;
 	gEventQueue.tail->y = ypos;
+	gEventQueue.tail->time = profiler_now();
 	gEventQueue.tail++;
 
 }
@@ -28,12 +30,14 @@ mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
 			gEventQueue.tail->type = MOUSE_BUTTON_PRESSED;
 			gEventQueue.tail->button = button;
 			gEventQueue.tail->mods = mods;
+			gEventQueue.tail->time = profiler_now();
 			gEventQueue.tail++;
 			break;
 		case GLFW_RELEASE:
 			gEventQueue.tail->type = MOUSE_BUTTON_RELEASED;
 			gEventQueue.tail->button = button;
 			gEventQueue.tail->mods = mods;
+			gEventQueue.tail->time = profiler_now();
 			gEventQueue.tail++;
 			break;
 
@@ -47,6 +51,7 @@ scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 	gEventQueue.tail->type = MOUSE_SCROLLED;
 	gEventQueue.tail->offsetX = xoffset;
 	gEventQueue.tail->offsetY = yoffset;
+	gEventQueue.tail->time = profiler_now();
 	gEventQueue.tail++;
 
 }
@@ -59,6 +64,7 @@ key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
 			gEventQueue.tail->type = KEY_PRESSED;
 			gEventQueue.tail->mods = mods;
 			gEventQueue.tail->key = key;
+			gEventQueue.tail->time = profiler_now();
 			gEventQueue.tail++;
 			break;
 		}
@@ -66,6 +72,7 @@ key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
 			gEventQueue.tail->type = KEY_RELEASED;
 			gEventQueue.tail->mods = mods;
 			gEventQueue.tail->key = key;
+			gEventQueue.tail->time = profiler_now();
 			gEventQueue.tail++;
 			break;
 		}
@@ -73,6 +80,7 @@ key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
 			gEventQueue.tail->type = KEY_REPEAT;
 			gEventQueue.tail->mods = mods;
 			gEventQueue.tail->key = key;
+			gEventQueue.tail->time = profiler_now();
 			gEventQueue.tail++;
 			break;
 		}
@@ -87,6 +95,7 @@ char_callback(GLFWwindow *window, unsigned int c) {
 
 	gEventQueue.tail->type = CHAR_INPUTED;
 	gEventQueue.tail->character = c;
+	gEventQueue.tail->time = profiler_now();
 	gEventQueue.tail++;
 }
 
@@ -103,6 +112,7 @@ window_resize_callback(GLFWwindow* window, int width, int height) {
 	gEventQueue.tail->type = WINDOW_RESIZED;
 	gEventQueue.tail->width = width;
 	gEventQueue.tail->height = height;
+	gEventQueue.tail->time = profiler_now();
 	gEventQueue.tail++;
 	
 }
@@ -23,6 +23,8 @@ typedef enum EventType {
 typedef struct Event {
 
 	EventType type;
+	// profiler ticks when the glfw callback queued the event
+	u64 time;
 	union {
 		struct {
 			int x, y;
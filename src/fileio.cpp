@@ -2,9 +2,12 @@
 #include "types.h"
 #include "debug.h"
 #include "globals.h"
+#include "journal.h"
 
 
 
+#include <sys/stat.h>
+
 #ifdef LINUX_PLATFORM
 #include <unistd.h>
 #include <dirent.h>
@@ -169,22 +172,65 @@ file_exists(const char* filepath) {
 	return true;
 }
 
+// modification time and size of the file, false when it can not be read
+b8
+file_stamp(const char* path, u64* time, sizet* size) {
+#ifdef LINUX_PLATFORM
+	struct stat info;
+	if (stat(path, &info) != 0)
+		return false;
+
+	*time = (u64)info.st_mtim.tv_sec * 1000000000ull + info.st_mtim.tv_nsec;
+#elif WINDOWS_PLATFORM
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0)
+		return false;
+
+	*time = (u64)info.st_mtime * 1000000000ull;
+#endif
+	*size = (sizet)info.st_size;
+
+	return true;
+}
+
 void
 file_save() {
 	
+	// only a slice of it is in the buffer
+	if (CurBuffer->large) {
+		ALERT_MSG("Not saved, %s is read only \n", CurBuffer->path.as_cstr());
+		return;
+	}
+
 	String data = buffer_get_text_copy(CurBuffer);
 	String path = CurBuffer->path;
 	FILE* fp = fopen(path.as_cstr(), "w");
 
+	// the journal is the only copy of the edits until the file is on disk
+	// whole, it is only cut after the write, the close and a sync
+	b8 saved = false;
 	if (fp) {
-		fprintf(fp, "%s", data.as_cstr());
+
+		saved = fwrite(data.data, 1, data.length, fp) == data.length && fflush(fp) == 0;
+#ifdef LINUX_PLATFORM
+		saved = saved && fsync(fileno(fp)) == 0;
+#elif WINDOWS_PLATFORM
+		saved = saved && _commit(_fileno(fp)) == 0;
+#endif
+		saved = fclose(fp) == 0 && saved;
+	}
+
+	if (saved) {
 		NORMAL_MSG("File saved: %s \n", path.as_cstr());
+		CurBuffer->state = BUFFER_RESIDENT;
+		file_stamp(path.as_cstr(), &CurBuffer->fileTime, &CurBuffer->fileSize);
+		journal_saved(CurBuffer);
 	}
 	else {
 		ALERT_MSG("Failed to save: %s \n", path.as_cstr());
 	}
 
-	fclose(fp);
+	str_free(&data);
 }
 
 String&
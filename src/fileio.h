@@ -17,6 +17,7 @@ void fileio_update_cwd();
 File file_open(const char* path);
 void file_save();
 b8 file_exists(const char* path);
+b8 file_stamp(const char* path, u64* time, sizet* size);
 u8* image_load_png(const char* path, i32* x, i32* y, i32* bpp);
 void image_free(u8* data);
 Array<String> fileio_cwd_file_names();
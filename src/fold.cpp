@@ -0,0 +1,441 @@
+#include "fold.h"
+#include "buffer.h"
+#include "syntax.h"
+#include "brackets.h"
+#include "debug.h"
+
+#define FOLD_OPENS_MAX 32
+
+/* a fold hides the lines below its header up to its end. everything that
+   walks the screen goes through the visible line mapping here, a fenwick
+   tree holding 1 for every visible line, so scrolling and rendering cost
+   the same whatever is folded away. without folds the mapping is the
+   identity and no tree is built.
+ */
+
+static void
+fold_index_build(Buffer* buf) {
+
+	sizet count = buf->lineLengths.length;
+
+	array_reset(&buf->foldIndex);
+	while (buf->foldIndex.capacity < count + 1)
+		array_expand(&buf->foldIndex);
+
+	buf->foldIndex.length = count + 1;
+	buf->foldIndex.data[0] = 0;
+	for (sizet i = 1; i <= count; ++i)
+		buf->foldIndex.data[i] = 1;
+
+	for (sizet f = 0; f < buf->folds.length; ++f) {
+
+		FoldRange* fold = &buf->folds[f];
+		for (i32 line = fold->header + 1; line <= fold->end && line < (i32)count; ++line)
+			buf->foldIndex.data[line + 1] = 0;
+	}
+
+	for (sizet i = 1; i <= count; ++i) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->foldIndex.data[parent] += buf->foldIndex.data[i];
+	}
+
+	buf->foldIndexDirty = false;
+	buf->foldIndexStale = INT32_MAX;
+}
+
+// last fold with its header at or above line, null when there is none
+static FoldRange*
+fold_before(Buffer* buf, i32 line) {
+
+	sizet low = 0;
+	sizet high = buf->folds.length;
+	while (low < high) {
+
+		sizet mid = (low + high) / 2;
+		if (buf->folds[mid].header <= line)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low ? &buf->folds[low - 1] : NULL;
+}
+
+// rebuilds the nodes after the stale line, a node before it only covers
+// lines before it. the nodes before it with a parent after it are the
+// ones a prefix query of the line walks.
+static void
+fold_index_shift(Buffer* buf) {
+
+	sizet count = buf->lineLengths.length;
+	sizet line = buf->foldIndexStale < (i32)count ? buf->foldIndexStale : count;
+
+	while (buf->foldIndex.capacity < count + 1)
+		array_expand(&buf->foldIndex);
+	buf->foldIndex.length = count + 1;
+
+	for (sizet i = line + 1; i <= count; ++i)
+		buf->foldIndex.data[i] = 1;
+
+	FoldRange* first = fold_before(buf, line);
+	for (sizet f = first ? first - buf->folds.data : 0; f < buf->folds.length; ++f) {
+
+		FoldRange* fold = &buf->folds[f];
+		i32 start = fold->header + 1 > (i32)line ? fold->header + 1 : (i32)line;
+		for (i32 hidden = start; hidden <= fold->end && hidden < (i32)count; ++hidden)
+			buf->foldIndex.data[hidden + 1] = 0;
+	}
+
+	for (sizet i = line; i > 0; i -= i & (~i + 1)) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->foldIndex.data[parent] += buf->foldIndex.data[i];
+	}
+
+	for (sizet i = line + 1; i <= count; ++i) {
+
+		sizet parent = i + (i & (~i + 1));
+		if (parent <= count)
+			buf->foldIndex.data[parent] += buf->foldIndex.data[i];
+	}
+
+	buf->foldIndexStale = INT32_MAX;
+}
+
+static void
+fold_index_update(Buffer* buf) {
+
+	if (buf->foldIndexDirty)
+		fold_index_build(buf);
+	else if (buf->foldIndexStale != INT32_MAX)
+		fold_index_shift(buf);
+}
+
+static void
+fold_add(Buffer* buf, i32 header, i32 end) {
+
+	// folds inside the new one are dropped, they come back unfolded
+	sizet kept = 0;
+	for (sizet i = 0; i < buf->folds.length; ++i) {
+
+		FoldRange fold = buf->folds[i];
+		if (fold.header <= end && fold.end >= header)
+			continue;
+
+		buf->folds.data[kept++] = fold;
+	}
+	buf->folds.length = kept;
+
+	FoldRange fold = {header, end};
+	FoldRange* before = fold_before(buf, header);
+	array_insert(&buf->folds, fold, before ? before - buf->folds.data + 1 : 0);
+
+	buf->foldIndexDirty = true;
+}
+
+// leading whitespace in tabbed columns, -1 for a blank line
+static i32
+line_indent(Buffer* buf, i32 line) {
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	sizet length = buffer_length(buf);
+
+	i32 indent = 0;
+	for (sizet i = start; i < length; ++i) {
+
+		char c = buffer_char_at(buf, i);
+		if (c == ' ')
+			indent++;
+		else if (c == '\t')
+			indent += TAB_SIZE;
+		else if (c == '\n' || c == '\r')
+			return -1;
+		else
+			return indent;
+	}
+
+	return -1;
+}
+
+// last line of the block indented deeper than header, blank lines inside
+// it belong to it, the ones after it do not
+static i32
+indented_block_end(Buffer* buf, i32 header) {
+
+	i32 indent = line_indent(buf, header);
+	i32 last = header;
+
+	if (indent < 0)
+		return last;
+
+	for (i32 line = header + 1; line < (i32)buf->lineLengths.length; ++line) {
+
+		i32 lineIndent = line_indent(buf, line);
+		if (lineIndent < 0)
+			continue;
+		if (lineIndent <= indent)
+			break;
+
+		last = line;
+	}
+
+	return last;
+}
+
+static b8
+is_open_bracket(u8 type) {
+
+	return type == TOK_OPEN_CURLY || type == TOK_OPEN_PAREN || type == TOK_OPEN_SQUARE;
+}
+
+// region to fold for the cursor at index: a scope opened on its line, the
+// block indented under its line, the scope around it, or the block its
+// line is indented in, the first of these that spans more than one line
+static b8
+fold_region(Buffer* buf, sizet index, i32* header, i32* end) {
+
+	i32 line = buffer_line_based_on_index(buf, index);
+	sizet lineStart = buffer_index_based_on_line(buf, line);
+
+	// the line tokens may not outlive the next query, the opens are kept
+	sizet opens[FOLD_OPENS_MAX];
+	u32 openCount = 0;
+
+	u32 count;
+	Token* tokens = syntax_line(buf, line, lineStart, &count);
+	for (u32 i = count; i-- > 0 && openCount < FOLD_OPENS_MAX;) {
+		if (is_open_bracket(tokens[i].type))
+			opens[openCount++] = lineStart + tokens[i].offset;
+	}
+
+	for (u32 i = 0; i < openCount; ++i) {
+
+		sizet close;
+		if (!brackets_match(buf, opens[i], &close))
+			continue;
+
+		i32 closeLine = buffer_line_based_on_index(buf, close);
+		if (closeLine > line + 1) {
+			*header = line;
+			*end = closeLine - 1;
+			return true;
+		}
+	}
+
+	i32 last = indented_block_end(buf, line);
+	if (last > line) {
+		*header = line;
+		*end = last;
+		return true;
+	}
+
+	sizet open, close;
+	sizet from = index;
+	while (brackets_enclosing(buf, from, &open, &close)) {
+
+		i32 openLine = buffer_line_based_on_index(buf, open);
+		i32 closeLine = buffer_line_based_on_index(buf, close);
+		if (closeLine > openLine + 1) {
+			*header = openLine;
+			*end = closeLine - 1;
+			return true;
+		}
+
+		// an open at from starts a scope inside, the next query goes out
+		from = open;
+	}
+
+	i32 indent = line_indent(buf, line);
+	for (i32 above = line - 1; above >= 0 && indent > 0; --above) {
+
+		i32 aboveIndent = line_indent(buf, above);
+		if (aboveIndent < 0 || aboveIndent >= indent)
+			continue;
+
+		*header = above;
+		*end = indented_block_end(buf, above);
+		return true;
+	}
+
+	return false;
+}
+
+
+b8
+fold_hidden(Buffer* buf, i32 line) {
+
+	FoldRange* fold = fold_before(buf, line);
+	return fold && line > fold->header && line <= fold->end;
+}
+
+// the line itself, or the header of the fold hiding it
+i32
+fold_visible_line(Buffer* buf, i32 line) {
+
+	FoldRange* fold = fold_before(buf, line);
+	if (fold && line > fold->header && line <= fold->end)
+		return fold->header;
+
+	return line;
+}
+
+// next visible line after line, the line count past the last one
+i32
+fold_next_line(Buffer* buf, i32 line) {
+
+	FoldRange* fold = fold_before(buf, line);
+	if (fold && line <= fold->end)
+		return fold->end + 1;
+
+	return line + 1;
+}
+
+// previous visible line before line, -1 above the first one
+i32
+fold_prev_line(Buffer* buf, i32 line) {
+
+	if (line <= 0) return -1;
+
+	return fold_visible_line(buf, line - 1);
+}
+
+// visible lines above line, its row on screen counted from the top
+i32
+fold_row_of_line(Buffer* buf, i32 line) {
+
+	if (!buf->folds.length)
+		return line;
+
+	fold_index_update(buf);
+
+	if (line > (i32)buf->lineLengths.length)
+		line = buf->lineLengths.length;
+
+	i32 row = 0;
+	for (sizet i = line; i > 0; i -= i & (~i + 1))
+		row += buf->foldIndex.data[i];
+
+	return row;
+}
+
+// the visible line shown at row, clamped to the first and the last
+i32
+fold_line_of_row(Buffer* buf, i32 row) {
+
+	i32 count = buf->lineLengths.length;
+
+	if (row < 0)
+		row = 0;
+
+	if (!buf->folds.length)
+		return row < count ? row : count - 1;
+
+	fold_index_update(buf);
+
+	sizet step = 1;
+	while (step * 2 <= (sizet)count)
+		step *= 2;
+
+	// descend to the last line with exactly row visible lines above it
+	sizet line = 0;
+	for (; step > 0; step /= 2) {
+
+		if (line + step <= (sizet)count && buf->foldIndex.data[line + step] <= row) {
+			line += step;
+			row -= buf->foldIndex.data[line];
+		}
+	}
+
+	if (line >= (sizet)count)
+		return fold_visible_line(buf, count - 1);
+
+	return (i32)line;
+}
+
+i32
+fold_visible_count(Buffer* buf) {
+
+	return fold_row_of_line(buf, buf->lineLengths.length);
+}
+
+// unfolds the fold headed by the line at index, or folds the region
+// around it, false when there was nothing to fold
+b8
+fold_toggle(Buffer* buf, sizet index) {
+
+	i32 line = buffer_line_based_on_index(buf, index);
+
+	FoldRange* fold = fold_before(buf, line);
+	if (fold && fold->header == line) {
+
+		array_erase(&buf->folds, fold - buf->folds.data);
+		buf->foldIndexDirty = true;
+		return true;
+	}
+
+	i32 header, end;
+	if (!fold_region(buf, index, &header, &end))
+		return false;
+
+	fold_add(buf, header, end);
+	return true;
+}
+
+// opens the fold hiding line
+void
+fold_reveal(Buffer* buf, i32 line) {
+
+	FoldRange* fold = fold_before(buf, line);
+	if (!fold || line <= fold->header || line > fold->end)
+		return;
+
+	array_erase(&buf->folds, fold - buf->folds.data);
+	buf->foldIndexDirty = true;
+}
+
+void
+folds_clear(Buffer* buf) {
+
+	array_reset(&buf->folds);
+	buf->foldIndexDirty = true;
+}
+
+// folds below the edit move with it, an edit reaching into a fold other
+// than rewriting its header in place opens it
+void
+folds_follow_edit(Buffer* buf, i32 line, i32 removed, i32 added) {
+
+	if (!buf->folds.length) return;
+
+	// the first line whose visibility or place changes, an opened fold
+	// shows the lines below its header again
+	i32 from = line;
+
+	sizet kept = 0;
+	for (sizet i = 0; i < buf->folds.length; ++i) {
+
+		FoldRange fold = buf->folds[i];
+
+		if (line + removed <= fold.header) {
+			fold.header += added - removed;
+			fold.end += added - removed;
+		}
+		else if (line <= fold.end &&
+				 !(line == fold.header && removed == 1 && added == 1)) {
+			if (fold.header + 1 < from)
+				from = fold.header + 1;
+			continue;
+		}
+
+		buf->folds.data[kept++] = fold;
+	}
+
+	if ((kept != buf->folds.length || removed != added) &&
+		from < buf->foldIndexStale)
+		buf->foldIndexStale = from;
+
+	buf->folds.length = kept;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+
+b8 fold_hidden(Buffer* buf, i32 line);
+i32 fold_visible_line(Buffer* buf, i32 line);
+i32 fold_next_line(Buffer* buf, i32 line);
+i32 fold_prev_line(Buffer* buf, i32 line);
+i32 fold_row_of_line(Buffer* buf, i32 line);
+i32 fold_line_of_row(Buffer* buf, i32 row);
+i32 fold_visible_count(Buffer* buf);
+
+b8 fold_toggle(Buffer* buf, sizet index);
+void fold_reveal(Buffer* buf, i32 line);
+void folds_clear(Buffer* buf);
+void folds_follow_edit(Buffer* buf, i32 line, i32 removed, i32 added);
@@ -0,0 +1,406 @@
+#include "follow.h"
+#include "buffer.h"
+#include "window.h"
+#include "fileio.h"
+#include "globals.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#ifdef LINUX_PLATFORM
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#include <io.h>
+#endif
+
+#define FOLLOW_BLOCK_SIZE (4 << 20)
+// read for one buffer before the frame goes on, the rest comes next frame
+#define FOLLOW_READ_MAX (32 << 20)
+#define FOLLOW_TICK_MS 100
+
+/* a followed buffer gets what was written to the end of its file since it
+   was read appended to it, its lines are extended in place. the follow
+   thread only waits for the files to change, with inotify on linux and a
+   tick on windows, and wakes the main thread, which reads the new bytes
+   from the offset it got to. the file is opened by its path for every
+   read, a log rotated under the same name is followed from its start.
+   cursors on the last line stay on it.
+ */
+
+typedef struct Followed {
+
+	Buffer* buf;
+	// bytes of the file in the buffer
+	u64 offset;
+	i32 watch;
+
+} Followed;
+
+#ifdef LINUX_PLATFORM
+static pthread_t Watcher;
+static i32 Notify = -1;
+#elif WINDOWS_PLATFORM
+static HANDLE Watcher;
+#endif
+
+static b8 Running;
+static FollowWake Wake;
+static u64 Quit;
+// bumped by the follow thread, read by the main thread
+static u64 Changes;
+// main thread only
+static u64 Seen;
+static b8 Pending;
+static u64 Active;
+static Array<Followed> Follows;
+static char* Block;
+
+
+static u64
+load_acquire(u64* value) {
+#ifdef LINUX_PLATFORM
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif WINDOWS_PLATFORM
+	u64 out = *(volatile u64*)value;
+	_ReadWriteBarrier();
+	return out;
+#endif
+}
+
+static void
+store_release(u64* value, u64 to) {
+#ifdef LINUX_PLATFORM
+	__atomic_store_n(value, to, __ATOMIC_RELEASE);
+#elif WINDOWS_PLATFORM
+	_ReadWriteBarrier();
+	*(volatile u64*)value = to;
+#endif
+}
+
+
+// follow thread
+
+static void
+watcher_run() {
+
+#ifdef LINUX_PLATFORM
+	char events[4096];
+	struct pollfd notify = {Notify, POLLIN, 0};
+
+	while (!load_acquire(&Quit)) {
+
+		if (poll(&notify, 1, FOLLOW_TICK_MS) <= 0)
+			continue;
+
+		// the events only say that something changed, every followed
+		// file is checked
+		while (read(Notify, events, sizeof(events)) > 0) {}
+
+		store_release(&Changes, Changes + 1);
+		Wake();
+	}
+#elif WINDOWS_PLATFORM
+	while (!load_acquire(&Quit)) {
+
+		Sleep(FOLLOW_TICK_MS);
+		if (!load_acquire(&Active))
+			continue;
+
+		store_release(&Changes, Changes + 1);
+		Wake();
+	}
+#endif
+}
+
+#ifdef LINUX_PLATFORM
+static void*
+watcher_main(void*) {
+
+	watcher_run();
+	return NULL;
+}
+#elif WINDOWS_PLATFORM
+static DWORD WINAPI
+watcher_main(LPVOID) {
+
+	watcher_run();
+	return 0;
+}
+#endif
+
+
+// main thread
+
+static i32
+watch_add(const char* path) {
+#ifdef LINUX_PLATFORM
+	if (Notify < 0) return -1;
+	return inotify_add_watch(Notify, path, IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+#elif WINDOWS_PLATFORM
+	return 0;
+#endif
+}
+
+static void
+watch_remove(i32 watch) {
+#ifdef LINUX_PLATFORM
+	if (Notify >= 0 && watch >= 0)
+		inotify_rm_watch(Notify, watch);
+#endif
+}
+
+static void
+follow_stop(sizet index) {
+
+	watch_remove(Follows[index].watch);
+	Follows[index].buf->followed = false;
+	array_erase(&Follows, index);
+
+	store_release(&Active, Follows.length);
+}
+
+// the text read so far is dropped, the file is read again from its start
+static void
+follow_restart(Followed* follow) {
+
+	Buffer* buf = follow->buf;
+	i32 removed = (i32)buf->lineLengths.length;
+
+	buffer_splice(buf, 0, buffer_length(buf), "", 0);
+
+	// nothing is left to point into, as for a new slice of a large file
+	array_reset(&buf->cursors);
+	for (sizet i = 0; i < buf->views.length; ++i) {
+		buf->views[i].cursor = 0;
+		array_reset(&buf->views[i].cursors);
+	}
+
+	buffer_rebuild_lines(buf);
+	buffer_edit(buf, 0, removed, 1);
+	buf->state = BUFFER_RESIDENT;
+
+	follow->offset = 0;
+
+	// a file replaced under the same name is watched from now on
+	watch_remove(follow->watch);
+	follow->watch = watch_add(buf->path.as_cstr());
+}
+
+// moves the cursors that were on the last line before to the end
+static void
+follow_pin(Buffer* buf, sizet lastStart) {
+
+	sizet end = buffer_length(buf);
+
+	if (buf->cursor >= lastStart)
+		buffer_set_cursor(buf, end);
+
+	for (sizet i = 0; i < buf->views.length; ++i)
+		if (buf->views[i].open && buf->views[i].cursor >= lastStart)
+			buf->views[i].cursor = end;
+
+	// the focused window scrolls to its cursor when it is drawn
+	Array<Window*> windows;
+	windows_get_all(&windows);
+
+	i32 last = (i32)buf->lineLengths.length - 1;
+	for (sizet i = 0; i < windows.length; ++i) {
+
+		Window* win = windows[i];
+		if (win->buffer != buf || win == FocusedWindow)
+			continue;
+
+		sizet cursor = win->view == buf->activeView ? buf->cursor : buf->views[win->view].cursor;
+		if (cursor == end)
+			window_scroll_to_line(win, buf, last);
+	}
+
+	array_free(&windows);
+}
+
+// appends up to FOLLOW_READ_MAX bytes of the file past the offset, true
+// when there is more
+static b8
+follow_read(Followed* follow, u64 size) {
+
+	Buffer* buf = follow->buf;
+
+#ifdef LINUX_PLATFORM
+	i32 fd = open(buf->path.as_cstr(), O_RDONLY);
+#elif WINDOWS_PLATFORM
+	i32 fd = _open(buf->path.as_cstr(), _O_RDONLY | _O_BINARY);
+#endif
+	if (fd < 0) return false;
+
+	sizet lastStart = buffer_index_based_on_line(buf, (i32)buf->lineLengths.length - 1);
+	u64 limit = size - follow->offset < FOLLOW_READ_MAX ? size : follow->offset + FOLLOW_READ_MAX;
+
+	while (follow->offset < limit) {
+
+		sizet want = limit - follow->offset < FOLLOW_BLOCK_SIZE ?
+			(sizet)(limit - follow->offset) : FOLLOW_BLOCK_SIZE;
+
+#ifdef LINUX_PLATFORM
+		i64 read = pread(fd, Block, want, follow->offset);
+#elif WINDOWS_PLATFORM
+		i64 read = _lseeki64(fd, follow->offset, SEEK_SET) < 0 ? -1 : _read(fd, Block, (u32)want);
+#endif
+		if (read <= 0) break;
+
+		buffer_append(buf, Block, (sizet)read);
+		follow->offset += read;
+	}
+
+#ifdef LINUX_PLATFORM
+	close(fd);
+#elif WINDOWS_PLATFORM
+	_close(fd);
+#endif
+
+	follow_pin(buf, lastStart);
+
+	return follow->offset < size;
+}
+
+
+void
+follow_init(FollowWake wake) {
+
+	Wake = wake;
+	Quit = 0;
+	array_init(&Follows, 4);
+	Block = (char*)malloc(FOLLOW_BLOCK_SIZE);
+
+#ifdef LINUX_PLATFORM
+	Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	Running = Notify >= 0 && pthread_create(&Watcher, NULL, watcher_main, NULL) == 0;
+#elif WINDOWS_PLATFORM
+	Watcher = CreateThread(NULL, 0, watcher_main, NULL, 0, NULL);
+	Running = Watcher != NULL;
+#endif
+
+	if (!Running) {
+		WARN_MSG("failed to start the follow thread, %s \n", "followed files are not watched");
+	}
+}
+
+void
+follow_shutdown() {
+
+	if (Running) {
+
+		store_release(&Quit, 1);
+#ifdef LINUX_PLATFORM
+		pthread_join(Watcher, NULL);
+#elif WINDOWS_PLATFORM
+		WaitForSingleObject(Watcher, INFINITE);
+		CloseHandle(Watcher);
+#endif
+		Running = false;
+	}
+
+#ifdef LINUX_PLATFORM
+	if (Notify >= 0)
+		close(Notify);
+	Notify = -1;
+#endif
+
+	array_free(&Follows);
+	free(Block);
+}
+
+// starts following the file of buf from its end, or stops, true when it
+// is followed now
+b8
+follow_toggle(Buffer* buf) {
+
+	for (sizet i = 0; i < Follows.length; ++i) {
+		if (Follows[i].buf == buf) {
+			follow_stop(i);
+			NORMAL_MSG("Stopped following %s \n", buf->path.as_cstr());
+			return false;
+		}
+	}
+
+	if (!buf->path.length || buf->large || buf->state != BUFFER_RESIDENT) {
+		WARN_MSG("%s can not be followed, it has no file, is read only or has edits \n",
+				 buf->name.as_cstr());
+		return false;
+	}
+
+	Followed follow;
+	follow.buf = buf;
+	follow.offset = buf->fileSize;
+	follow.watch = watch_add(buf->path.as_cstr());
+	array_push(&Follows, follow);
+	buf->followed = true;
+
+	store_release(&Active, Follows.length);
+
+	// appends extend the last line as it is in the text, a buffer made by
+	// file_open counts a newline after it the file may not have
+	i32 removed = (i32)buf->lineLengths.length;
+	buffer_rebuild_lines(buf);
+	buffer_edit(buf, 0, removed, (i32)buf->lineLengths.length);
+	// the text is still what is on disk
+	buf->state = BUFFER_RESIDENT;
+
+	// what was written since the buffer was read comes in on the next poll
+	buffer_set_cursor(buf, buffer_length(buf));
+	Pending = true;
+
+	NORMAL_MSG("Following %s \n", buf->path.as_cstr());
+	return true;
+}
+
+// appends what was written to the followed files since the last poll,
+// true when there is more to read and the caller should come back
+b8
+follow_poll() {
+
+	if (!Follows.length) return false;
+
+	u64 changes = load_acquire(&Changes);
+	if (changes == Seen && !Pending)
+		return false;
+
+	Seen = changes;
+	Pending = false;
+
+	for (sizet i = Follows.length; i-- > 0;) {
+
+		Followed* follow = &Follows[i];
+		Buffer* buf = follow->buf;
+
+		// edited or unloaded, the text no longer ends where the file did
+		if (buf->state != BUFFER_RESIDENT) {
+			NORMAL_MSG("Stopped following %s \n", buf->path.as_cstr());
+			follow_stop(i);
+			continue;
+		}
+
+		u64 time;
+		sizet size;
+		if (!file_stamp(buf->path.as_cstr(), &time, &size))
+			continue;
+
+		if (size < follow->offset)
+			follow_restart(follow);
+
+		if (size > follow->offset && follow_read(follow, size))
+			Pending = true;
+
+		if (follow->offset == size) {
+			buf->fileTime = time;
+			buf->fileSize = size;
+		}
+	}
+
+	return Pending;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+
+typedef void (*FollowWake)();
+
+void follow_init(FollowWake wake);
+void follow_shutdown();
+b8 follow_toggle(Buffer* buf);
+b8 follow_poll();
@@ -0,0 +1,10 @@
+#include "globals.h"
+
+Buffer* CurBuffer;
+Window* FocusedWindow;
+Buffer* PrevBuffer;
+i32 TheWidth;
+i32 TheHeight;
+InputMode InputMod;
+bool just_entered_edit_mode;
+Node* WinTree;
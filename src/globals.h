@@ -12,4 +12,3 @@ extern i32 TheHeight;
 extern InputMode InputMod;
 extern bool just_entered_edit_mode;
 extern Node* WinTree;
-extern Array<Token> Tokens;
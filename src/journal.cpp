@@ -0,0 +1,683 @@
+#include "journal.h"
+#include "buffer.h"
+#include "fileio.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef LINUX_PLATFORM
+#include <pthread.h>
+#include <unistd.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+#define JOURNAL_MAGIC 0x314e524a
+#define JOURNAL_RING_SIZE (1 << 20)
+// edits with more than this to queue are handed over on the heap
+#define JOURNAL_INLINE_MAX (JOURNAL_RING_SIZE / 8)
+#define JOURNAL_FLUSH_MS 20
+#define JOURNAL_SYNC_MS 1000
+#define JOURNAL_BATCH_MIN 4096
+
+/* every edit of a buffer with a file is appended to <path>.journal until
+   the buffer is saved, which cuts the journal back to its header. the
+   main thread only copies the edit into a ring the journal thread drains,
+   the thread batches the records of each journal into one write and syncs
+   them about once a second. a journal whose header matches the file it
+   sits next to is replayed when the buffer is loaded, up to the first
+   record that was not written in full. a clean exit removes the journals
+   left with no records.
+
+   file: magic, file time and size the edits apply to, then records of
+   u32 length, u32 check and a body of u64 deleteLen, insertLen and count,
+   count u64 positions, insertLen bytes.
+ */
+
+typedef enum JournalKind {
+
+	// cuts the journal to a new header
+	JOURNAL_RESET,
+	// goes on after the records replayed
+	JOURNAL_OPEN,
+	JOURNAL_EDIT,
+	// an edit with its positions and text in a heap block
+	JOURNAL_EDIT_HEAP
+
+} JournalKind;
+
+struct Journal {
+
+	// set before the journal is first queued, never changed after
+	char* path;
+
+	// journal thread only
+	i32 fd;
+	b8 failed;
+	b8 records;
+	b8 unsynced;
+	Array<u8> batch;
+};
+
+// queued in the ring, followed by count positions and insertLen bytes,
+// or by a pointer to a heap block holding them
+typedef struct JournalEntry {
+
+	u32 size;
+	u32 kind;
+	Journal* journal;
+
+	u64 count;
+	u64 deleteLen;
+	u64 insertLen;
+
+	// header of a reset
+	u64 fileTime;
+	u64 fileSize;
+	// bytes of the file an open keeps
+	u64 keep;
+
+} JournalEntry;
+
+typedef struct JournalHeader {
+
+	u32 magic;
+	u32 unused;
+	u64 fileTime;
+	u64 fileSize;
+
+} JournalHeader;
+
+#ifdef LINUX_PLATFORM
+static pthread_t Worker;
+#elif WINDOWS_PLATFORM
+static HANDLE Worker;
+#endif
+
+static b8 Running;
+// read by the journal thread through load_acquire
+static u64 Quit;
+
+// single producer, the main thread, and single consumer, the journal
+// thread, positions only grow and wrap through the mask
+static u8* Ring;
+static u64 Head;
+static u64 Tail;
+
+// journal thread only
+static Array<Journal*> Journals;
+
+
+static u64
+load_acquire(u64* value) {
+#ifdef LINUX_PLATFORM
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif WINDOWS_PLATFORM
+	u64 out = *(volatile u64*)value;
+	_ReadWriteBarrier();
+	return out;
+#endif
+}
+
+static void
+store_release(u64* value, u64 to) {
+#ifdef LINUX_PLATFORM
+	__atomic_store_n(value, to, __ATOMIC_RELEASE);
+#elif WINDOWS_PLATFORM
+	_ReadWriteBarrier();
+	*(volatile u64*)value = to;
+#endif
+}
+
+static void
+sleep_ms(i32 ms) {
+#ifdef LINUX_PLATFORM
+	usleep(ms * 1000);
+#elif WINDOWS_PLATFORM
+	Sleep(ms);
+#endif
+}
+
+static u32
+check_of(const u8* data, sizet length) {
+
+	u32 hash = 2166136261u;
+	for (sizet i = 0; i < length; ++i) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static char*
+journal_path(Buffer* buf) {
+
+	const char* suffix = ".journal";
+	sizet length = buf->path.length;
+
+	char* path = (char*)malloc(length + strlen(suffix) + 1);
+	memcpy(path, buf->path.data, length);
+	strcpy(path + length, suffix);
+
+	return path;
+}
+
+
+// ring
+
+static void
+ring_put(u64 at, const void* data, sizet length) {
+
+	sizet offset = at & (JOURNAL_RING_SIZE - 1);
+	sizet first = JOURNAL_RING_SIZE - offset < length ? JOURNAL_RING_SIZE - offset : length;
+
+	memcpy(Ring + offset, data, first);
+	memcpy(Ring, (const u8*)data + first, length - first);
+}
+
+static void
+ring_get(u64 at, void* out, sizet length) {
+
+	sizet offset = at & (JOURNAL_RING_SIZE - 1);
+	sizet first = JOURNAL_RING_SIZE - offset < length ? JOURNAL_RING_SIZE - offset : length;
+
+	memcpy(out, Ring + offset, first);
+	memcpy((u8*)out + first, Ring, length - first);
+}
+
+// waits only when the journal thread is a whole ring behind
+static void
+entry_push(JournalEntry* entry, const void* first, sizet firstLength,
+		   const void* second, sizet secondLength) {
+
+	entry->size = (u32)(sizeof(JournalEntry) + firstLength + secondLength);
+
+	while (Head + entry->size - load_acquire(&Tail) > JOURNAL_RING_SIZE)
+		sleep_ms(1);
+
+	ring_put(Head, entry, sizeof(JournalEntry));
+	ring_put(Head + sizeof(JournalEntry), first, firstLength);
+	ring_put(Head + sizeof(JournalEntry) + firstLength, second, secondLength);
+
+	store_release(&Head, Head + entry->size);
+}
+
+static void
+journal_attach(Buffer* buf, JournalKind kind, u64 keep) {
+
+	Journal* journal = (Journal*)calloc(1, sizeof(Journal));
+	journal->path = journal_path(buf);
+	journal->fd = -1;
+	buf->journal = journal;
+
+	JournalEntry entry = {};
+	entry.kind = kind;
+	entry.journal = journal;
+	entry.fileTime = buf->fileTime;
+	entry.fileSize = buf->fileSize;
+	entry.keep = keep;
+
+	entry_push(&entry, NULL, 0, NULL, 0);
+}
+
+
+// journal thread
+
+static void
+batch_append(Journal* journal, const void* data, sizet length) {
+
+	if (!journal->batch.data)
+		array_init(&journal->batch, JOURNAL_BATCH_MIN);
+
+	while (journal->batch.capacity < journal->batch.length + length)
+		array_expand(&journal->batch);
+
+	memcpy(journal->batch.data + journal->batch.length, data, length);
+	journal->batch.length += length;
+}
+
+static b8
+journal_file_open(Journal* journal) {
+
+	if (journal->fd >= 0) return true;
+	if (journal->failed) return false;
+
+#ifdef LINUX_PLATFORM
+	journal->fd = open(journal->path, O_WRONLY | O_CREAT, 0644);
+#elif WINDOWS_PLATFORM
+	journal->fd = _open(journal->path, _O_WRONLY | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+
+	if (journal->fd < 0) {
+		WARN_MSG("Failed to open the journal %s \n", journal->path);
+		journal->failed = true;
+		return false;
+	}
+
+	array_push(&Journals, journal);
+	return true;
+}
+
+// drops everything in the file past length and appends from there
+static void
+journal_file_cut(Journal* journal, u64 length) {
+#ifdef LINUX_PLATFORM
+	if (ftruncate(journal->fd, length) == 0)
+		lseek(journal->fd, length, SEEK_SET);
+#elif WINDOWS_PLATFORM
+	if (_chsize_s(journal->fd, length) == 0)
+		_lseeki64(journal->fd, length, SEEK_SET);
+#endif
+}
+
+static void
+journal_file_write(Journal* journal) {
+
+	if (!journal->batch.length || journal->fd < 0) return;
+
+	// a record cut short is dropped by the check on replay, nothing after
+	// it is written once a write failed
+	u8* at = journal->batch.data;
+	u64 left = journal->batch.length;
+	while (left && !journal->failed) {
+
+#ifdef LINUX_PLATFORM
+		i64 written = write(journal->fd, at, left);
+#elif WINDOWS_PLATFORM
+		i64 written = _write(journal->fd, at, (u32)left);
+#endif
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written <= 0) {
+			WARN_MSG("Failed to write the journal %s, edits are no longer journaled \n", journal->path);
+			journal->failed = true;
+			break;
+		}
+
+		at += written;
+		left -= written;
+	}
+
+	array_reset(&journal->batch);
+	journal->unsynced = true;
+}
+
+static void
+journal_file_sync(Journal* journal) {
+
+	if (!journal->unsynced || journal->fd < 0) return;
+
+#ifdef LINUX_PLATFORM
+	fdatasync(journal->fd);
+#elif WINDOWS_PLATFORM
+	_commit(journal->fd);
+#endif
+
+	journal->unsynced = false;
+}
+
+static void
+journal_file_close(Journal* journal) {
+
+#ifdef LINUX_PLATFORM
+	close(journal->fd);
+#elif WINDOWS_PLATFORM
+	_close(journal->fd);
+#endif
+
+	journal->fd = -1;
+
+	// nothing to recover, the buffer was saved since its last edit
+	if (!journal->records)
+		remove(journal->path);
+}
+
+// turns a queued edit into a record of the journal
+static void
+record_append(Journal* journal, JournalEntry* entry, u64 at, u8* heap) {
+
+	u64 header[3] = {entry->deleteLen, entry->insertLen, entry->count};
+	u32 length = (u32)(sizeof(header) + entry->count * sizeof(u64) + entry->insertLen);
+
+	sizet start = journal->batch.length;
+	u32 prefix[2] = {length, 0};
+	batch_append(journal, prefix, sizeof(prefix));
+	batch_append(journal, header, sizeof(header));
+
+	for (u64 i = 0; i < entry->count; ++i) {
+
+		sizet position;
+		if (heap)
+			memcpy(&position, heap + i * sizeof(sizet), sizeof(sizet));
+		else
+			ring_get(at + i * sizeof(sizet), &position, sizeof(sizet));
+
+		u64 wide = position;
+		batch_append(journal, &wide, sizeof(wide));
+	}
+
+	sizet textAt = entry->count * sizeof(sizet);
+	while (journal->batch.capacity < journal->batch.length + entry->insertLen)
+		array_expand(&journal->batch);
+
+	u8* text = journal->batch.data + journal->batch.length;
+	if (heap)
+		memcpy(text, heap + textAt, entry->insertLen);
+	else
+		ring_get(at + textAt, text, entry->insertLen);
+	journal->batch.length += entry->insertLen;
+
+	u8* body = journal->batch.data + start + sizeof(prefix);
+	u32 check = check_of(body, length);
+	memcpy(journal->batch.data + start + sizeof(u32), &check, sizeof(check));
+
+	journal->records = true;
+}
+
+static void
+entry_take(JournalEntry* entry, u64 at) {
+
+	Journal* journal = entry->journal;
+
+	switch (entry->kind) {
+	case JOURNAL_RESET: {
+
+		if (!journal_file_open(journal)) break;
+
+		array_reset(&journal->batch);
+		journal_file_cut(journal, 0);
+
+		JournalHeader header = {JOURNAL_MAGIC, 0, entry->fileTime, entry->fileSize};
+		batch_append(journal, &header, sizeof(header));
+		journal->records = false;
+		break;
+	}
+	case JOURNAL_OPEN:
+
+		if (!journal_file_open(journal)) break;
+
+		journal_file_cut(journal, entry->keep);
+		journal->records = entry->keep > sizeof(JournalHeader);
+		break;
+
+	case JOURNAL_EDIT:
+
+		if (journal->fd >= 0)
+			record_append(journal, entry, at, NULL);
+		break;
+
+	case JOURNAL_EDIT_HEAP: {
+
+		u8* heap;
+		ring_get(at, &heap, sizeof(heap));
+
+		if (journal->fd >= 0)
+			record_append(journal, entry, 0, heap);
+		free(heap);
+		break;
+	}
+	}
+}
+
+static void
+worker_run() {
+
+	i32 sinceSync = 0;
+
+	while (true) {
+
+		b8 quit = load_acquire(&Quit) != 0;
+		u64 head = load_acquire(&Head);
+		u64 tail = Tail;
+
+		// a ring filling up faster than a flush drains it goes on at once
+		b8 busy = head - tail > JOURNAL_RING_SIZE / 4;
+
+		while (tail != head) {
+
+			JournalEntry entry;
+			ring_get(tail, &entry, sizeof(entry));
+			entry_take(&entry, tail + sizeof(entry));
+
+			tail += entry.size;
+			store_release(&Tail, tail);
+		}
+
+		for (sizet i = 0; i < Journals.length; ++i)
+			journal_file_write(Journals[i]);
+
+		sinceSync += JOURNAL_FLUSH_MS;
+		if (sinceSync >= JOURNAL_SYNC_MS || quit) {
+
+			for (sizet i = 0; i < Journals.length; ++i)
+				journal_file_sync(Journals[i]);
+			sinceSync = 0;
+		}
+
+		if (quit) break;
+
+		if (!busy)
+			sleep_ms(JOURNAL_FLUSH_MS);
+	}
+
+	for (sizet i = 0; i < Journals.length; ++i)
+		journal_file_close(Journals[i]);
+}
+
+#ifdef LINUX_PLATFORM
+static void*
+worker_main(void*) {
+
+	worker_run();
+	return NULL;
+}
+#elif WINDOWS_PLATFORM
+static DWORD WINAPI
+worker_main(LPVOID) {
+
+	worker_run();
+	return 0;
+}
+#endif
+
+
+void
+journal_init() {
+
+	Ring = (u8*)malloc(JOURNAL_RING_SIZE);
+	array_init(&Journals, 16);
+
+	Head = 0;
+	Tail = 0;
+	Quit = 0;
+
+#ifdef LINUX_PLATFORM
+	Running = pthread_create(&Worker, NULL, worker_main, NULL) == 0;
+#elif WINDOWS_PLATFORM
+	Worker = CreateThread(NULL, 0, worker_main, NULL, 0, NULL);
+	Running = Worker != NULL;
+#endif
+
+	if (!Running) {
+		WARN_MSG("failed to start the journal thread, %s \n", "edits are not journaled");
+	}
+}
+
+// writes and syncs what is queued, journals of saved buffers are removed
+void
+journal_shutdown() {
+
+	if (!Running) return;
+
+	store_release(&Quit, 1);
+
+#ifdef LINUX_PLATFORM
+	pthread_join(Worker, NULL);
+#elif WINDOWS_PLATFORM
+	WaitForSingleObject(Worker, INFINITE);
+	CloseHandle(Worker);
+#endif
+
+	Running = false;
+}
+
+// queues an edit as buffer_replace_at takes it, positions sorted and in
+// the text before the edit
+void
+journal_edit(Buffer* buf, const sizet* positions, sizet count, sizet deleteLen,
+			 const char* insert, sizet insertLen) {
+
+	if (!Running || !buf->path.length) return;
+
+	if (!buf->journal)
+		journal_attach(buf, JOURNAL_RESET, 0);
+
+	JournalEntry entry = {};
+	entry.kind = JOURNAL_EDIT;
+	entry.journal = buf->journal;
+	entry.count = count;
+	entry.deleteLen = deleteLen;
+	entry.insertLen = insertLen;
+
+	sizet positionsLength = count * sizeof(sizet);
+	if (positionsLength + insertLen <= JOURNAL_INLINE_MAX) {
+		entry_push(&entry, positions, positionsLength, insert, insertLen);
+		return;
+	}
+
+	u8* heap = (u8*)malloc(positionsLength + insertLen);
+	memcpy(heap, positions, positionsLength);
+	memcpy(heap + positionsLength, insert, insertLen);
+
+	entry.kind = JOURNAL_EDIT_HEAP;
+	entry_push(&entry, &heap, sizeof(heap), NULL, 0);
+}
+
+// the file now holds the text, the journal starts over from it
+void
+journal_saved(Buffer* buf) {
+
+	if (!Running || !buf->journal) return;
+
+	JournalEntry entry = {};
+	entry.kind = JOURNAL_RESET;
+	entry.journal = buf->journal;
+	entry.fileTime = buf->fileTime;
+	entry.fileSize = buf->fileSize;
+
+	entry_push(&entry, NULL, 0, NULL, 0);
+}
+
+// applies the journal left next to the file of a buffer just loaded, when
+// it was made on the file as it is now
+void
+journal_replay(Buffer* buf) {
+
+	if (!Running || !buf->path.length || buf->journal) return;
+
+	char* path = journal_path(buf);
+	FILE* fp = fopen(path, "rb");
+	if (!fp) {
+		free(path);
+		return;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	sizet size = ftell(fp);
+	rewind(fp);
+
+	u8* data = (u8*)malloc(size + 1);
+	size = fread(data, 1, size, fp);
+	fclose(fp);
+
+	JournalHeader header;
+	if (size < sizeof(header)) {
+		free(data);
+		free(path);
+		return;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != JOURNAL_MAGIC ||
+		header.fileTime != buf->fileTime || header.fileSize != buf->fileSize) {
+
+		WARN_MSG("Journal %s was made on another version of the file, dropped \n", path);
+		remove(path);
+		free(data);
+		free(path);
+		return;
+	}
+
+	Array<sizet> positions;
+	array_init(&positions, 4);
+
+	sizet at = sizeof(header);
+	u32 applied = 0;
+
+	while (size - at >= 2 * sizeof(u32)) {
+
+		u32 length, check;
+		memcpy(&length, data + at, sizeof(length));
+		memcpy(&check, data + at + sizeof(u32), sizeof(check));
+
+		u8* body = data + at + 2 * sizeof(u32);
+		if (size - at - 2 * sizeof(u32) < length || length < 3 * sizeof(u64) ||
+			check_of(body, length) != check)
+			break;
+
+		u64 deleteLen, insertLen, count;
+		memcpy(&deleteLen, body, sizeof(u64));
+		memcpy(&insertLen, body + sizeof(u64), sizeof(u64));
+		memcpy(&count, body + 2 * sizeof(u64), sizeof(u64));
+
+		if (!count || (length - 3 * sizeof(u64)) / sizeof(u64) < count ||
+			3 * sizeof(u64) + count * sizeof(u64) + insertLen != length)
+			break;
+
+		// sorted, apart and inside the text
+		array_reset(&positions);
+		b8 valid = true;
+		for (u64 i = 0; i < count && valid; ++i) {
+
+			u64 position;
+			memcpy(&position, body + (3 + i) * sizeof(u64), sizeof(u64));
+
+			if (positions.length && positions[positions.length - 1] + deleteLen > position)
+				valid = false;
+			array_push(&positions, (sizet)position);
+		}
+		if (!valid || positions[positions.length - 1] + deleteLen > buffer_length(buf))
+			break;
+
+		// back to front so the positions before stay where they are
+		const char* insert = (const char*)body + (3 + count) * sizeof(u64);
+		for (sizet i = positions.length; i-- > 0;)
+			buffer_splice(buf, positions[i], deleteLen, insert, insertLen);
+
+		applied++;
+		at += 2 * sizeof(u32) + length;
+	}
+
+	if (applied) {
+
+		buffer_rebuild_lines(buf);
+		buf->version++;
+		buf->state = BUFFER_DIRTY;
+		NORMAL_MSG("Recovered %i edits of %s \n", applied, buf->path.as_cstr());
+	}
+
+	// a record cut short by a crash is dropped before the next one
+	journal_attach(buf, JOURNAL_OPEN, at);
+
+	array_free(&positions);
+	free(data);
+	free(path);
+}
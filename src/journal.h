@@ -0,0 +1,15 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+
+// edits of one buffer since its file was last read or saved, appended to
+// a file next to it by the journal thread
+typedef struct Journal Journal;
+
+void journal_init();
+void journal_shutdown();
+void journal_edit(Buffer* buf, const sizet* positions, sizet count, sizet deleteLen,
+				  const char* insert, sizet insertLen);
+void journal_saved(Buffer* buf);
+void journal_replay(Buffer* buf);
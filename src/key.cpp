@@ -32,6 +32,8 @@ keycode_from_string(String key) {
 	if (key == "z") return KEY_Z;
 	if (key == ";") return KEY_Semicolon;
 	if (key == "=") return KEY_Equal;
+	if (key == "[") return KEY_LeftBracket;
+	if (key == "]") return KEY_RightBracket;
 	if (key == "left") return KEY_Left;
 	if (key == "right") return KEY_Right;
 	if (key == "up") return KEY_Up;
@@ -39,6 +41,22 @@ keycode_from_string(String key) {
 	if (key == "escape") return KEY_Escape;
 	if (key == "enter") return KEY_Enter;
 	if (key == "backspace") return KEY_Backspace;
+	if (key == "pageup") return KEY_PageUp;
+	if (key == "pagedown") return KEY_PageDown;
+	if (key == "home") return KEY_Home;
+	if (key == "end") return KEY_End;
+	if (key == "f1") return KEY_F1;
+	if (key == "f2") return KEY_F2;
+	if (key == "f3") return KEY_F3;
+	if (key == "f4") return KEY_F4;
+	if (key == "f5") return KEY_F5;
+	if (key == "f6") return KEY_F6;
+	if (key == "f7") return KEY_F7;
+	if (key == "f8") return KEY_F8;
+	if (key == "f9") return KEY_F9;
+	if (key == "f10") return KEY_F10;
+	if (key == "f11") return KEY_F11;
+	if (key == "f12") return KEY_F12;
 
 	return KEY_Unknown;
 }
@@ -0,0 +1,334 @@
+#include "language.h"
+#include "tokenizer.h"
+#include "my_string.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define KEYWORD_TABLE_MAX 4096
+#define KEYWORD_SEED_TRIES 4096
+#define LANGUAGE_LINE_MAX 4096
+
+/* grammar files sit next to config.txt and are listed there with
+   "language <file>", one directive per line:
+
+	   # comment
+	   name python
+	   extensions py pyw
+	   line-comment #
+	   strings " '
+	   keywords def class if elif else
+	   types int str float
+
+   block-comment takes the open and close markers, include-strings makes
+   <file> a string after an include. keywords and types can be given on
+   as many lines as needed.
+ */
+
+static List<Language> Languages;
+static Language Plain;
+static b8 LanguagesReady;
+
+
+static void
+classes_default(u8* classes) {
+
+	memset(classes, CC_SKIP, 256);
+
+	for (i32 c = 'a'; c <= 'z'; ++c) classes[c] = CC_IDENT;
+	for (i32 c = 'A'; c <= 'Z'; ++c) classes[c] = CC_IDENT;
+	for (i32 c = '0'; c <= '9'; ++c) classes[c] = CC_DIGIT;
+	classes['_'] = CC_IDENT;
+
+	classes[' '] = CC_SPACE;
+	classes['\t'] = CC_SPACE;
+	classes['\r'] = CC_SPACE;
+	classes['\n'] = CC_NEWLINE;
+
+	classes['('] = CC_SINGLE;
+	classes[')'] = CC_SINGLE;
+	classes['{'] = CC_SINGLE;
+	classes['}'] = CC_SINGLE;
+	classes['['] = CC_SINGLE;
+	classes[']'] = CC_SINGLE;
+	classes['#'] = CC_SINGLE;
+	classes[';'] = CC_SINGLE;
+}
+
+// places the words with the current seed, a repeated word keeps its
+// first entry, returns the number of words that found no free slot
+static sizet
+keyword_table_place(KeywordTable* table, Array<KeywordEntry>* words) {
+
+	sizet collisions = 0;
+
+	for (sizet i = 0; i < words->length; ++i) {
+
+		KeywordEntry* word = &(*words)[i];
+		KeywordEntry* entry = &table->entries[keyword_hash(word->word, word->length, table->seed) & table->mask];
+
+		if (entry->length) {
+			if (entry->length != word->length || memcmp(entry->word, word->word, word->length) != 0)
+				collisions++;
+			continue;
+		}
+
+		*entry = *word;
+	}
+
+	return collisions;
+}
+
+static void
+keyword_table_build(KeywordTable* table, Array<KeywordEntry>* words) {
+
+	sizet size = 16;
+	while (size < words->length * 2)
+		size *= 2;
+
+	array_init(&table->entries, size);
+
+	for (;;) {
+
+		table->entries.length = size;
+		table->mask = (u32)size - 1;
+
+		for (u32 i = 0; i < KEYWORD_SEED_TRIES; ++i) {
+
+			memset(table->entries.data, 0, sizeof(KeywordEntry) * size);
+			table->seed = (i * 2654435761u) | 1;
+
+			if (keyword_table_place(table, words) == 0)
+				return;
+		}
+
+		// words of the same length that share their first and last four
+		// bytes can never be told apart, the table is kept without them
+		if (size >= KEYWORD_TABLE_MAX)
+			return;
+
+		size *= 2;
+		array_free(&table->entries);
+		array_init(&table->entries, size);
+	}
+}
+
+static void
+keyword_add(Array<KeywordEntry>* words, const char* word, sizet length, TokenType type) {
+
+	if (length == 0 || length > KEYWORD_MAX_LENGTH) {
+		WARN_MSG("keyword ignored, longer than %d: %.*s \n", KEYWORD_MAX_LENGTH, (i32)length, word);
+		return;
+	}
+
+	KeywordEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	memcpy(entry.word, word, length);
+	entry.length = (u8)length;
+	entry.type = (u8)type;
+
+	array_push(words, entry);
+}
+
+static const char*
+next_word(const char* line, sizet* length) {
+
+	while (*line == ' ' || *line == '\t')
+		line++;
+
+	*length = 0;
+	while (line[*length] != '\0' && line[*length] != ' ' && line[*length] != '\t' &&
+		   line[*length] != '\n' && line[*length] != '\r')
+		(*length)++;
+
+	return line;
+}
+
+static void
+marker_copy(char* marker, const char* word, sizet length) {
+
+	if (length >= LANGUAGE_MARKER_MAX) {
+		WARN_MSG("comment marker too long: %.*s \n", (i32)length, word);
+		return;
+	}
+
+	memcpy(marker, word, length);
+	marker[length] = '\0';
+}
+
+static void
+language_init(Language* lang) {
+
+	memset(lang, 0, sizeof(Language));
+	classes_default(lang->classes);
+}
+
+static void
+language_compile(Language* lang, Array<KeywordEntry>* words, b8 includeStrings) {
+
+	if (includeStrings)
+		lang->classes['<'] = CC_ANGLE;
+
+	// comments win over single character tokens, # in python
+	if (lang->lineComment[0])
+		lang->classes[(u8)lang->lineComment[0]] = CC_COMMENT;
+	if (lang->blockOpen[0] && lang->blockClose[0])
+		lang->classes[(u8)lang->blockOpen[0]] = CC_COMMENT;
+
+	keyword_table_build(&lang->keywords, words);
+}
+
+
+void
+languages_init() {
+
+	if (LanguagesReady)
+		return;
+
+	list_init(&Languages);
+
+	Array<KeywordEntry> none;
+	array_init(&none, 1);
+
+	language_init(&Plain);
+	strcpy(Plain.name, "plain");
+	language_compile(&Plain, &none, false);
+
+	array_free(&none);
+	LanguagesReady = true;
+}
+
+Language*
+language_load(const char* path) {
+
+	languages_init();
+
+	FILE* fp = fopen(path, "r");
+	if (!fp) {
+		WARN_MSG("failed to open language file: %s \n", path);
+		return NULL;
+	}
+
+	Language lang;
+	language_init(&lang);
+
+	Array<KeywordEntry> words;
+	array_init(&words, 64);
+	b8 includeStrings = false;
+
+	char line[LANGUAGE_LINE_MAX];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+
+		sizet length;
+		const char* directive = next_word(line, &length);
+		const char* rest = directive + length;
+
+		if (length == 0 || directive[0] == '#')
+			continue;
+
+		sizet wordLength;
+		const char* word = next_word(rest, &wordLength);
+
+		if (length == 4 && memcmp(directive, "name", 4) == 0) {
+
+			if (wordLength < LANGUAGE_NAME_MAX) {
+				memcpy(lang.name, word, wordLength);
+				lang.name[wordLength] = '\0';
+			}
+		}
+		else if (length == 10 && memcmp(directive, "extensions", 10) == 0) {
+
+			for (; wordLength; word = next_word(word + wordLength, &wordLength)) {
+
+				if (lang.extensionCount == LANGUAGE_MAX_EXTENSIONS ||
+					wordLength >= LANGUAGE_EXTENSION_MAX)
+					continue;
+
+				char* ext = lang.extensions[lang.extensionCount++];
+				memcpy(ext, word, wordLength);
+				ext[wordLength] = '\0';
+			}
+		}
+		else if (length == 12 && memcmp(directive, "line-comment", 12) == 0) {
+
+			marker_copy(lang.lineComment, word, wordLength);
+		}
+		else if (length == 13 && memcmp(directive, "block-comment", 13) == 0) {
+
+			marker_copy(lang.blockOpen, word, wordLength);
+			word = next_word(word + wordLength, &wordLength);
+			marker_copy(lang.blockClose, word, wordLength);
+		}
+		else if (length == 7 && memcmp(directive, "strings", 7) == 0) {
+
+			for (; wordLength; word = next_word(word + wordLength, &wordLength))
+				lang.classes[(u8)word[0]] = CC_QUOTE;
+		}
+		else if (length == 15 && memcmp(directive, "include-strings", 15) == 0) {
+
+			includeStrings = true;
+		}
+		else if (length == 8 && memcmp(directive, "keywords", 8) == 0) {
+
+			for (; wordLength; word = next_word(word + wordLength, &wordLength))
+				keyword_add(&words, word, wordLength, TOK_KEYWORD);
+		}
+		else if (length == 5 && memcmp(directive, "types", 5) == 0) {
+
+			for (; wordLength; word = next_word(word + wordLength, &wordLength))
+				keyword_add(&words, word, wordLength, TOK_TYPE);
+		}
+		else {
+
+			WARN_MSG("unknown language directive in %s: %.*s \n", path, (i32)length, directive);
+		}
+	}
+
+	fclose(fp);
+
+	language_compile(&lang, &words, includeStrings);
+	array_free(&words);
+
+	list_add(&Languages, lang);
+	NORMAL_MSG("Loaded language: %s \n", lang.name);
+
+	return &Languages.tail->data;
+}
+
+// picked by the extension of the file name, plain text when no grammar
+// claims it
+Language*
+language_for_path(const char* path) {
+
+	languages_init();
+
+	const char* ext = NULL;
+	for (const char* c = path; *c; ++c) {
+
+		if (*c == '.')
+			ext = c + 1;
+		else if (*c == '/' || *c == '\\')
+			ext = NULL;
+	}
+
+	if (!ext)
+		return &Plain;
+
+	for (Member<Language>* node = Languages.head; node; node = node->next) {
+
+		Language* lang = &node->data;
+		for (i32 i = 0; i < lang->extensionCount; ++i)
+			if (cstr_equal(lang->extensions[i], ext))
+				return lang;
+	}
+
+	return &Plain;
+}
+
+Language*
+language_plain() {
+
+	languages_init();
+	return &Plain;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "types.h"
+#include "container.h"
+
+#include <string.h>
+
+#define LANGUAGE_NAME_MAX 32
+#define LANGUAGE_MAX_EXTENSIONS 16
+#define LANGUAGE_EXTENSION_MAX 16
+#define LANGUAGE_MARKER_MAX 4
+#define KEYWORD_MAX_LENGTH 15
+
+typedef enum CharClass {
+
+	CC_SKIP = 0,
+	CC_SPACE,
+	CC_NEWLINE,
+	CC_IDENT,
+	CC_DIGIT,
+	// one character token, type from the tokenizer's single token table
+	CC_SINGLE,
+	// opens a string closed by the same character
+	CC_QUOTE,
+	// <file> after an include
+	CC_ANGLE,
+	// first character of a line or block comment marker
+	CC_COMMENT
+
+} CharClass;
+
+typedef struct KeywordEntry {
+
+	char word[KEYWORD_MAX_LENGTH + 1];
+	u8 length;
+	u8 type;
+
+} KeywordEntry;
+
+// no probing, the seed is searched until every word gets a slot of its
+// own, so a lookup is one hash and one compare
+typedef struct KeywordTable {
+
+	u32 seed;
+	u32 mask;
+	Array<KeywordEntry> entries;
+
+} KeywordTable;
+
+// one grammar file, compiled into a character class table and a keyword
+// table when loaded so the lexer never looks at the definition itself
+typedef struct Language {
+
+	char name[LANGUAGE_NAME_MAX];
+	char extensions[LANGUAGE_MAX_EXTENSIONS][LANGUAGE_EXTENSION_MAX];
+	i32 extensionCount;
+
+	char lineComment[LANGUAGE_MARKER_MAX];
+	char blockOpen[LANGUAGE_MARKER_MAX];
+	char blockClose[LANGUAGE_MARKER_MAX];
+
+	u8 classes[256];
+	KeywordTable keywords;
+
+} Language;
+
+
+void languages_init();
+Language* language_load(const char* path);
+Language* language_for_path(const char* path);
+Language* language_plain();
+
+// mixes the first and last four bytes with the length, words up to eight
+// characters are hashed whole without a loop over their bytes
+inline u32
+keyword_hash(const char* word, sizet length, u32 seed) {
+
+	u32 head, tail;
+	if (length >= 4) {
+		memcpy(&head, word, 4);
+		memcpy(&tail, word + length - 4, 4);
+	}
+	else {
+		head = (u8)word[0] | (u8)word[length >> 1] << 8 | (u8)word[length - 1] << 16;
+		tail = 0;
+	}
+
+	u32 hash = (head ^ (tail * 0x9E3779B1u) ^ (u32)length) * seed;
+	return hash ^ (hash >> 15);
+}
@@ -0,0 +1,615 @@
+#include "largefile.h"
+#include "buffer.h"
+#include "fold.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#ifdef LINUX_PLATFORM
+#include <pthread.h>
+#include <unistd.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#include <io.h>
+#endif
+
+#define LARGE_THRESHOLD_DEFAULT ((u64)256 << 20)
+#define LARGE_CHUNK_SIZE (1 << 20)
+#define LARGE_CHUNK_CACHE 16
+#define LARGE_CHUNK_NONE UINT64_MAX
+#define LARGE_INDEX_STRIDE 1024
+#define LARGE_INDEX_BLOCK 4096
+#define LARGE_SLICE_LINES 16384
+#define LARGE_SLICE_BYTES (8 << 20)
+#define LARGE_LINE_MAX (64 << 10)
+
+/* a file over the threshold is never read whole. its buffer holds one
+   slice of it, at most LARGE_SLICE_LINES lines and about LARGE_SLICE_BYTES
+   bytes, so everything that works on a buffer shows it unchanged. lines
+   longer than LARGE_LINE_MAX are cut there. the slice is copied out of
+   fixed chunks of the file kept in a small least recently used cache, and
+   is moved to center the cursor when it gets near either end. a thread
+   scans the file once on its own descriptor and publishes the start of
+   every LARGE_INDEX_STRIDE-th line, a jump to a line reads at most that
+   many lines from the nearest one. the buffer is read only, an edit would
+   only reach the slice.
+ */
+
+typedef struct LargeChunk {
+
+	u64 index;
+	u64 used;
+	sizet length;
+	u8* data;
+
+} LargeChunk;
+
+typedef struct LargePosition {
+
+	u64 line;
+	sizet column;
+
+} LargePosition;
+
+struct LargeFile {
+
+	// set before the scan thread starts, never changed after
+	char* path;
+	u64 size;
+
+	// main thread only
+	i32 fd;
+	u64 clock;
+	LargeChunk chunks[LARGE_CHUNK_CACHE];
+
+	// the slice held by the buffer, the line it starts at and the start
+	// in the file of every line in it
+	u64 start;
+	u64 end;
+	u64 firstLine;
+	Array<u64> starts;
+	// cursor line the slice was last checked for
+	u64 paged;
+
+	// line starts in blocks of LARGE_INDEX_BLOCK, an entry is written by
+	// the scan thread before indexed is raised past it
+	u64** blocks;
+	sizet blockCount;
+	u64 indexed;
+	u64 quit;
+
+#ifdef LINUX_PLATFORM
+	pthread_t scanner;
+#elif WINDOWS_PLATFORM
+	HANDLE scanner;
+#endif
+	b8 scanning;
+};
+
+static u64 Threshold = LARGE_THRESHOLD_DEFAULT;
+
+
+static u64
+load_acquire(u64* value) {
+#ifdef LINUX_PLATFORM
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif WINDOWS_PLATFORM
+	u64 out = *(volatile u64*)value;
+	_ReadWriteBarrier();
+	return out;
+#endif
+}
+
+static void
+store_release(u64* value, u64 to) {
+#ifdef LINUX_PLATFORM
+	__atomic_store_n(value, to, __ATOMIC_RELEASE);
+#elif WINDOWS_PLATFORM
+	_ReadWriteBarrier();
+	*(volatile u64*)value = to;
+#endif
+}
+
+static i32
+file_descriptor(const char* path) {
+#ifdef LINUX_PLATFORM
+	return open(path, O_RDONLY);
+#elif WINDOWS_PLATFORM
+	return _open(path, _O_RDONLY | _O_BINARY);
+#endif
+}
+
+static void
+file_descriptor_close(i32 fd) {
+#ifdef LINUX_PLATFORM
+	close(fd);
+#elif WINDOWS_PLATFORM
+	_close(fd);
+#endif
+}
+
+
+// scan thread
+
+static void
+index_push(LargeFile* lf, u64 offset) {
+
+	u64 entry = lf->indexed;
+	sizet block = (sizet)(entry / LARGE_INDEX_BLOCK);
+	if (block >= lf->blockCount)
+		return;
+
+	if (!lf->blocks[block])
+		lf->blocks[block] = (u64*)malloc(LARGE_INDEX_BLOCK * sizeof(u64));
+
+	lf->blocks[block][entry % LARGE_INDEX_BLOCK] = offset;
+	store_release(&lf->indexed, entry + 1);
+}
+
+static void
+scan_run(LargeFile* lf) {
+
+	i32 fd = file_descriptor(lf->path);
+	if (fd < 0) return;
+
+	u8* data = (u8*)malloc(LARGE_CHUNK_SIZE);
+	u64 offset = 0;
+	u64 lines = 0;
+
+	while (!load_acquire(&lf->quit)) {
+
+#ifdef LINUX_PLATFORM
+		i64 read = ::read(fd, data, LARGE_CHUNK_SIZE);
+#elif WINDOWS_PLATFORM
+		i64 read = _read(fd, data, LARGE_CHUNK_SIZE);
+#endif
+		if (read <= 0) break;
+
+		u8* at = data;
+		u8* end = data + read;
+		while ((at = (u8*)memchr(at, '\n', end - at))) {
+
+			at++;
+			if (++lines % LARGE_INDEX_STRIDE == 0)
+				index_push(lf, offset + (at - data));
+		}
+
+		offset += read;
+	}
+
+	free(data);
+	file_descriptor_close(fd);
+}
+
+#ifdef LINUX_PLATFORM
+static void*
+scan_main(void* lf) {
+
+	scan_run((LargeFile*)lf);
+	return NULL;
+}
+#elif WINDOWS_PLATFORM
+static DWORD WINAPI
+scan_main(LPVOID lf) {
+
+	scan_run((LargeFile*)lf);
+	return 0;
+}
+#endif
+
+
+// chunks
+
+static sizet
+chunk_read(LargeFile* lf, u64 index, u8* out) {
+
+	u64 offset = index * LARGE_CHUNK_SIZE;
+	sizet length = lf->size - offset < LARGE_CHUNK_SIZE ? (sizet)(lf->size - offset) : LARGE_CHUNK_SIZE;
+
+#ifdef LINUX_PLATFORM
+	i64 read = pread(lf->fd, out, length, offset);
+#elif WINDOWS_PLATFORM
+	i64 read = _lseeki64(lf->fd, offset, SEEK_SET) < 0 ? -1 : _read(lf->fd, out, (u32)length);
+#endif
+
+	return read > 0 ? (sizet)read : 0;
+}
+
+// the chunk holding offset, read over the least recently used one when it
+// is not in the cache
+static LargeChunk*
+chunk_get(LargeFile* lf, u64 offset) {
+
+	u64 index = offset / LARGE_CHUNK_SIZE;
+	LargeChunk* oldest = &lf->chunks[0];
+
+	for (sizet i = 0; i < LARGE_CHUNK_CACHE; ++i) {
+
+		LargeChunk* chunk = &lf->chunks[i];
+		if (chunk->index == index) {
+			chunk->used = ++lf->clock;
+			return chunk;
+		}
+
+		if (chunk->used < oldest->used)
+			oldest = chunk;
+	}
+
+	if (!oldest->data)
+		oldest->data = (u8*)malloc(LARGE_CHUNK_SIZE);
+
+	oldest->index = index;
+	oldest->used = ++lf->clock;
+	oldest->length = chunk_read(lf, index, oldest->data);
+
+	return oldest;
+}
+
+static void
+range_copy(LargeFile* lf, u64 from, char* out, sizet length) {
+
+	while (length) {
+
+		LargeChunk* chunk = chunk_get(lf, from);
+		u64 base = chunk->index * LARGE_CHUNK_SIZE;
+		if (from - base >= chunk->length) {
+			memset(out, '\n', length);
+			return;
+		}
+
+		sizet count = chunk->length - (sizet)(from - base);
+		if (count > length)
+			count = length;
+
+		memcpy(out, chunk->data + (from - base), count);
+		out += count;
+		from += count;
+		length -= count;
+	}
+}
+
+// start of the line maxLines below the line start from, the end of the
+// file when it is not that long, lines is how many it went down
+static u64
+lines_forward(LargeFile* lf, u64 from, u64 maxLines, u64* lines) {
+
+	u64 at = from;
+	*lines = 0;
+
+	while (at < lf->size && *lines < maxLines) {
+
+		LargeChunk* chunk = chunk_get(lf, at);
+		u64 base = chunk->index * LARGE_CHUNK_SIZE;
+		if (at - base >= chunk->length) break;
+
+		u8* p = chunk->data + (at - base);
+		u8* end = chunk->data + chunk->length;
+		while (p < end && *lines < maxLines) {
+
+			u8* newline = (u8*)memchr(p, '\n', end - p);
+			if (!newline) {
+				p = end;
+				break;
+			}
+
+			p = newline + 1;
+			(*lines)++;
+		}
+
+		at = base + (p - chunk->data);
+	}
+
+	return at;
+}
+
+// start of the line above the line start from
+static u64
+line_above(LargeFile* lf, u64 from) {
+
+	// the newline ending the line above is skipped
+	u64 at = from - 1;
+
+	while (at > 0) {
+
+		LargeChunk* chunk = chunk_get(lf, at - 1);
+		u64 base = chunk->index * LARGE_CHUNK_SIZE;
+		if (at - base > chunk->length) return 0;
+
+		u8* p = chunk->data + (at - base);
+		while (p > chunk->data && p[-1] != '\n')
+			p--;
+
+		at = base + (p - chunk->data);
+		if (p > chunk->data) return at;
+	}
+
+	return 0;
+}
+
+// start of the line about half a slice above the line start from, lines
+// is how many it went up
+static u64
+slice_center(LargeFile* lf, u64 from, u64* lines) {
+
+	u64 start = from;
+	sizet bytes = 0;
+	*lines = 0;
+
+	while (start > 0 && *lines < LARGE_SLICE_LINES / 2 && bytes < LARGE_SLICE_BYTES / 2) {
+
+		u64 above = line_above(lf, start);
+		bytes += start - above < LARGE_LINE_MAX ? (sizet)(start - above) : LARGE_LINE_MAX;
+		start = above;
+		(*lines)++;
+	}
+
+	return start;
+}
+
+// start of line, or of the last line when the file ends above it, read
+// on from the nearest indexed line, found is the line it is the start of
+static u64
+index_find(LargeFile* lf, u64 line, u64* found) {
+
+	u64 entries = load_acquire(&lf->indexed);
+	u64 entry = line / LARGE_INDEX_STRIDE;
+	if (entry >= entries)
+		entry = entries - 1;
+
+	u64 anchor = lf->blocks[entry / LARGE_INDEX_BLOCK][entry % LARGE_INDEX_BLOCK];
+	u64 anchorLine = entry * LARGE_INDEX_STRIDE;
+
+	// past what the scan reached it stops one stride below
+	u64 want = line - anchorLine < LARGE_INDEX_STRIDE ? line - anchorLine : LARGE_INDEX_STRIDE;
+	u64 moved;
+	u64 start = lines_forward(lf, anchor, want, &moved);
+	if (moved < want)
+		start = lines_forward(lf, anchor, moved, &moved);
+
+	*found = anchorLine + moved;
+	return start;
+}
+
+static LargePosition
+position_of(Buffer* buf, sizet index) {
+
+	i32 line = buffer_line_based_on_index(buf, index);
+
+	LargePosition at;
+	at.line = buf->large->firstLine + line;
+	at.column = index - buffer_index_based_on_line(buf, line);
+
+	return at;
+}
+
+// the position in the slice, clamped to it
+static sizet
+index_of(Buffer* buf, LargePosition at) {
+
+	LargeFile* lf = buf->large;
+	u64 count = buf->lineLengths.length;
+
+	if (at.line < lf->firstLine)
+		return 0;
+	if (at.line - lf->firstLine >= count)
+		return buffer_length(buf);
+
+	i32 line = (i32)(at.line - lf->firstLine);
+	sizet length = buf->lineLengths[line];
+	sizet column = at.column < length ? at.column : length ? length - 1 : 0;
+
+	return buffer_index_based_on_line(buf, line) + column;
+}
+
+// puts the lines from start on into the buffer, the cursors stay on the
+// lines of the file they were on as far as the slice reaches
+static void
+slice_load(Buffer* buf, u64 start, u64 firstLine) {
+
+	LargeFile* lf = buf->large;
+
+	LargePosition cursor = position_of(buf, buf->cursor);
+	LargePosition* views = (LargePosition*)malloc((buf->views.length + 1) * sizeof(LargePosition));
+	for (sizet i = 0; i < buf->views.length; ++i)
+		views[i] = position_of(buf, buf->views[i].cursor);
+
+	array_reset(&lf->starts);
+	sizet length = 0;
+	u64 at = start;
+
+	while (at < lf->size && lf->starts.length < LARGE_SLICE_LINES && length < LARGE_SLICE_BYTES) {
+
+		u64 lines;
+		u64 next = lines_forward(lf, at, 1, &lines);
+		sizet copy = next - at < LARGE_LINE_MAX ? (sizet)(next - at) : LARGE_LINE_MAX;
+
+		range_copy(lf, at, buf->text + length, copy);
+		length += copy;
+
+		// a cut line still ends its line
+		if (copy < next - at && lines)
+			buf->text[length - 1] = '\n';
+
+		array_push(&lf->starts, at);
+		at = next;
+	}
+
+	buf->preLen = length;
+	buf->postLen = 0;
+	buf->gapLen = buf->size - length;
+
+	lf->start = start;
+	lf->end = at;
+	lf->firstLine = firstLine;
+
+	i32 removed = (i32)buf->lineLengths.length;
+	buf->cursor = 0;
+	array_reset(&buf->cursors);
+	folds_clear(buf);
+	buffer_rebuild_lines(buf);
+	buffer_edit(buf, 0, removed, (i32)buf->lineLengths.length);
+
+	buffer_set_cursor(buf, index_of(buf, cursor));
+	for (sizet i = 0; i < buf->views.length; ++i) {
+		buf->views[i].cursor = index_of(buf, views[i]);
+		array_reset(&buf->views[i].cursors);
+	}
+	free(views);
+
+	// matches the file, only the slice moved
+	buf->state = BUFFER_RESIDENT;
+}
+
+
+void
+large_set_threshold(u64 bytes) {
+
+	Threshold = bytes;
+}
+
+b8
+large_file_size(u64 size) {
+
+	return size >= Threshold;
+}
+
+// takes over a buffer with no text yet, false when the file cannot be read
+b8
+large_open(Buffer* buf) {
+
+	i32 fd = file_descriptor(buf->path.as_cstr());
+	if (fd < 0) {
+		WARN_MSG("Failed to open file %s \n", buf->path.as_cstr());
+		return false;
+	}
+
+	LargeFile* lf = (LargeFile*)calloc(1, sizeof(LargeFile));
+	lf->fd = fd;
+	lf->size = buf->fileSize;
+
+	lf->path = (char*)malloc(buf->path.length + 1);
+	memcpy(lf->path, buf->path.data, buf->path.length);
+	lf->path[buf->path.length] = '\0';
+
+	for (sizet i = 0; i < LARGE_CHUNK_CACHE; ++i)
+		lf->chunks[i].index = LARGE_CHUNK_NONE;
+
+	// every indexed line is at least LARGE_INDEX_STRIDE bytes after the last
+	lf->blockCount = (sizet)((lf->size / LARGE_INDEX_STRIDE + 1) / LARGE_INDEX_BLOCK + 1);
+	lf->blocks = (u64**)calloc(lf->blockCount, sizeof(u64*));
+	index_push(lf, 0);
+
+	array_init(&lf->starts, LARGE_SLICE_LINES);
+	lf->paged = UINT64_MAX;
+
+	// the most a slice can take, it never grows after
+	buf->size = LARGE_SLICE_BYTES + LARGE_LINE_MAX;
+	buf->text = (char*)realloc(buf->text, buf->size);
+
+	buf->large = lf;
+	buf->language = language_plain();
+	slice_load(buf, 0, 0);
+
+#ifdef LINUX_PLATFORM
+	lf->scanning = pthread_create(&lf->scanner, NULL, scan_main, lf) == 0;
+#elif WINDOWS_PLATFORM
+	lf->scanner = CreateThread(NULL, 0, scan_main, lf, 0, NULL);
+	lf->scanning = lf->scanner != NULL;
+#endif
+
+	if (!lf->scanning) {
+		WARN_MSG("failed to start the scan of %s, jumps stay near the top \n", lf->path);
+	}
+
+	NORMAL_MSG("Opened large file: %s \n", lf->path);
+	return true;
+}
+
+// stops the scan and drops the chunks, the text is freed with the buffer
+void
+large_close(Buffer* buf) {
+
+	LargeFile* lf = buf->large;
+	if (!lf) return;
+
+	if (lf->scanning) {
+
+		store_release(&lf->quit, 1);
+#ifdef LINUX_PLATFORM
+		pthread_join(lf->scanner, NULL);
+#elif WINDOWS_PLATFORM
+		WaitForSingleObject(lf->scanner, INFINITE);
+		CloseHandle(lf->scanner);
+#endif
+	}
+
+	file_descriptor_close(lf->fd);
+
+	for (sizet i = 0; i < LARGE_CHUNK_CACHE; ++i)
+		free(lf->chunks[i].data);
+	for (sizet i = 0; i < lf->blockCount; ++i)
+		free(lf->blocks[i]);
+	free(lf->blocks);
+	array_free(&lf->starts);
+	free(lf->path);
+	free(lf);
+
+	buf->large = NULL;
+}
+
+// moves the slice to center the cursor line once it got near an end that
+// is not the end of the file, the lines the windows on the buffer have to
+// move by
+i64
+large_page(Buffer* buf) {
+
+	LargeFile* lf = buf->large;
+
+	// the same line is never paged twice, a slice cut short by long lines
+	// may leave it near an end
+	u64 line = lf->firstLine + buf->currentLine;
+	if (line == lf->paged) return 0;
+	lf->paged = line;
+
+	i32 count = (i32)buf->lineLengths.length;
+	i32 margin = count / 4 < LARGE_SLICE_LINES / 8 ? count / 4 : LARGE_SLICE_LINES / 8;
+	if (margin < 1)
+		margin = 1;
+
+	b8 up = lf->firstLine > 0 && buf->currentLine < margin;
+	b8 down = lf->end < lf->size && buf->currentLine >= count - margin;
+	if (!up && !down) return 0;
+
+	u64 lineStart = (sizet)buf->currentLine < lf->starts.length ? lf->starts[buf->currentLine] : lf->end;
+	u64 back;
+	u64 start = slice_center(lf, lineStart, &back);
+	if (start == lf->start) return 0;
+
+	i64 shift = (i64)lf->firstLine - (i64)(line - back);
+	slice_load(buf, start, line - back);
+
+	return shift;
+}
+
+// slices the file around line, counted from the top of the file, relative
+// is where it is in the buffer, the lines the windows have to move by
+i64
+large_goto_line(Buffer* buf, u64 line, i32* relative) {
+
+	LargeFile* lf = buf->large;
+
+	u64 found;
+	u64 lineStart = index_find(lf, line, &found);
+
+	u64 back;
+	u64 start = slice_center(lf, lineStart, &back);
+
+	i64 shift = (i64)lf->firstLine - (i64)(found - back);
+	slice_load(buf, start, found - back);
+	*relative = (i32)back;
+
+	return shift;
+}
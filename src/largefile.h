@@ -0,0 +1,15 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+
+// a file too big to read whole, paged into its buffer a slice at a time,
+// see largefile.cpp
+typedef struct LargeFile LargeFile;
+
+void large_set_threshold(u64 bytes);
+b8 large_file_size(u64 size);
+b8 large_open(Buffer* buf);
+void large_close(Buffer* buf);
+i64 large_page(Buffer* buf);
+i64 large_goto_line(Buffer* buf, u64 line, i32* relative);
@@ -1,5 +1,6 @@
 #include "modes.h"
 #include "my_string.h"
+#include "globals.h"
 
 const EditorModeOps* const Modes[] = {
 	&NormalModeOps,
@@ -7,6 +8,14 @@ const EditorModeOps* const Modes[] = {
 	&NavigationModeOps
 };
 
+void 
+editor_change_mode(InputMode mode) {
+
+	Modes[InputMod]->on_end();
+	Modes[mode]->on_start();
+	InputMod = mode;
+}
+
 String
 ModeToString(InputMode mode) {
 	
@@ -6,6 +6,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #define STRING_MIN_SIZE 10
 
@@ -20,8 +21,9 @@ str_create(const char* text) {
 		out.capacity = STRING_MIN_SIZE;
 	}
 	else {
-		out.data = (char*)malloc(sizeof(char) * len);
-		out.capacity = len;
+		// room for the terminator, as_cstr must not realloc a shared string
+		out.data = (char*)malloc(sizeof(char) * (len + 1));
+		out.capacity = len + 1;
 	}
 	out.length = len;
 	out.refCount = (i16*)malloc(sizeof(i16));
@@ -48,7 +50,6 @@ str_create(sizet size) {
 		out.capacity = size;
 	}
 	out.length = 0;
-	out.data = (char*)malloc(sizeof(char) * size);
 	out.refCount = (i16*)malloc(sizeof(i16));
 	(*out.refCount) = 1;
 
@@ -294,7 +295,7 @@ str_free(String* str) {
 	
 	if (str->data) {
 		
-		ASSERT_MSG(*(str->refCount) > 1, "Deleting a string with refcount higher than 1");
+		ASSERT_MSG(*(str->refCount) <= 1, "Deleting a string with refcount higher than 1");
 		free(str->data);
 		free(str->refCount);
 		str->length = 0;
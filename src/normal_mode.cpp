@@ -14,14 +14,27 @@ on_event(Event& event) {
 		event.type == KEY_REPEAT) {
 		handle_key((KeyCode)event.key, event.mods);
 
-		if (event.key == KEY_Enter) 
-			buffer_insert_newline();
+		// a large file is shown read only
+		if (event.key == KEY_Enter && !CurBuffer->large) {
+
+			if (CurBuffer->cursors.length)
+				buffer_cursors_insert("\n", 1);
+			else
+				buffer_insert_newline();
+		}
 	}
 	else if (event.type == CHAR_INPUTED) {
         if (just_entered_edit_mode)
         {
             just_entered_edit_mode = false;
         }
+        else if (CurBuffer->large)
+        {
+        }
+        else if (CurBuffer->cursors.length)
+        {
+            buffer_cursors_insert(&event.character, 1);
+        }
         else
         {
             buffer_insert_char(event.character);
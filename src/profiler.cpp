@@ -0,0 +1,374 @@
+#include "profiler.h"
+#include "renderer.h"
+#include "my_string.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LINUX_PLATFORM
+#include <time.h>
+#include <x86intrin.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#include <intrin.h>
+#endif
+
+static ProfileZone Zones[PROFILE_MAX_ZONES];
+static i32 ZoneCount;
+
+static ProfileThread* Threads[PROFILE_MAX_THREADS];
+static i32 ThreadCount;
+static thread_local ProfileThread* LocalThread;
+
+// tsc and wall clock at init, ticks are converted with the ratio between
+// the two measured since then
+static u64 StartTicks;
+static u64 StartNs;
+static f64 TicksPerUs = 1.0;
+
+static b8 OverlayVisible;
+static String OverlayLine;
+
+// key event to buffer swap, upper bucket edges in microseconds, the
+// last bucket takes everything slower
+static const u64 LatencyEdges[LATENCY_BUCKETS] = {
+	1000, 2000, 4000, 8000, 12000, 16700, 25000, 33400, 50000, 100000
+};
+static u64 LatencyHistogram[LATENCY_BUCKETS + 1];
+static u64 LatencySamples[LATENCY_SAMPLES];
+static u64 LatencyCount;
+static u64 LatencyMax;
+
+
+static u64
+ticks_now() {
+
+	return __rdtsc();
+}
+
+static u64
+clock_now_ns() {
+#ifdef LINUX_PLATFORM
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#elif WINDOWS_PLATFORM
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	QueryPerformanceCounter(&counter);
+
+	return (u64)((f64)counter.QuadPart * 1000000000.0 / (f64)frequency.QuadPart);
+#endif
+}
+
+static i32
+atomic_increment(i32* value) {
+#ifdef LINUX_PLATFORM
+	return __atomic_fetch_add(value, 1, __ATOMIC_SEQ_CST);
+#elif WINDOWS_PLATFORM
+	return InterlockedIncrement((volatile long*)value) - 1;
+#endif
+}
+
+static void
+calibrate() {
+
+	u64 ns = clock_now_ns();
+	u64 ticks = ticks_now();
+
+	if (ns > StartNs && ticks > StartTicks)
+		TicksPerUs = (f64)(ticks - StartTicks) * 1000.0 / (f64)(ns - StartNs);
+}
+
+static f64
+ticks_to_us(u64 ticks) {
+
+	return (f64)ticks / TicksPerUs;
+}
+
+static int
+compare_ticks(const void* a, const void* b) {
+
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static ProfileThread*
+thread_get() {
+
+	if (LocalThread)
+		return LocalThread;
+
+	i32 index = atomic_increment(&ThreadCount);
+	if (index >= PROFILE_MAX_THREADS)
+		return NULL;
+
+	ProfileThread* thread = (ProfileThread*)calloc(1, sizeof(ProfileThread));
+	thread->id = index + 1;
+	Threads[index] = thread;
+	LocalThread = thread;
+
+	return thread;
+}
+
+
+void
+profiler_init() {
+
+	StartNs = clock_now_ns();
+	StartTicks = ticks_now();
+
+	// a first estimate, refined every time the counters are read
+	while (clock_now_ns() - StartNs < 10000000);
+	calibrate();
+
+	OverlayLine = str_create(128);
+}
+
+u64
+profiler_now() {
+
+	return ticks_now();
+}
+
+// called after the swap of the first frame that reflects an input event,
+// swap only queues the frame so vsync and compositor delay are not in it
+void
+profiler_latency_record(u64 inputTicks) {
+
+	calibrate();
+	u64 us = (u64)ticks_to_us(ticks_now() - inputTicks);
+
+	i32 bucket = 0;
+	while (bucket < LATENCY_BUCKETS && us > LatencyEdges[bucket])
+		bucket++;
+
+	LatencyHistogram[bucket]++;
+	LatencySamples[LatencyCount % LATENCY_SAMPLES] = us;
+	LatencyCount++;
+
+	if (us > LatencyMax)
+		LatencyMax = us;
+}
+
+static void
+latency_percentiles(f64* p50, f64* p99) {
+
+	u64 sorted[LATENCY_SAMPLES];
+	u64 count = LatencyCount < LATENCY_SAMPLES ? LatencyCount : LATENCY_SAMPLES;
+
+	*p50 = 0.0;
+	*p99 = 0.0;
+	if (!count) return;
+
+	memcpy(sorted, LatencySamples, sizeof(u64) * count);
+	qsort(sorted, count, sizeof(u64), compare_ticks);
+
+	*p50 = sorted[count / 2] / 1000.0;
+	*p99 = sorted[(count * 99) / 100] / 1000.0;
+}
+
+void
+profiler_latency_report() {
+
+	f64 p50, p99;
+	latency_percentiles(&p50, &p99);
+
+	printf("key to swap latency, %llu events, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		   (unsigned long long)LatencyCount, p50, p99, LatencyMax / 1000.0);
+
+	u64 low = 0;
+	for (i32 i = 0; i <= LATENCY_BUCKETS; ++i) {
+
+		if (i < LATENCY_BUCKETS)
+			printf("  %6.1f - %6.1f ms  %llu\n", low / 1000.0, LatencyEdges[i] / 1000.0,
+				   (unsigned long long)LatencyHistogram[i]);
+		else
+			printf("  %6.1f ms and up    %llu\n", low / 1000.0,
+				   (unsigned long long)LatencyHistogram[i]);
+
+		if (i < LATENCY_BUCKETS)
+			low = LatencyEdges[i];
+	}
+}
+
+i32
+profiler_zone_register(const char* name) {
+
+	i32 index = atomic_increment(&ZoneCount);
+	ASSERT_MSG(index < PROFILE_MAX_ZONES, "too many profiler zones");
+
+	Zones[index].name = name;
+	Zones[index].depth = -1;
+
+	return index;
+}
+
+ProfileScope::ProfileScope(i32 zoneIndex) {
+
+	ProfileThread* thread = thread_get();
+
+	zone = zoneIndex;
+	depth = thread ? thread->depth++ : 0;
+	start = ticks_now();
+}
+
+ProfileScope::~ProfileScope() {
+
+	u64 end = ticks_now();
+	ProfileThread* thread = LocalThread;
+
+	if (!thread) return;
+
+	thread->depth--;
+
+	ProfileEvent* event = &thread->events[thread->written % PROFILE_RING_SIZE];
+	event->zone = zone;
+	event->depth = depth;
+	event->start = start;
+	event->end = end;
+	thread->written++;
+
+	ProfileZone* z = &Zones[zone];
+	z->depth = depth;
+	z->samples[z->sampleCount % PROFILE_ZONE_SAMPLES] = end - start;
+	z->sampleCount++;
+}
+
+void
+profiler_toggle() {
+
+	OverlayVisible = !OverlayVisible;
+}
+
+static void
+overlay_line(const char* text, Vec2 position, Vec4 color) {
+
+	str_clear(&OverlayLine);
+	for (sizet i = 0; text[i] != '\0'; ++i)
+		str_push(&OverlayLine, text[i]);
+
+	render_text(OverlayLine, position, color);
+}
+
+void
+profiler_render(Vec2 position) {
+
+	if (!OverlayVisible) return;
+
+	calibrate();
+
+	f32 lineHeight = (f32)renderer_font_size() + 2.0f;
+	Vec2 size = {360.0f, lineHeight * (ZoneCount + 3) + 8.0f};
+	render_quad(position, size, {0.1f, 0.1f, 0.1f, 0.85f});
+
+	Vec4 color = {0.9f, 0.9f, 0.9f, 1.0f};
+	char text[128];
+	Vec2 pos = {position.x + 8.0f, position.y};
+
+	overlay_line("zone                 p50 us     p99 us", pos, color);
+	pos.y += lineHeight;
+
+	u64 sorted[PROFILE_ZONE_SAMPLES];
+
+	for (i32 i = 0; i < ZoneCount && i < PROFILE_MAX_ZONES; ++i) {
+
+		ProfileZone* z = &Zones[i];
+		u32 count = z->sampleCount < PROFILE_ZONE_SAMPLES ?
+			z->sampleCount : PROFILE_ZONE_SAMPLES;
+
+		f64 p50 = 0.0, p99 = 0.0;
+		if (count) {
+
+			memcpy(sorted, z->samples, sizeof(u64) * count);
+			qsort(sorted, count, sizeof(u64), compare_ticks);
+			p50 = ticks_to_us(sorted[count / 2]);
+			p99 = ticks_to_us(sorted[(count * 99) / 100]);
+		}
+
+		i32 indent = z->depth > 0 ? z->depth * 2 : 0;
+		snprintf(text, sizeof(text), "%*s%-*s %10.1f %10.1f",
+				 indent, "", 20 - indent, z->name, p50, p99);
+
+		overlay_line(text, pos, color);
+		pos.y += lineHeight;
+	}
+
+	f64 p50, p99;
+	latency_percentiles(&p50, &p99);
+
+	pos.y += lineHeight;
+	snprintf(text, sizeof(text), "key to swap ms  %6.2f  %6.2f  max %.2f",
+			 p50, p99, LatencyMax / 1000.0);
+	overlay_line(text, pos, color);
+
+	// histogram bars under the numbers, scaled to the fullest bucket
+	pos.y += lineHeight;
+	u64 fullest = 1;
+	for (i32 i = 0; i <= LATENCY_BUCKETS; ++i)
+		if (LatencyHistogram[i] > fullest)
+			fullest = LatencyHistogram[i];
+
+	f32 barWidth = (size.x - 16.0f) / (LATENCY_BUCKETS + 1);
+	for (i32 i = 0; i <= LATENCY_BUCKETS; ++i) {
+
+		f32 height = (lineHeight - 2.0f) * LatencyHistogram[i] / fullest;
+		Vec2 barPos = {pos.x + barWidth * i, pos.y + lineHeight - height};
+		render_quad(barPos, {barWidth - 2.0f, height}, {0.4f, 0.8f, 0.4f, 0.9f});
+	}
+}
+
+// writes the rings of every thread as chrome trace complete events,
+// loadable in chrome://tracing or perfetto
+b8
+profiler_export(const char* path) {
+
+	FILE* fp = fopen(path, "w");
+	if (!fp) {
+		ALERT_MSG("Failed to write trace: %s \n", path);
+		return false;
+	}
+
+	calibrate();
+
+	fprintf(fp, "{\"traceEvents\": [\n");
+	b8 first = true;
+
+	i32 threads = ThreadCount < PROFILE_MAX_THREADS ? ThreadCount : PROFILE_MAX_THREADS;
+	for (i32 t = 0; t < threads; ++t) {
+
+		ProfileThread* thread = Threads[t];
+		if (!thread) continue;
+
+		u64 written = thread->written;
+		u64 begin = written > PROFILE_RING_SIZE ? written - PROFILE_RING_SIZE : 0;
+
+		for (u64 i = begin; i < written; ++i) {
+
+			ProfileEvent* event = &thread->events[i % PROFILE_RING_SIZE];
+			fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+					"\"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+					first ? "  " : ",\n  ",
+					Zones[event->zone].name,
+					ticks_to_us(event->start - StartTicks),
+					ticks_to_us(event->end - event->start),
+					thread->id);
+			first = false;
+		}
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	NORMAL_MSG("Trace written: %s \n", path);
+	return true;
+}
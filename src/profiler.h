@@ -0,0 +1,67 @@
+#pragma once
+#include "types.h"
+#include "math.h"
+
+#define PROFILE_RING_SIZE 8192
+#define PROFILE_MAX_THREADS 16
+#define PROFILE_MAX_ZONES 64
+#define PROFILE_ZONE_SAMPLES 128
+#define LATENCY_SAMPLES 256
+#define LATENCY_BUCKETS 10
+
+typedef struct ProfileEvent {
+
+	i32 zone;
+	i32 depth;
+	u64 start;
+	u64 end;
+
+} ProfileEvent;
+
+// every thread that enters a zone owns one ring, only that thread writes
+// to it
+typedef struct ProfileThread {
+
+	i32 id;
+	i32 depth;
+	u64 written;
+	ProfileEvent events[PROFILE_RING_SIZE];
+
+} ProfileThread;
+
+typedef struct ProfileZone {
+
+	const char* name;
+	i32 depth;
+	u32 sampleCount;
+	// rolling window of the last durations in ticks
+	u64 samples[PROFILE_ZONE_SAMPLES];
+
+} ProfileZone;
+
+void profiler_init();
+u64 profiler_now();
+void profiler_latency_record(u64 inputTicks);
+void profiler_latency_report();
+i32 profiler_zone_register(const char* name);
+void profiler_toggle();
+void profiler_render(Vec2 position);
+b8 profiler_export(const char* path);
+
+struct ProfileScope {
+
+	i32 zone;
+	i32 depth;
+	u64 start;
+
+	ProfileScope(i32 zone);
+	~ProfileScope();
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// times the rest of the enclosing scope under the given name
+#define PROFILE_ZONE(name) \
+	static i32 PROFILE_CONCAT(profileZone, __LINE__) = profiler_zone_register(name); \
+	ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileZone, __LINE__))
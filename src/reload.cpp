@@ -0,0 +1,583 @@
+#include "reload.h"
+#include "buffer.h"
+#include "fileio.h"
+#include "journal.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LINUX_PLATFORM
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#define RELOAD_DIRS_MAX MAXIMUM_WAIT_OBJECTS
+#endif
+
+#define RELOAD_TICK_MS 100
+// edit distance in lines past which the changed region is replaced whole
+#define RELOAD_DIFF_MAX 1024
+// compared whole before the byte that differs is looked for
+#define RELOAD_SCAN_BLOCK 4096
+
+/* a buffer whose file was changed by something else is brought up to date
+   with only the lines that differ. the reload thread waits on the
+   directories of the open files, with inotify on linux and change
+   notifications on windows, and wakes the main thread, which compares the
+   stamp of every resident buffer with its file. the text in common at the
+   start and the end is skipped, the lines left in between are diffed and
+   each run that differs is patched in, so cursors, folds and the tokens of
+   the other lines stay. a buffer with edits is not touched, it is only
+   reported once.
+ */
+
+// lines of the changed region of one side, starts has one more entry, the
+// end of the region
+typedef struct DiffSide {
+
+	const char* text;
+	Array<sizet> starts;
+	Array<u32> hashes;
+	i32 count;
+
+} DiffSide;
+
+// lines [oldStart, oldEnd) became [newStart, newEnd), numbered from the
+// start of the region
+typedef struct DiffHunk {
+
+	i32 oldStart;
+	i32 oldEnd;
+	i32 newStart;
+	i32 newEnd;
+
+} DiffHunk;
+
+#ifdef LINUX_PLATFORM
+static pthread_t Watcher;
+static i32 Notify = -1;
+#elif WINDOWS_PLATFORM
+static HANDLE Watcher;
+// filled by the main thread, the count is published after the handle
+static HANDLE Handles[RELOAD_DIRS_MAX];
+static u64 HandleCount;
+#endif
+
+static b8 Running;
+static ReloadWake Wake;
+static u64 Quit;
+// bumped by the reload thread, read by the main thread
+static u64 Changes;
+// main thread only
+static u64 Seen;
+static Array<char*> Dirs;
+// dirty buffers already reported as changed on disk
+static Array<Buffer*> Warned;
+
+
+static u64
+load_acquire(u64* value) {
+#ifdef LINUX_PLATFORM
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif WINDOWS_PLATFORM
+	u64 out = *(volatile u64*)value;
+	_ReadWriteBarrier();
+	return out;
+#endif
+}
+
+static void
+store_release(u64* value, u64 to) {
+#ifdef LINUX_PLATFORM
+	__atomic_store_n(value, to, __ATOMIC_RELEASE);
+#elif WINDOWS_PLATFORM
+	_ReadWriteBarrier();
+	*(volatile u64*)value = to;
+#endif
+}
+
+
+// reload thread
+
+static void
+watcher_run() {
+
+#ifdef LINUX_PLATFORM
+	char events[4096];
+	struct pollfd notify = {Notify, POLLIN, 0};
+
+	while (!load_acquire(&Quit)) {
+
+		if (poll(&notify, 1, RELOAD_TICK_MS) <= 0)
+			continue;
+
+		// the events only say that a directory changed, every open file
+		// is checked
+		while (read(Notify, events, sizeof(events)) > 0) {}
+
+		store_release(&Changes, Changes + 1);
+		Wake();
+	}
+#elif WINDOWS_PLATFORM
+	while (!load_acquire(&Quit)) {
+
+		DWORD count = (DWORD)load_acquire(&HandleCount);
+		if (!count) {
+			Sleep(RELOAD_TICK_MS);
+			continue;
+		}
+
+		DWORD signaled = WaitForMultipleObjects(count, Handles, FALSE, RELOAD_TICK_MS);
+		if (signaled >= WAIT_OBJECT_0 + count)
+			continue;
+
+		FindNextChangeNotification(Handles[signaled - WAIT_OBJECT_0]);
+
+		store_release(&Changes, Changes + 1);
+		Wake();
+	}
+#endif
+}
+
+#ifdef LINUX_PLATFORM
+static void*
+watcher_main(void*) {
+
+	watcher_run();
+	return NULL;
+}
+#elif WINDOWS_PLATFORM
+static DWORD WINAPI
+watcher_main(LPVOID) {
+
+	watcher_run();
+	return 0;
+}
+#endif
+
+
+// main thread
+
+static u32
+line_hash(const char* text, sizet length) {
+
+	u32 hash = 2166136261u;
+	for (sizet i = 0; i < length; ++i)
+		hash = (hash ^ (u8)text[i]) * 16777619u;
+
+	return hash;
+}
+
+// splits text[from, to) into lines, the last one may have no newline
+static void
+side_split(DiffSide* side, const char* text, sizet from, sizet to) {
+
+	side->text = text;
+	array_init(&side->starts, 64);
+	array_init(&side->hashes, 64);
+
+	for (sizet start = from; start < to;) {
+
+		const char* newline = (const char*)memchr(text + start, '\n', to - start);
+		sizet end = newline ? newline - text + 1 : to;
+
+		array_push(&side->starts, start);
+		array_push(&side->hashes, line_hash(text + start, end - start));
+		start = end;
+	}
+
+	side->count = (i32)side->starts.length;
+	array_push(&side->starts, to);
+}
+
+static void
+side_free(DiffSide* side) {
+
+	array_free(&side->starts);
+	array_free(&side->hashes);
+}
+
+static b8
+lines_equal(DiffSide* a, i32 x, DiffSide* b, i32 y) {
+
+	if (a->hashes[x] != b->hashes[y])
+		return false;
+
+	sizet length = a->starts[x + 1] - a->starts[x];
+	return length == b->starts[y + 1] - b->starts[y] &&
+		memcmp(a->text + a->starts[x], b->text + b->starts[y], length) == 0;
+}
+
+// myers' shortest edit script between the lines of a and b, the runs that
+// differ go to hunks back to front, false when it takes more than
+// RELOAD_DIFF_MAX lines
+static b8
+diff_lines(DiffSide* a, DiffSide* b, Array<DiffHunk>* hunks) {
+
+	i32 n = a->count;
+	i32 m = b->count;
+	i32 max = n + m < RELOAD_DIFF_MAX ? n + m : RELOAD_DIFF_MAX;
+	i32 offset = max + 1;
+
+	// furthest x reached on every diagonal k = x - y, and a copy of it
+	// before every round to walk back through
+	i32* v = (i32*)calloc(2 * max + 3, sizeof(i32));
+	i32* trace = (i32*)malloc(sizeof(i32) * (max + 1) * (max + 1));
+	i32 found = -1;
+
+	for (i32 d = 0; d <= max && found < 0; ++d) {
+
+		memcpy(trace + d * d, v + offset - d, sizeof(i32) * (2 * d + 1));
+
+		for (i32 k = -d; k <= d; k += 2) {
+
+			i32 x = k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]) ?
+				v[offset + k + 1] : v[offset + k - 1] + 1;
+			i32 y = x - k;
+
+			while (x < n && y < m && lines_equal(a, x, b, y)) {
+				x++;
+				y++;
+			}
+
+			v[offset + k] = x;
+			if (x >= n && y >= m) {
+				found = d;
+				break;
+			}
+		}
+	}
+
+	i32 x = n;
+	i32 y = m;
+	b8 open = false;
+	DiffHunk hunk = {};
+
+	for (i32 d = found; d > 0; --d) {
+
+		i32* prev = trace + d * d + d;
+		i32 k = x - y;
+		i32 prevK = k == -d || (k != d && prev[k - 1] < prev[k + 1]) ? k + 1 : k - 1;
+		i32 prevX = prev[prevK];
+		i32 prevY = prevX - prevK;
+
+		// one line inserted or deleted, then the lines in common up to x
+		i32 midX = prevK == k + 1 ? prevX : prevX + 1;
+		i32 midY = midX - k;
+
+		if (open && x > midX) {
+			array_push(hunks, hunk);
+			open = false;
+		}
+		if (!open) {
+			hunk.oldEnd = midX;
+			hunk.newEnd = midY;
+			open = true;
+		}
+
+		hunk.oldStart = prevX;
+		hunk.newStart = prevY;
+		x = prevX;
+		y = prevY;
+	}
+
+	if (open)
+		array_push(hunks, hunk);
+
+	free(v);
+	free(trace);
+
+	return found >= 0;
+}
+
+static i32
+count_lines(const char* text, sizet from, sizet to) {
+
+	i32 lines = 0;
+	const char* at = text + from;
+	const char* end = text + to;
+
+	while (at < end && (at = (const char*)memchr(at, '\n', end - at))) {
+		lines++;
+		at++;
+	}
+
+	return lines;
+}
+
+static b8
+line_start(const char* text, sizet pos, sizet prefix) {
+
+	return pos == prefix || text[pos - 1] == '\n';
+}
+
+// patches the buffer to what is in its file now, only the lines that
+// differ are replaced
+static void
+reload_buffer(Buffer* buf, u64 time, sizet size) {
+
+	// gone or being replaced, the next change reads it
+	File file = file_open(buf->path.as_cstr());
+	if (!file.buffer) return;
+
+	String old = buffer_get_text_copy(buf);
+	const char* a = old.data;
+	const char* b = file.buffer;
+	sizet aLength = old.length;
+	sizet bLength = file.size;
+	sizet shorter = aLength < bLength ? aLength : bLength;
+
+	// the text in common at both ends, cut back to whole lines
+	sizet prefix = 0;
+	while (prefix + RELOAD_SCAN_BLOCK <= shorter &&
+		   memcmp(a + prefix, b + prefix, RELOAD_SCAN_BLOCK) == 0)
+		prefix += RELOAD_SCAN_BLOCK;
+	while (prefix < shorter && a[prefix] == b[prefix])
+		prefix++;
+	while (prefix > 0 && a[prefix - 1] != '\n')
+		prefix--;
+
+	sizet suffix = 0;
+	while (suffix + RELOAD_SCAN_BLOCK <= shorter - prefix &&
+		   memcmp(a + aLength - suffix - RELOAD_SCAN_BLOCK, b + bLength - suffix - RELOAD_SCAN_BLOCK,
+				  RELOAD_SCAN_BLOCK) == 0)
+		suffix += RELOAD_SCAN_BLOCK;
+	while (suffix < shorter - prefix && a[aLength - suffix - 1] == b[bLength - suffix - 1])
+		suffix++;
+	while (suffix > 0 && !(line_start(a, aLength - suffix, prefix) &&
+						   line_start(b, bLength - suffix, prefix)))
+		suffix--;
+
+	if (prefix != aLength - suffix || prefix != bLength - suffix) {
+
+		DiffSide oldSide;
+		DiffSide newSide;
+		side_split(&oldSide, a, prefix, aLength - suffix);
+		side_split(&newSide, b, prefix, bLength - suffix);
+
+		Array<DiffHunk> diff;
+		array_init(&diff, 16);
+		if (!diff_lines(&oldSide, &newSide, &diff)) {
+
+			array_reset(&diff);
+			DiffHunk whole = {0, oldSide.count, 0, newSide.count};
+			array_push(&diff, whole);
+		}
+
+		i32 first = count_lines(a, 0, prefix);
+		// without a suffix the regions run to the end of the text
+		i32 oldLines = first + count_lines(a, prefix, aLength - suffix) + 1;
+		i32 newLines = first + count_lines(b, prefix, bLength - suffix) + 1;
+
+		Array<BufferHunk> hunks;
+		array_init(&hunks, diff.length + 1);
+
+		for (sizet i = diff.length; i-- > 0;) {
+
+			DiffHunk* run = &diff[i];
+			BufferHunk hunk;
+			hunk.pos = oldSide.starts[run->oldStart];
+			hunk.deleteLen = oldSide.starts[run->oldEnd] - hunk.pos;
+			hunk.insert = b + newSide.starts[run->newStart];
+			hunk.insertLen = newSide.starts[run->newEnd] - newSide.starts[run->newStart];
+			hunk.line = first + run->oldStart;
+			hunk.removed = run->oldEnd - run->oldStart;
+			hunk.added = run->newEnd - run->newStart;
+
+			// the empty line after a last newline is not one of the lines
+			// split, a run at the end of the text takes it
+			if (!suffix && run->oldEnd == oldSide.count) {
+				hunk.removed = oldLines - hunk.line;
+				hunk.added = newLines - (first + run->newStart);
+			}
+
+			array_push(&hunks, hunk);
+		}
+
+		buffer_patch(buf, hunks.data, hunks.length);
+
+		NORMAL_MSG("Reloaded %s, %i runs of lines changed \n", buf->path.as_cstr(), (i32)hunks.length);
+
+		array_free(&hunks);
+		array_free(&diff);
+		side_free(&oldSide);
+		side_free(&newSide);
+	}
+
+	buf->fileTime = time;
+	buf->fileSize = size;
+	// a journal left from an earlier edit starts over from the new file
+	journal_saved(buf);
+
+	str_free(&old);
+	str_free(&file.path);
+	free(file.buffer);
+}
+
+static void
+watch_dir(const char* dir) {
+
+	for (sizet i = 0; i < Dirs.length; ++i)
+		if (strcmp(Dirs[i], dir) == 0)
+			return;
+
+#ifdef LINUX_PLATFORM
+	// written in place or moved over, a replaced file has a new inode so
+	// the directory is watched and not the file
+	if (inotify_add_watch(Notify, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		WARN_MSG("failed to watch %s for changes \n", dir);
+		return;
+	}
+#elif WINDOWS_PLATFORM
+	u64 count = HandleCount;
+	if (count == RELOAD_DIRS_MAX) {
+		WARN_MSG("too many directories, %s is not watched for changes \n", dir);
+		return;
+	}
+
+	HANDLE handle = FindFirstChangeNotificationA(dir, FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+	if (handle == INVALID_HANDLE_VALUE) {
+		WARN_MSG("failed to watch %s for changes \n", dir);
+		return;
+	}
+
+	Handles[count] = handle;
+	store_release(&HandleCount, count + 1);
+#endif
+
+	sizet length = strlen(dir);
+	char* copy = (char*)malloc(length + 1);
+	memcpy(copy, dir, length + 1);
+	array_push(&Dirs, copy);
+}
+
+
+void
+reload_init(ReloadWake wake) {
+
+	Wake = wake;
+	Quit = 0;
+	array_init(&Dirs, 8);
+	array_init(&Warned, 4);
+
+#ifdef LINUX_PLATFORM
+	Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	Running = Notify >= 0 && pthread_create(&Watcher, NULL, watcher_main, NULL) == 0;
+#elif WINDOWS_PLATFORM
+	HandleCount = 0;
+	Watcher = CreateThread(NULL, 0, watcher_main, NULL, 0, NULL);
+	Running = Watcher != NULL;
+#endif
+
+	if (!Running) {
+		WARN_MSG("failed to start the reload thread, %s \n", "changes to open files are not seen");
+	}
+}
+
+void
+reload_shutdown() {
+
+	if (Running) {
+
+		store_release(&Quit, 1);
+#ifdef LINUX_PLATFORM
+		pthread_join(Watcher, NULL);
+#elif WINDOWS_PLATFORM
+		WaitForSingleObject(Watcher, INFINITE);
+		CloseHandle(Watcher);
+#endif
+		Running = false;
+	}
+
+#ifdef LINUX_PLATFORM
+	if (Notify >= 0)
+		close(Notify);
+	Notify = -1;
+#elif WINDOWS_PLATFORM
+	for (u64 i = 0; i < HandleCount; ++i)
+		FindCloseChangeNotification(Handles[i]);
+	HandleCount = 0;
+#endif
+
+	for (sizet i = 0; i < Dirs.length; ++i)
+		free(Dirs[i]);
+	array_free(&Dirs);
+	array_free(&Warned);
+}
+
+// starts watching the directory of the file of buf, once per directory
+void
+reload_watch(Buffer* buf) {
+
+	if (!Running || !buf->path.length) return;
+
+	const char* path = buf->path.as_cstr();
+	sizet end = strlen(path);
+	while (end > 0 && path[end - 1] != '/' && path[end - 1] != '\\')
+		end--;
+
+	if (!end) {
+		watch_dir(".");
+		return;
+	}
+
+	char* dir = (char*)malloc(end + 1);
+	memcpy(dir, path, end);
+	// the root keeps its separator
+	dir[end > 1 ? end - 1 : end] = '\0';
+
+	watch_dir(dir);
+	free(dir);
+}
+
+// brings the buffers whose files changed since the last poll up to date
+void
+reload_poll() {
+
+	u64 changes = load_acquire(&Changes);
+	if (changes == Seen) return;
+	Seen = changes;
+
+	// saved or reloaded since, they are reported again next time
+	for (sizet i = Warned.length; i-- > 0;)
+		if (Warned[i]->state != BUFFER_DIRTY)
+			array_erase(&Warned, i);
+
+	Array<Buffer*> buffers;
+	buffers_get_all(&buffers);
+
+	for (sizet i = 0; i < buffers.length; ++i) {
+
+		Buffer* buf = buffers[i];
+		// unloaded ones read the file when they are shown
+		if (!buf->path.length || buf->large || buf->followed || buf->state == BUFFER_UNLOADED)
+			continue;
+
+		u64 time;
+		sizet size;
+		if (!file_stamp(buf->path.as_cstr(), &time, &size))
+			continue;
+		if (time == buf->fileTime && size == buf->fileSize)
+			continue;
+
+		if (buf->state == BUFFER_RESIDENT) {
+			reload_buffer(buf, time, size);
+			continue;
+		}
+
+		b8 warned = false;
+		for (sizet k = 0; k < Warned.length; ++k)
+			warned = warned || Warned[k] == buf;
+
+		if (!warned) {
+			ALERT_MSG("%s changed on disk, it has edits and is not reloaded \n", buf->path.as_cstr());
+			array_push(&Warned, buf);
+		}
+	}
+
+	array_free(&buffers);
+}
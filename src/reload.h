@@ -0,0 +1,11 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+
+typedef void (*ReloadWake)();
+
+void reload_init(ReloadWake wake);
+void reload_shutdown();
+void reload_watch(Buffer* buf);
+void reload_poll();
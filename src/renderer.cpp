@@ -5,6 +5,11 @@
 #include "cursor.h"
 #include "config.h"
 #include "globals.h"
+#include "wrap.h"
+#include "profiler.h"
+#include "syntax.h"
+#include "fold.h"
+#include "largefile.h"
 
 #include <glad/glad.h>
 
@@ -14,6 +19,9 @@
 static Vec4 global_Colors[TOK_TOTAL];
 static Vec4 global_CursorColor = {1.0f, 1.0f, 1.0f, 0.5f};
 static Renderer g_Renderer;
+static RenderStats g_Stats;
+// no gl context, batches are built in memory and dropped in renderer_end
+static b8 g_Headless;
 
 static void
 error_callback(int code, const char* description) {
@@ -136,6 +144,13 @@ renderer_create_window() {
 
 }
 
+static void
+batch_flush() {
+
+	g_Stats.flushes++;
+	renderer_end();
+}
+
 static void
 texture_load(const char* path, u32* texID, u8 slot) {
 
@@ -286,6 +301,11 @@ renderer_load_font(const char* fontFile, i32 fontSize) {
 
 	g_Renderer.glyphs['\t'].advanceX = g_Renderer.glyphs[' '].advanceX * 4;
 
+	f32 advances[128];
+	for (u8 i = 0; i < 128; ++i)
+		advances[i] = g_Renderer.glyphs[i].advanceX;
+	buffers_set_font_advances(advances);
+
 
 	FT_Done_Face(g_Renderer.fontFace);
 	FT_Done_FreeType(g_Renderer.ftLib);
@@ -293,9 +313,59 @@ renderer_load_font(const char* fontFile, i32 fontSize) {
   
 }
 
+// sets up the vertex batch and synthetic monospace glyph metrics
+// without touching gl or freetype, used by the render benchmark
+void
+renderer_initialize_headless(f32 width, f32 height, i32 fontSize) {
+
+	g_Headless = true;
+
+	g_Renderer.vertexArray = new Vertex[MAX_VERTICES];
+	g_Renderer.vertexArrayIndex = g_Renderer.vertexArray;
+	g_Renderer.vertexCount = 0;
+
+	mat_ortho(g_Renderer.projection, 0.0f, width, height, 0.0f);
+
+	g_Renderer.fontSize = fontSize;
+	g_Renderer.bitmapW = 128.0f * fontSize;
+	g_Renderer.bitmapH = (f32)fontSize;
+
+	f32 advances[128];
+	for (u8 i = 0; i < 128; ++i) {
+
+		g_Renderer.glyphs[i].advanceX = (f32)(fontSize * 6 / 10);
+		g_Renderer.glyphs[i].advanceY = 0.0f;
+		g_Renderer.glyphs[i].width = (f32)(fontSize / 2);
+		g_Renderer.glyphs[i].height = (f32)(fontSize * 7 / 10);
+		g_Renderer.glyphs[i].bearingX = 1.0f;
+		g_Renderer.glyphs[i].bearingY = (f32)(fontSize * 7 / 10);
+		g_Renderer.glyphs[i].offsetX = (f32)i / 128.0f;
+	}
+
+	g_Renderer.glyphs['\t'].advanceX = g_Renderer.glyphs[' '].advanceX * 4;
+
+	for (u8 i = 0; i < 128; ++i)
+		advances[i] = g_Renderer.glyphs[i].advanceX;
+	buffers_set_font_advances(advances);
+}
+
+RenderStats
+renderer_stats() {
+
+	return g_Stats;
+}
+
+void
+renderer_stats_reset() {
+
+	g_Stats = {};
+}
+
 void
 renderer_begin() {
 
+	if (g_Headless) return;
+
 	glClearColor(0.1f, 0.1f, 0.13, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
@@ -319,7 +389,7 @@ render_quad(Vec2 position, Vec2 size, Vec4 color) {
 		};
 
 		if (g_Renderer.vertexCount >= MAX_VERTICES) {
-			renderer_end();
+			batch_flush();
 		}
 
 		for (int i = 0; i < VERTICES_PER_QUAD; ++i) {
@@ -347,7 +417,7 @@ render_textured_quad(Vec2 position, Vec2 size, Vec4 color, u32 texID) {
 		};
 
 		if (g_Renderer.vertexCount >= MAX_VERTICES) {
-			renderer_end();
+			batch_flush();
 		}
 
 		for (int k = 0; k < VERTICES_PER_QUAD; ++k) {
@@ -402,8 +472,7 @@ render_text(String& text, Vec2 position, Vec4 color) {
 		};
 
 		if (g_Renderer.vertexCount >= MAX_VERTICES) {
-
-			renderer_end();
+			batch_flush();
 		}
 
 		for (int j = 0; j < VERTICES_PER_QUAD; ++j) {
@@ -421,73 +490,72 @@ render_text(String& text, Vec2 position, Vec4 color) {
 }
 
 
-void
-render_buffer(Buffer* buf, Window *window, Array<Token> tokens) {
-
-	static float xpos, ypos, w, h, offsetX,
-		texX, texY, advanceX, advanceY, tokLen;
+// first token of the line in [low, high) that ends after offset
+static u32
+first_token_after(Token* tokens, u32 low, u32 high, u32 offset) {
 
+	while (low < high) {
 
-	advanceY = window->position.y;
-	advanceX = window->position.x;
+		u32 mid = (low + high) / 2;
+		if (tokens[mid].offset + tokens[mid].length <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-	u32 tokIndex = 0;
-	Vec4 color = global_Colors[0];
+	return low;
+}
 
-	sizet visibleLines = (window->size.h -
-						  (window->size.h % g_Renderer.fontSize) - 1) / g_Renderer.fontSize;
+// renders characters [from, to) of the line starting at lineStart on one
+// row, stops at the right edge
+static void
+render_buffer_row(Buffer* buf, Token* tokens, u32 tokEnd, sizet lineStart,
+				  sizet from, sizet to, Vec2 position, f32 right) {
 
-	window->renderView.end = window->renderView.start + visibleLines - 1;
-	if (window->renderView.end > buf->lineLengths.length)
-		window->renderView.end = buf->lineLengths.length;
+	static float xpos, ypos, w, h, offsetX,
+		texX, texY, advanceX, advanceY;
 
-	sizet start = buffer_index_based_on_line(buf, window->renderView.start);
-	sizet end = buffer_index_based_on_line(buf, window->renderView.end);
+	advanceX = position.x;
+	advanceY = position.y;
 
+	u32 tokIndex = first_token_after(tokens, 0, tokEnd, (u32)(from - lineStart));
 
-	sizet len = buf->gapLen + buf->preLen + buf->postLen;
-	sizet startIndex = buf->preLen == 0 ? buf->gapLen : 0;
+	Vec4 color = global_Colors[0];
 
-	for (sizet i = startIndex; i < len; ++i) {
-	//for (sizet i = start; i < end + buf->gapLen; ++i) {
+	for (sizet i = from; i < to; ++i) {
 
-		char c = buf->text[i];
-		//skip gap
-		if (i == buf->preLen - 1)
-			i += buf->gapLen;
+		char c = buffer_char_at(buf, i);
 
-		if (tokLen <= 0) 
-		    color = global_Colors[TOK_IDENTIFIER];
+		if (c == '\n' || advanceX >= right)
+			break;
 
-		tokLen--;
+		if (c == '\t') {
 
-		if (c == '\n') {
-			advanceY += g_Renderer.fontSize;
-			advanceX = window->position.x;
+			advanceX += g_Renderer.glyphs['\t'].advanceX;
 			continue;
 		}
-		else if (c == '\t') {
 
-			advanceX += g_Renderer.glyphs[c].advanceX;
+		// bytes outside the glyph table take no room, as for the cursor
+		if ((u8)c >= 128)
 			continue;
-		}
+		GlyphData* glyph = &g_Renderer.glyphs[(u8)c];
 
+		u32 column = (u32)(i - lineStart);
+		while (tokIndex < tokEnd &&
+			   tokens[tokIndex].offset + tokens[tokIndex].length <= column)
+			tokIndex++;
 
-		if (advanceY >= window->size.h + window->position.y - g_Renderer.fontSize) {
-			break;
-		}
-		if (advanceX >= window->position.x + window->size.x) {
-			// advanceX = window->position.x;
-			// advanceY += g_Renderer.fontSize;
-			continue;
-		}
+		if (tokIndex < tokEnd && tokens[tokIndex].offset <= column)
+			color = global_Colors[tokens[tokIndex].type];
+		else
+			color = global_Colors[TOK_IDENTIFIER];
 
-		xpos = advanceX + g_Renderer.glyphs[c].bearingX;
+		xpos = advanceX + glyph->bearingX;
 		// this is stupid, idk how else to make it work
-		ypos = advanceY - g_Renderer.glyphs[c].bearingY + g_Renderer.fontSize;
-		w = g_Renderer.glyphs[c].width;
-		h = g_Renderer.glyphs[c].height;
-		offsetX = g_Renderer.glyphs[c].offsetX;
+		ypos = advanceY - glyph->bearingY + g_Renderer.fontSize;
+		w = glyph->width;
+		h = glyph->height;
+		offsetX = glyph->offsetX;
 		texX = w / g_Renderer.bitmapW;
 		texY = h / g_Renderer.bitmapH;
 
@@ -501,19 +569,9 @@ render_buffer(Buffer* buf, Window *window, Array<Token> tokens) {
 		};
 
 		if (g_Renderer.vertexCount >= MAX_VERTICES) {
-
-			renderer_end();
-		}
-
-
-		if (tokIndex < tokens.length && i == tokens[tokIndex].pos) {
-
-			color = global_Colors[tokens[tokIndex].type];
-			tokLen = tokens[tokIndex].length;
-			tokIndex++;
+			batch_flush();
 		}
 
-
 		for (i32 j = 0; j < VERTICES_PER_QUAD; ++j) {
 
 			g_Renderer.vertexArrayIndex->color = color;
@@ -522,15 +580,94 @@ render_buffer(Buffer* buf, Window *window, Array<Token> tokens) {
 			g_Renderer.vertexArrayIndex++;
 		}
 
-
 		g_Renderer.vertexCount += VERTICES_PER_QUAD;
-		advanceX += g_Renderer.glyphs[c].advanceX;
+		advanceX += glyph->advanceX;
 	}
+}
+
+void
+render_buffer(Buffer* buf, Window *window) {
+
+	{
+		PROFILE_ZONE("tokenize");
+		syntax_update(buf);
+	}
+
+	PROFILE_ZONE("render_buffer");
+
+	Vec2 rowPos = window->position;
+	f32 right = window->position.x + window->size.w;
+	f32 bottom = window->position.y + window->size.h - g_Renderer.fontSize;
+
+	// other windows on the buffer may still start inside a new fold
+	window->renderView.start = fold_visible_line(buf, window->renderView.start);
+
+	sizet bufLength = buffer_length(buf);
+	sizet lineStart = buffer_index_based_on_line(buf, window->renderView.start);
+
+	i32 line = window->renderView.start;
+	while (line < (i32)buf->lineLengths.length && rowPos.y < bottom) {
+
+		sizet lineEnd = lineStart + buf->lineLengths[line];
+		if (lineEnd > bufLength)
+			lineEnd = bufLength;
+
+		u32 tokenCount;
+		Token* tokens = syntax_line(buf, line, lineStart, &tokenCount);
+
+		if (window->softWrap) {
+
+			WrapLine* wrap = wrap_line_get(buf, line, window->size.w);
+			i32 row = line == window->renderView.start ? window->rowStart : 0;
+
+			for (; row < (i32)wrap->rows.length && rowPos.y < bottom; ++row) {
+
+				sizet rowEnd = lineStart + wrap_row_end(buf, wrap, row);
+				if (rowEnd > lineEnd)
+					rowEnd = lineEnd;
+
+				render_buffer_row(buf, tokens, tokenCount, lineStart,
+								  lineStart + wrap->rows[row].offset, rowEnd, rowPos, right);
+				rowPos.y += g_Renderer.fontSize;
+			}
+		}
+		else {
+
+			// skip straight to the first visible column instead of walking
+			// the whole line
+			i32 firstColumn;
+			f32 firstPixelX;
+			i32 offset = buffer_offset_at_column(buf, line, window->columnStart,
+												 &firstColumn, &firstPixelX);
+
+			render_buffer_row(buf, tokens, tokenCount, lineStart, lineStart + offset,
+							  lineEnd, rowPos, right);
+			rowPos.y += g_Renderer.fontSize;
+		}
+
+		// folded lines are stepped over, not walked
+		i32 next = fold_next_line(buf, line);
+		if (next != line + 1) {
+
+			Vec2 markPos = {(f32)window->position.x, rowPos.y - 2.0f};
+			Vec2 markSize = {(f32)window->size.w, 1.0f};
+			render_quad(markPos, markSize, {0.5f, 0.5f, 0.5f, 1.0f});
+
+			lineStart = buffer_index_based_on_line(buf, next);
+		}
+		else {
+			lineStart += buf->lineLengths[line];
+		}
+
+		line = next;
+	}
+
+	window->renderView.end = line;
 
 
 	#ifdef DEBUG
 
-	Vec2 quadSize = {400.0f, 160.0f};
+	Vec2 quadSize = {400.0f, 200.0f};
 	Vec2 pos = {window->position.x + window->size.w - 400.0f, (f32)window->position.y};
 	Vec4 quadColor = {0.2f, 0.2f, 0.2f, 0.8f};
 	render_quad(pos, quadSize, quadColor);
@@ -539,10 +676,12 @@ render_buffer(Buffer* buf, Window *window, Array<Token> tokens) {
 	DEBUG_TEXT(pos, "size: [%i, %i]", window->size.w, window->size.h) pos.y += 20.0f;
 	DEBUG_TEXT(pos, "start line: %i", window->renderView.start) pos.y += 20.0f;
 	DEBUG_TEXT(pos, "end line: %i", window->renderView.end) pos.y += 20.0f;
+	DEBUG_TEXT(pos, "start column: %i", window->columnStart) pos.y += 20.0f;
+	DEBUG_TEXT(pos, "start row: %i wrap: %i", window->rowStart, window->softWrap) pos.y += 20.0f;
 	DEBUG_TEXT(pos, "window ID: %i", window->id) pos.y += 20.0f;
 	DEBUG_TEXT(pos, "parent: %p", window->parent) pos.y += 20.0f;
 	DEBUG_TEXT(pos, "adress: %p", window) pos.y += 20.0f;
-	DEBUG_TEXT(pos, "key %s", window->key) pos.y += 20.0f;
+	DEBUG_TEXT(pos, "buffer %s", window->buffer->name.as_cstr()) pos.y += 20.0f;
 
 	#endif
 
@@ -563,6 +702,20 @@ render_status_line(String& bufferName, Window* window) {
 	render_text(bufferName, pos, {0.1f, 0.1f, 0.1f, 1.0f});
 }
 
+static void
+render_bracket_mark(Buffer* buf, Window* win, sizet index) {
+
+	Vec2 pos;
+	if (!cursor_screen_pos(buf, win, index, &pos)) return;
+
+	pos.y += renderer_font_size() / 5;
+	// a byte outside the glyph table is marked as wide as a space
+	u8 c = (u8)buffer_char_at(buf, index);
+	GlyphData* glyph = &g_Renderer.glyphs[c < 128 ? c : ' '];
+	Vec2 size = {glyph->advanceX, (f32)g_Renderer.fontSize};
+	render_quad(pos, size, {0.8f, 0.8f, 0.8f, 0.25f});
+}
+
 void
 render_cursor(Buffer* buf, Window* win, CursorStyle style) {
 
@@ -573,6 +726,39 @@ render_cursor(Buffer* buf, Window* win, CursorStyle style) {
 	// TODO: fix wierd offset
 	cursorPos.y += renderer_font_size() / 5;
 	render_quad(cursorPos, cursorSize, global_Colors[2]);
+
+	// the bracket at the cursor and its match
+	sizet bracket, match;
+	if (cursor_bracket_pair(buf, &bracket, &match)) {
+		render_bracket_mark(buf, win, bracket);
+		render_bracket_mark(buf, win, match);
+	}
+
+	if (!buf->cursors.length) return;
+
+	// extra cursors, only the ones inside the render view
+	sizet viewStart = buffer_index_based_on_line(buf, win->renderView.start);
+	sizet viewEnd = buffer_index_based_on_line(buf, win->renderView.end);
+
+	sizet low = 0;
+	sizet high = buf->cursors.length;
+	while (low < high) {
+
+		sizet mid = (low + high) / 2;
+		if (buf->cursors[mid] < viewStart)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (sizet i = low; i < buf->cursors.length && buf->cursors[i] <= viewEnd; ++i) {
+
+		if (cursor_screen_pos(buf, win, buf->cursors[i], &cursorPos)) {
+
+			cursorPos.y += renderer_font_size() / 5;
+			render_quad(cursorPos, cursorSize, global_Colors[2]);
+		}
+	}
 }
 
 
@@ -583,9 +769,15 @@ renderer_end() {
 	count = (g_Renderer.vertexArrayIndex - g_Renderer.vertexArray);
 	dataSize = (g_Renderer.vertexArrayIndex - g_Renderer.vertexArray) * sizeof(Vertex);
 
-	glBufferSubData(GL_ARRAY_BUFFER, 0, dataSize, g_Renderer.vertexArray);
+	g_Stats.vertices += count;
+	g_Stats.bytesUploaded += dataSize;
+	g_Stats.drawCalls++;
+
+	if (!g_Headless) {
 
-	glDrawArrays(GL_TRIANGLES, 0, g_Renderer.vertexCount);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, dataSize, g_Renderer.vertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, g_Renderer.vertexCount);
+	}
 
 	g_Renderer.vertexCount = 0;
 	g_Renderer.vertexArrayIndex = g_Renderer.vertexArray;
@@ -596,11 +788,7 @@ void
 renderer_on_window_resize(f32 width, f32 height) {
   
 	mat_ortho(g_Renderer.projection, 0.0f, width, height, 0.0f);
-	// TODO: make resizing actually work
-	FocusedWindow->position.x = 0.0f;
-	FocusedWindow->position.y = 0.0f;
-	FocusedWindow->size.w = width;
-	FocusedWindow->size.h = height;
+	windows_resize(width, height);
 }
 
 GlyphData*
@@ -645,8 +833,7 @@ render_text_debug(char* text, Vec2 position, Vec4 color) {
 		};
 
 		if (g_Renderer.vertexCount >= MAX_VERTICES) {
-
-			renderer_end();
+			batch_flush();
 		}
 
 		for (int j = 0; j < VERTICES_PER_QUAD; ++j) {
@@ -661,27 +848,32 @@ render_text_debug(char* text, Vec2 position, Vec4 color) {
 		advanceX += g_Renderer.glyphs[text[i]].advanceX;
 	}
 }
+#endif
 
 static void
 render_windows(Node* parent) {
 	
 	for (sizet i = 0; i < parent->children.length; ++i) {
 		
-		if (parent->children[i].nodeType == NODE_WINDOW) {
+		if (parent->children[i]->nodeType == NODE_WINDOW) {
 
-			Window* window = &parent->children[i];
-			render_buffer(buffer_get(window->key), window, Tokens);
-			render_status_line(buffer_get(window->key)->name, window);
+			Window* window = parent->children[i];
+			render_buffer(window->buffer, window);
+			render_status_line(window->buffer->name, window);
 		}
 		else 
-			render_windows(&parent->children[i]);
+			render_windows(parent->children[i]);
 	}
 }
 
 void
 window_render_all() {
 
+	if (CurBuffer->large)
+		windows_shift_lines(CurBuffer, large_page(CurBuffer));
+
+	if (FocusedWindow->buffer == CurBuffer)
+		window_scroll_to_cursor(FocusedWindow, CurBuffer);
+
 	render_windows(WinTree);
 }
-
-#endif
@@ -67,11 +67,25 @@ typedef struct Renderer {
 
 } Renderer;
 
+// counters for everything pushed through the batch since the last reset
+typedef struct RenderStats {
+
+	u32 vertices;
+	u32 drawCalls;
+	// renderer_end calls forced by a full batch of MAX_VERTICES
+	u32 flushes;
+	sizet bytesUploaded;
+
+} RenderStats;
+
 
 
 GLFWwindow* renderer_create_window();
 void renderer_initialize(f32 width, f32 height);
 void renderer_load_font(const char* fontFile, i32 fontSize);
+void renderer_initialize_headless(f32 width, f32 height, i32 fontSize);
+RenderStats renderer_stats();
+void renderer_stats_reset();
 
 void renderer_begin();
 void renderer_end();
@@ -79,7 +93,7 @@ void renderer_end();
 void render_quad(Vec2 position, Vec2 size, Vec4 color);
 void render_textured_quad(Vec2 position, Vec2 size, Vec4 color, u32 texID);
 void render_text(String& text, Vec2 position, Vec4 color);
-void render_buffer(Buffer* buf, Window* window, Array<Token>* tokens);
+void render_buffer(Buffer* buf, Window* window);
 void render_status_line(String& bufferName, Window* window);
 void render_cursor(Buffer* buf, Window* window, CursorStyle style);
 void renderer_on_window_resize(f32 width, f32 height);
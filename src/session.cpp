@@ -0,0 +1,374 @@
+#include "session.h"
+#include "buffer.h"
+#include "window.h"
+#include "fileio.h"
+#include "globals.h"
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SESSION_MAGIC 0x31535a43
+#define SESSION_DEPTH_MAX 64
+
+/* the session is one binary file: the buffers with a file, then the window
+   tree in preorder. a buffer is opened without reading its file and keeps
+   the cursor, folds and line count it had, so restoring costs one read of
+   the session plus the files on screen. the modification time and size
+   saved with a buffer are checked when its text is loaded, folds made on a
+   file that changed since are dropped then.
+ */
+
+typedef struct SessionReader {
+
+	u8* at;
+	u8* end;
+	b8 ok;
+
+} SessionReader;
+
+
+static void
+put(FILE* fp, const void* data, sizet size) {
+
+	fwrite(data, 1, size, fp);
+}
+
+static b8
+take(SessionReader* in, void* out, sizet size) {
+
+	if (!in->ok || (sizet)(in->end - in->at) < size) {
+		in->ok = false;
+		return false;
+	}
+
+	memcpy(out, in->at, size);
+	in->at += size;
+
+	return true;
+}
+
+static i32
+buffer_index(Array<Buffer*>* buffers, Buffer* buf) {
+
+	for (sizet i = 0; i < buffers->length; ++i)
+		if (buffers->data[i] == buf)
+			return (i32)i;
+
+	return -1;
+}
+
+static void
+node_write(FILE* fp, Node* node, Array<Buffer*>* buffers) {
+
+	u8 type = (u8)node->nodeType;
+	put(fp, &type, sizeof(type));
+	put(fp, &node->weight, sizeof(node->weight));
+
+	if (node->nodeType == NODE_CONTAINER) {
+
+		u8 vertical = node->isVertical;
+		u32 count = (u32)node->children.length;
+		put(fp, &vertical, sizeof(vertical));
+		put(fp, &count, sizeof(count));
+
+		for (sizet i = 0; i < node->children.length; ++i)
+			node_write(fp, node->children[i], buffers);
+		return;
+	}
+
+	// the active view has the live cursor, the others their own
+	Buffer* buf = node->buffer;
+	i32 index = buffer_index(buffers, buf);
+	u64 cursor = node->view == buf->activeView ? buf->cursor : buf->views[node->view].cursor;
+	u8 wrap = node->softWrap;
+
+	put(fp, &index, sizeof(index));
+	put(fp, &cursor, sizeof(cursor));
+	put(fp, &node->renderView.start, sizeof(i32));
+	put(fp, &node->columnStart, sizeof(i32));
+	put(fp, &wrap, sizeof(wrap));
+}
+
+// checks the tree when buffers is null, builds it under parent otherwise,
+// windows on a buffer that is gone show the first one
+static b8
+node_read(SessionReader* in, Node* parent, Node** out, Array<Buffer*>* buffers,
+		  i32 depth, u32 focused, u32* windows, Window** focus) {
+
+	u8 type;
+	f32 weight;
+	if (!take(in, &type, sizeof(type)) || !take(in, &weight, sizeof(weight)))
+		return false;
+
+	if (type == NODE_CONTAINER) {
+
+		u8 vertical;
+		u32 count;
+		if (!take(in, &vertical, sizeof(vertical)) || !take(in, &count, sizeof(count)))
+			return false;
+		if (!count || depth >= SESSION_DEPTH_MAX)
+			return false;
+
+		Node* node = NULL;
+		if (buffers) {
+			node = window_node_add(parent, NODE_CONTAINER);
+			node->isVertical = vertical;
+			node->weight = weight;
+			*out = node;
+		}
+
+		for (u32 i = 0; i < count; ++i) {
+			Node* child;
+			if (!node_read(in, node, &child, buffers, depth + 1, focused, windows, focus))
+				return false;
+		}
+		return true;
+	}
+
+	if (type != NODE_WINDOW)
+		return false;
+
+	i32 index;
+	u64 cursor;
+	i32 lineStart, columnStart;
+	u8 wrap;
+	take(in, &index, sizeof(index));
+	take(in, &cursor, sizeof(cursor));
+	take(in, &lineStart, sizeof(lineStart));
+	take(in, &columnStart, sizeof(columnStart));
+	if (!take(in, &wrap, sizeof(wrap)))
+		return false;
+
+	if (!buffers) {
+		(*windows)++;
+		return true;
+	}
+
+	Buffer* buf = index >= 0 && (sizet)index < buffers->length ?
+		buffers->data[index] : buffers->data[0];
+
+	Window* win = window_node_add(parent, NODE_WINDOW);
+	win->weight = weight;
+	win->buffer = buf;
+	win->view = buffer_view_open(buf);
+
+	sizet length = buffer_length(buf);
+	buf->views[win->view].cursor = cursor < length ? cursor : length;
+
+	i32 lines = (i32)buf->lineLengths.length;
+	win->renderView.start = lineStart < 0 ? 0 : lineStart < lines ? lineStart : lines - 1;
+	win->columnStart = columnStart < 0 ? 0 : columnStart;
+	win->softWrap = wrap;
+
+	if (*windows == focused || !*focus)
+		*focus = win;
+	(*windows)++;
+
+	*out = win;
+	return true;
+}
+
+
+void
+session_save(const char* path) {
+
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		WARN_MSG("Failed to save the session: %s \n", path);
+		return;
+	}
+
+	Array<Buffer*> all;
+	buffers_get_all(&all);
+
+	Array<Buffer*> buffers;
+	array_init(&buffers, all.length + 1);
+	for (sizet i = 0; i < all.length; ++i)
+		if (all[i]->path.length)
+			array_push(&buffers, all[i]);
+
+	u32 magic = SESSION_MAGIC;
+	u32 count = (u32)buffers.length;
+	put(fp, &magic, sizeof(magic));
+	put(fp, &count, sizeof(count));
+
+	for (sizet i = 0; i < buffers.length; ++i) {
+
+		Buffer* buf = buffers[i];
+
+		u32 pathLength = (u32)buf->path.length;
+		u64 fileSize = buf->fileSize;
+		u64 cursor = buf->cursor;
+		i32 lineCount = buf->state == BUFFER_UNLOADED ?
+			buf->lineCount : (i32)buf->lineLengths.length;
+		u32 foldCount = (u32)buf->folds.length;
+
+		put(fp, &pathLength, sizeof(pathLength));
+		put(fp, buf->path.data, pathLength);
+		put(fp, &buf->fileTime, sizeof(buf->fileTime));
+		put(fp, &fileSize, sizeof(fileSize));
+		put(fp, &cursor, sizeof(cursor));
+		put(fp, &lineCount, sizeof(lineCount));
+		put(fp, &foldCount, sizeof(foldCount));
+		put(fp, buf->folds.data, foldCount * sizeof(FoldRange));
+	}
+
+	Array<Window*> windows;
+	windows_get_all(&windows);
+
+	u32 focused = 0;
+	for (sizet i = 0; i < windows.length; ++i)
+		if (windows[i] == FocusedWindow)
+			focused = (u32)i;
+
+	put(fp, &focused, sizeof(focused));
+	node_write(fp, WinTree, &buffers);
+
+	fclose(fp);
+
+	array_free(&all);
+	array_free(&buffers);
+	array_free(&windows);
+}
+
+// opens the buffers and windows of the session, false when there is none
+// or nothing in it can be shown, the editor starts as it would without
+b8
+session_restore(const char* path) {
+
+	FILE* fp = fopen(path, "rb");
+	if (!fp) return false;
+
+	fseek(fp, 0, SEEK_END);
+	sizet size = ftell(fp);
+	rewind(fp);
+
+	u8* data = (u8*)malloc(size + 1);
+	sizet read = fread(data, 1, size, fp);
+	fclose(fp);
+
+	SessionReader in = {data, data + read, true};
+
+	u32 magic = 0, count = 0;
+	take(&in, &magic, sizeof(magic));
+	take(&in, &count, sizeof(count));
+
+	Array<Buffer*> buffers;
+	array_init(&buffers, count + 1);
+
+	for (u32 b = 0; in.ok && magic == SESSION_MAGIC && b < count; ++b) {
+
+		u32 pathLength = 0;
+		u64 fileTime, fileSize, cursor;
+		i32 lineCount;
+		u32 foldCount = 0;
+
+		take(&in, &pathLength, sizeof(pathLength));
+		if (!in.ok || (sizet)(in.end - in.at) < pathLength) break;
+
+		String bufPath = str_create(pathLength + 1);
+		for (u32 i = 0; i < pathLength; ++i)
+			str_push(&bufPath, (char)in.at[i]);
+		in.at += pathLength;
+
+		take(&in, &fileTime, sizeof(fileTime));
+		take(&in, &fileSize, sizeof(fileSize));
+		take(&in, &cursor, sizeof(cursor));
+		take(&in, &lineCount, sizeof(lineCount));
+		take(&in, &foldCount, sizeof(foldCount));
+
+		FoldRange* folds = (FoldRange*)in.at;
+		if (!in.ok || (sizet)(in.end - in.at) / sizeof(FoldRange) < foldCount) {
+			in.ok = false;
+			str_free(&bufPath);
+			break;
+		}
+		in.at += foldCount * sizeof(FoldRange);
+
+		// kept in the list so window indices still match, shown as the
+		// first buffer left
+		if (!file_exists(bufPath.as_cstr())) {
+			array_push(&buffers, (Buffer*)NULL);
+			str_free(&bufPath);
+			continue;
+		}
+
+		Buffer* buf = buffer_open(bufPath.as_cstr());
+		str_free(&bufPath);
+
+		array_push(&buffers, buf);
+		if (buf->state != BUFFER_UNLOADED)
+			continue;
+
+		buf->fileTime = fileTime;
+		buf->fileSize = (sizet)fileSize;
+		buf->cursor = (sizet)cursor;
+		buf->lineCount = lineCount;
+
+		// sorted and disjoint or none at all
+		for (u32 f = 0; f < foldCount; ++f) {
+
+			FoldRange fold;
+			memcpy(&fold, folds + f, sizeof(FoldRange));
+
+			if (fold.header < 0 || fold.end <= fold.header ||
+				(f && fold.header <= buf->folds[f - 1].end)) {
+				array_reset(&buf->folds);
+				break;
+			}
+			array_push(&buf->folds, fold);
+		}
+		buf->foldIndexDirty = true;
+	}
+
+	Array<Buffer*> shown;
+	array_init(&shown, buffers.length + 1);
+	for (sizet i = 0; i < buffers.length; ++i)
+		if (buffers[i])
+			array_push(&shown, buffers[i]);
+
+	u32 focused = 0;
+	take(&in, &focused, sizeof(focused));
+
+	// the tree is checked in full before a node of it is made
+	SessionReader tree = in;
+	u32 windows = 0;
+	Window* focus = NULL;
+	Node* root = NULL;
+
+	b8 restored = in.ok && magic == SESSION_MAGIC && buffers.length == count && shown.length &&
+		node_read(&tree, NULL, &root, NULL, 0, focused, &windows, &focus);
+
+	if (restored) {
+
+		// windows on a buffer that is gone fall back to the first one left
+		for (sizet i = 0; i < buffers.length; ++i)
+			if (!buffers[i])
+				buffers[i] = shown[0];
+
+		windows = 0;
+		node_read(&in, NULL, &root, &buffers, 0, focused, &windows, &focus);
+
+		if (root->nodeType == NODE_WINDOW) {
+			Node* container = window_node_add(NULL, NODE_CONTAINER);
+			root->parent = container;
+			root->weight = 1.0f;
+			array_push(&container->children, root);
+			root = container;
+		}
+
+		windows_init_tree(root, focus);
+		NORMAL_MSG("Restored session: %s \n", path);
+	}
+	else {
+		WARN_MSG("Session %s could not be restored \n", path);
+	}
+
+	free(data);
+	array_free(&buffers);
+	array_free(&shown);
+
+	return restored;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include "types.h"
+
+void session_save(const char* path);
+b8 session_restore(const char* path);
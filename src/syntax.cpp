@@ -0,0 +1,457 @@
+#include "syntax.h"
+#include "buffer.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LINUX_PLATFORM
+#include <pthread.h>
+#elif WINDOWS_PLATFORM
+#include <windows.h>
+#endif
+
+#define SYNTAX_LINE_MIN 256
+
+/* one worker thread lexes snapshots of the buffer text. a snapshot is
+   taken when the buffer version moved and no job of that buffer is in
+   flight, so a burst of typing costs one copy per finished lex instead
+   of one per key. the main thread renders with the newest finished
+   token set, lines it can not find in it through the buffer's edit log
+   are lexed on their own until the next set arrives.
+ */
+
+struct SyntaxState {
+
+	// main thread only
+	TokenStream tokens;
+	u32 tokensVersion;
+	b8 ready;
+	BracketIndex brackets;
+
+	// guarded by Lock
+	char* jobText;
+	sizet jobLength;
+	sizet jobLines;
+	u32 jobVersion;
+	Language* jobLanguage;
+	b8 pending;
+	b8 busy;
+
+	TokenStream done;
+	Array<BracketSpan> doneBrackets;
+	u32 doneVersion;
+	b8 hasDone;
+};
+
+#ifdef LINUX_PLATFORM
+static pthread_t Worker;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t WorkAvailable = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t WorkDone = PTHREAD_COND_INITIALIZER;
+#elif WINDOWS_PLATFORM
+static HANDLE Worker;
+static SRWLOCK Lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE WorkAvailable = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE WorkDone = CONDITION_VARIABLE_INIT;
+#endif
+
+static Array<SyntaxState*> States;
+static SyntaxWake Wake;
+static b8 Running;
+static b8 Quit;
+
+// touched lines are lexed into this one, valid until the next call
+static TokenStream LineTokens;
+static char* LineText;
+static sizet LineCapacity;
+
+
+static void
+lock() {
+#ifdef LINUX_PLATFORM
+	pthread_mutex_lock(&Lock);
+#elif WINDOWS_PLATFORM
+	AcquireSRWLockExclusive(&Lock);
+#endif
+}
+
+static void
+unlock() {
+#ifdef LINUX_PLATFORM
+	pthread_mutex_unlock(&Lock);
+#elif WINDOWS_PLATFORM
+	ReleaseSRWLockExclusive(&Lock);
+#endif
+}
+
+static void
+condition_wait(b8 forWork) {
+#ifdef LINUX_PLATFORM
+	pthread_cond_wait(forWork ? &WorkAvailable : &WorkDone, &Lock);
+#elif WINDOWS_PLATFORM
+	SleepConditionVariableSRW(forWork ? &WorkAvailable : &WorkDone, &Lock, INFINITE, 0);
+#endif
+}
+
+static void
+condition_signal(b8 forWork) {
+#ifdef LINUX_PLATFORM
+	pthread_cond_broadcast(forWork ? &WorkAvailable : &WorkDone);
+#elif WINDOWS_PLATFORM
+	WakeAllConditionVariable(forWork ? &WorkAvailable : &WorkDone);
+#endif
+}
+
+static SyntaxState*
+next_job() {
+
+	for (sizet i = 0; i < States.length; ++i)
+		if (States[i]->pending)
+			return States[i];
+
+	return NULL;
+}
+
+static void
+worker_run() {
+
+	lock();
+
+	while (!Quit) {
+
+		SyntaxState* state = next_job();
+		if (!state) {
+			condition_wait(true);
+			continue;
+		}
+
+		char* text = state->jobText;
+		sizet length = state->jobLength;
+		sizet lines = state->jobLines;
+		u32 version = state->jobVersion;
+		Language* lang = state->jobLanguage;
+
+		state->jobText = NULL;
+		state->pending = false;
+		state->busy = true;
+
+		unlock();
+
+		String view;
+		view.data = text;
+		view.length = length;
+
+		TokenStream tokens = tokens_make(view, lang);
+		Array<BracketSpan> brackets = brackets_lines(&tokens, lines);
+		free(text);
+
+		lock();
+
+		if (state->hasDone) {
+			tokens_free(&state->done);
+			array_free(&state->doneBrackets);
+		}
+
+		state->done = tokens;
+		state->doneBrackets = brackets;
+		state->doneVersion = version;
+		state->hasDone = true;
+		state->busy = false;
+
+		condition_signal(false);
+
+		if (Wake) {
+			unlock();
+			Wake();
+			lock();
+		}
+	}
+
+	unlock();
+}
+
+#ifdef LINUX_PLATFORM
+static void*
+worker_main(void*) {
+
+	worker_run();
+	return NULL;
+}
+#elif WINDOWS_PLATFORM
+static DWORD WINAPI
+worker_main(LPVOID) {
+
+	worker_run();
+	return 0;
+}
+#endif
+
+static SyntaxState*
+state_get(Buffer* buf) {
+
+	if (buf->syntax)
+		return buf->syntax;
+
+	SyntaxState* state = (SyntaxState*)calloc(1, sizeof(SyntaxState));
+	buf->syntax = state;
+
+	if (Running) {
+		lock();
+		array_push(&States, state);
+		unlock();
+	}
+
+	return state;
+}
+
+static void
+snapshot_post(Buffer* buf, SyntaxState* state) {
+
+	sizet length = buffer_length(buf);
+	char* text = (char*)malloc(length + 1);
+
+	memcpy(text, buf->text, buf->preLen);
+	memcpy(text + buf->preLen, buf->text + buf->preLen + buf->gapLen, buf->postLen);
+
+	lock();
+
+	state->jobText = text;
+	state->jobLength = length;
+	state->jobLines = buf->lineLengths.length;
+	state->jobVersion = buf->version;
+	state->jobLanguage = buf->language;
+	state->pending = true;
+
+	condition_signal(true);
+	unlock();
+}
+
+static void
+tokens_take(Buffer* buf, SyntaxState* state, TokenStream tokens,
+			Array<BracketSpan> brackets, u32 version) {
+
+	if (state->ready)
+		tokens_free(&state->tokens);
+
+	state->tokens = tokens;
+	state->tokensVersion = version;
+	state->ready = true;
+
+	brackets_reset(&state->brackets, brackets, version);
+	buffer_edits_trim(buf, version);
+}
+
+
+void
+syntax_init(SyntaxWake wake) {
+
+	lexer_init();
+	array_init(&States, 8);
+
+	Wake = wake;
+	Quit = false;
+
+#ifdef LINUX_PLATFORM
+	Running = pthread_create(&Worker, NULL, worker_main, NULL) == 0;
+#elif WINDOWS_PLATFORM
+	Worker = CreateThread(NULL, 0, worker_main, NULL, 0, NULL);
+	Running = Worker != NULL;
+#endif
+
+	if (!Running) {
+		WARN_MSG("failed to start the tokenizer thread, %s \n", "lexing on the main thread");
+	}
+}
+
+void
+syntax_shutdown() {
+
+	if (!Running) return;
+
+	lock();
+	Quit = true;
+	condition_signal(true);
+	unlock();
+
+#ifdef LINUX_PLATFORM
+	pthread_join(Worker, NULL);
+#elif WINDOWS_PLATFORM
+	WaitForSingleObject(Worker, INFINITE);
+	CloseHandle(Worker);
+#endif
+
+	Running = false;
+}
+
+// called once per frame for every buffer on screen, takes the finished
+// token set and hands the worker a new snapshot when the text moved on
+void
+syntax_update(Buffer* buf) {
+
+	SyntaxState* state = state_get(buf);
+
+	if (!Running) {
+
+		// no worker, lexed in place like before
+		if (!state->ready || state->tokensVersion != buf->version) {
+
+			String text = buffer_get_text_copy(buf);
+			TokenStream tokens = tokens_make(text, buf->language);
+			str_free(&text);
+
+			tokens_take(buf, state, tokens, brackets_lines(&tokens, buf->lineLengths.length),
+						buf->version);
+		}
+		return;
+	}
+
+	lock();
+
+	b8 taken = state->hasDone;
+	TokenStream done = state->done;
+	Array<BracketSpan> doneBrackets = state->doneBrackets;
+	u32 doneVersion = state->doneVersion;
+	state->hasDone = false;
+
+	b8 idle = !state->busy && !state->pending;
+
+	unlock();
+
+	if (taken)
+		tokens_take(buf, state, done, doneBrackets, doneVersion);
+
+	if (idle && (!state->ready || state->tokensVersion != buf->version))
+		snapshot_post(buf, state);
+}
+
+b8
+syntax_ready(Buffer* buf) {
+
+	return buf->syntax && buf->syntax->ready;
+}
+
+// maps a line of the current text to its line in the text the tokens were
+// made from, -1 when an edit since then touched it
+static i32
+line_in_tokens(Buffer* buf, SyntaxState* state, i32 line) {
+
+	for (sizet i = buf->edits.length; i-- > 0;) {
+
+		LineEdit* edit = &buf->edits[i];
+		if (edit->version <= state->tokensVersion)
+			break;
+
+		if (line < edit->line)
+			continue;
+
+		if (line < edit->line + edit->added)
+			return -1;
+
+		line += edit->removed - edit->added;
+	}
+
+	return line;
+}
+
+// tokens of one line of the current text, offsets from the line start
+Token*
+syntax_line(Buffer* buf, i32 line, sizet lineStart, u32* count) {
+
+	*count = 0;
+
+	SyntaxState* state = buf->syntax;
+	if (!state || !state->ready)
+		return NULL;
+
+	i32 mapped = line_in_tokens(buf, state, line);
+
+	if (mapped >= 0) {
+
+		if ((u32)mapped >= tokens_line_count(&state->tokens))
+			return NULL;
+
+		u32 first = state->tokens.lineFirst[mapped];
+		*count = state->tokens.lineFirst[mapped + 1] - first;
+
+		return state->tokens.tokens.data + first;
+	}
+
+	// edited since the last lex, the line is lexed alone so typing keeps
+	// its colors, state carried over from earlier lines is lost until the
+	// worker catches up
+	sizet length = buf->lineLengths[line];
+	if (lineStart + length > buffer_length(buf))
+		length = buffer_length(buf) - lineStart;
+
+	if (length + 1 > LineCapacity) {
+
+		LineCapacity = length + 1 > SYNTAX_LINE_MIN ? length + 1 : SYNTAX_LINE_MIN;
+		LineText = (char*)realloc(LineText, LineCapacity);
+	}
+
+	for (sizet i = 0; i < length; ++i)
+		LineText[i] = buffer_char_at(buf, lineStart + i);
+
+	if (!LineTokens.tokens.data) {
+		array_init(&LineTokens.tokens, SYNTAX_LINE_MIN);
+		array_init(&LineTokens.lineFirst, 2);
+	}
+
+	tokens_lex(&LineTokens, LineText, length, buf->language);
+
+	*count = LineTokens.lineFirst[1];
+	return LineTokens.tokens.data;
+}
+
+// bracket index of the buffer brought up to its current version, null
+// until the first token set arrives or after the edit log overflowed
+BracketIndex*
+syntax_brackets(Buffer* buf) {
+
+	SyntaxState* state = buf->syntax;
+	if (!state || !state->ready)
+		return NULL;
+
+	brackets_follow_edits(&state->brackets, buf);
+
+	return state->brackets.valid ? &state->brackets : NULL;
+}
+
+// waits for a job of the buffer in flight before its state goes away
+void
+syntax_release(Buffer* buf) {
+
+	SyntaxState* state = buf->syntax;
+	if (!state) return;
+
+	if (Running) {
+
+		lock();
+
+		while (state->busy)
+			condition_wait(false);
+
+		for (sizet i = 0; i < States.length; ++i) {
+			if (States[i] == state) {
+				array_erase(&States, i);
+				break;
+			}
+		}
+
+		unlock();
+	}
+
+	free(state->jobText);
+	if (state->hasDone) {
+		tokens_free(&state->done);
+		array_free(&state->doneBrackets);
+	}
+	if (state->ready)
+		tokens_free(&state->tokens);
+
+	brackets_free(&state->brackets);
+
+	free(state);
+	buf->syntax = NULL;
+}
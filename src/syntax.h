@@ -0,0 +1,21 @@
+#pragma once
+#include "types.h"
+#include "tokenizer.h"
+#include "brackets.h"
+
+struct Buffer;
+
+// highlighting state of one buffer, the worker lexes snapshots of the
+// text while the main thread keeps rendering with the newest finished
+// token set
+typedef struct SyntaxState SyntaxState;
+
+typedef void (*SyntaxWake)();
+
+void syntax_init(SyntaxWake wake);
+void syntax_shutdown();
+void syntax_update(Buffer* buf);
+Token* syntax_line(Buffer* buf, i32 line, sizet lineStart, u32* count);
+b8 syntax_ready(Buffer* buf);
+BracketIndex* syntax_brackets(Buffer* buf);
+void syntax_release(Buffer* buf);
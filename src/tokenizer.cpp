@@ -3,352 +3,383 @@
 #include "container.h"
 #include "debug.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#ifdef WINDOWS_PLATFORM
+#include <intrin.h>
+#endif
+
 #define INITIAL_TOKEN_CAPACITY 100
 
-#define NUM_KEYWORDS 14
-static const char* gKeywords[] = {"case", "if", "else", "while", "switch", "continue",
-	"break", "struct", "typedef", "return", "enum", "static",
-	"const", "constexpr"};
-
-
-#define NUM_TYPES 17
-static const char* gTypes[] = {"void", "i64", "i32", "i16", "i8", "u64",
-	"u32", "u16", "u8", "sizet", "f32", "int", "float", "char", 
-	"NULL", "double", "long"};
-
-inline static i8
-is_char_identifier(char c) {
-
-	switch (c) {
-    case 'a':
-    case 'b':
-    case 'c':
-    case 'd':
-    case 'e':
-    case 'f':
-    case 'g':
-    case 'h':
-    case 'i':
-    case 'j':
-    case 'k':
-    case 'l':
-    case 'm':
-    case 'n':
-    case 'o':
-    case 'p':
-    case 'q':
-    case 'r':
-    case 's':
-    case 't':
-    case 'u':
-    case 'v':
-    case 'w':
-    case 'x':
-    case 'y':
-    case 'z':
-    case 'A':
-    case 'B':
-    case 'C':
-    case 'D':
-    case 'E':
-    case 'F':
-    case 'G':
-    case 'H':
-    case 'I':
-    case 'J':
-    case 'K':
-    case 'L':
-    case 'M':
-    case 'N':
-    case 'O':
-    case 'P':
-    case 'Q':
-    case 'R':
-    case 'S':
-    case 'T':
-    case 'U':
-    case 'V':
-    case 'W':
-    case 'X':
-    case 'Y':
-    case 'Z':
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-    case '_':
-      return 1;
-    default:
-      return 0;
+static u8 SingleTokens[256];
+// identifier characters after the first one
+static u8 IdentTail[256];
+static b8 LexerReady;
+
+
+static inline u32
+count_trailing_zeros(u32 mask) {
+#ifdef LINUX_PLATFORM
+	return (u32)__builtin_ctz(mask);
+#elif WINDOWS_PLATFORM
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (u32)index;
+#endif
+}
 
-	}
+static inline TokenType
+keyword_lookup(KeywordTable* table, const char* word, sizet length) {
+
+	if (length > KEYWORD_MAX_LENGTH)
+		return TOK_IDENTIFIER;
+
+	KeywordEntry* entry = &table->entries[keyword_hash(word, length, table->seed) & table->mask];
+	if (entry->length == length && memcmp(entry->word, word, length) == 0)
+		return (TokenType)entry->type;
+
+	return TOK_IDENTIFIER;
 }
 
+void
+lexer_init() {
+
+	if (LexerReady)
+		return;
+
+	SingleTokens['('] = TOK_OPEN_PAREN;
+	SingleTokens[')'] = TOK_CLOSED_PAREN;
+	SingleTokens['{'] = TOK_OPEN_CURLY;
+	SingleTokens['}'] = TOK_CLOSED_CURLY;
+	SingleTokens['['] = TOK_OPEN_SQUARE;
+	SingleTokens[']'] = TOK_CLOSED_SQUARE;
+	SingleTokens['#'] = TOK_HASH;
+	SingleTokens[';'] = TOK_SEMICOLON;
+
+	for (i32 c = 'a'; c <= 'z'; ++c) IdentTail[c] = 1;
+	for (i32 c = 'A'; c <= 'Z'; ++c) IdentTail[c] = 1;
+	for (i32 c = '0'; c <= '9'; ++c) IdentTail[c] = 1;
+	IdentTail['_'] = 1;
+
+	languages_init();
+	LexerReady = true;
+}
 
-inline static i8
-is_keyword(const char* word) {
-	
-  
-	for (sizet i = 0; i < NUM_KEYWORDS; ++i) {
+// true when the marker starts at i
+static inline b8
+marker_at(const char* text, sizet i, sizet length, const char* marker) {
 
-		if (cstr_equal(word, gKeywords[i])) return 1;
-		
+	for (sizet k = 0; marker[k] != '\0'; ++k)
+		if (i + k >= length || text[i + k] != marker[k])
+			return false;
+
+	return marker[0] != '\0';
+}
+
+// end of the run of identifier characters starting at i, sixteen bytes
+// at a time
+static inline sizet
+ident_run_end(const char* text, sizet i, sizet length) {
+
+	const __m128i lowerA = _mm_set1_epi8('a' - 1);
+	const __m128i lowerZ = _mm_set1_epi8('z' + 1);
+	const __m128i upperA = _mm_set1_epi8('A' - 1);
+	const __m128i upperZ = _mm_set1_epi8('Z' + 1);
+	const __m128i digit0 = _mm_set1_epi8('0' - 1);
+	const __m128i digit9 = _mm_set1_epi8('9' + 1);
+	const __m128i underscore = _mm_set1_epi8('_');
+
+	while (i + 16 <= length) {
+
+		__m128i c = _mm_loadu_si128((const __m128i*)(text + i));
+
+		// signed compares, bytes above 127 are negative and never match
+		__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, lowerA), _mm_cmplt_epi8(c, lowerZ));
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, upperA), _mm_cmplt_epi8(c, upperZ));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, digit0), _mm_cmplt_epi8(c, digit9));
+		__m128i ident = _mm_or_si128(_mm_or_si128(lower, upper),
+									 _mm_or_si128(digit, _mm_cmpeq_epi8(c, underscore)));
+
+		u32 mask = ~(u32)_mm_movemask_epi8(ident) & 0xFFFF;
+		if (mask)
+			return i + count_trailing_zeros(mask);
+
+		i += 16;
 	}
-	return 0;
 
+	while (i < length && IdentTail[(u8)text[i]])
+		i++;
+
+	return i;
 }
 
-inline static i8
-is_type(const char* word) {
-	
-  
-	for (sizet i = 0; i < NUM_TYPES; ++i) {
+// end of the run of blanks starting at i, line breaks end the run
+static inline sizet
+space_run_end(const char* text, sizet i, sizet length) {
 
-		if (cstr_equal(word, gTypes[i])) return 1;
-		
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i carriage = _mm_set1_epi8('\r');
+
+	while (i + 16 <= length) {
+
+		__m128i c = _mm_loadu_si128((const __m128i*)(text + i));
+		__m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, space), _mm_cmpeq_epi8(c, tab)),
+									 _mm_cmpeq_epi8(c, carriage));
+
+		u32 mask = ~(u32)_mm_movemask_epi8(blank) & 0xFFFF;
+		if (mask)
+			return i + count_trailing_zeros(mask);
+
+		i += 16;
 	}
-	return 0;
 
+	while (i < length && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r'))
+		i++;
+
+	return i;
 }
 
-inline static i8
-is_number(char c) {
-	
-	switch(c) {
-		
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-      return 1;
-    default:
-      return 0;
-	  
+// token as found by the scanner, in absolute positions
+typedef struct TokenSpan {
+
+	TokenType type;
+	sizet length;
+	sizet pos;
+
+} TokenSpan;
+
+typedef struct TokenBuilder {
+
+	TokenStream* stream;
+	const char* text;
+	sizet lineStart;
+
+} TokenBuilder;
+
+static inline void
+line_push(TokenBuilder* b, sizet newline) {
+
+	b->lineStart = newline + 1;
+	array_push(&b->stream->lineFirst, (u32)b->stream->tokens.length);
+}
+
+// span on the current line, only split when longer than a u16
+static inline void
+token_push(TokenBuilder* b, TokenSpan span) {
+
+	Token token;
+	token.offset = (u32)(span.pos - b->lineStart);
+	token.type = (u8)span.type;
+	token.unused = 0;
+
+	while (span.length > 0xFFFF) {
+
+		token.length = 0xFFFF;
+		array_push(&b->stream->tokens, token);
+		token.offset += 0xFFFF;
+		span.length -= 0xFFFF;
 	}
+
+	token.length = (u16)span.length;
+	array_push(&b->stream->tokens, token);
 }
 
-inline static i8
-in_quote(char c) {
-	
-	return c != '"';
+// span that may cross line breaks, one token per line it touches
+static void
+token_push_lines(TokenBuilder* b, TokenSpan span) {
+
+	sizet pos = span.pos;
+	sizet end = span.pos + span.length;
+
+	for (;;) {
+
+		const char* newline = (const char*)memchr(b->text + pos, '\n', end - pos);
+		sizet pieceEnd = newline ? newline - b->text : end;
+
+		if (pieceEnd > pos)
+			token_push(b, {span.type, pieceEnd - pos, pos});
+
+		if (!newline)
+			break;
 
+		line_push(b, pieceEnd);
+		pos = pieceEnd + 1;
+	}
 }
 
-Array<Token> 
-tokens_make(String text) {
+// lexes into a stream made by tokens_make, whatever it held is dropped
+void
+tokens_lex(TokenStream* stream, const char* data, sizet length, Language* lang) {
+
+	lexer_init();
+
+	const u8* classes = lang->classes;
 
-	Array<Token> tokens;
-	array_init(&tokens, INITIAL_TOKEN_CAPACITY);
+	array_reset(&stream->tokens);
+	array_reset(&stream->lineFirst);
+	array_push(&stream->lineFirst, (u32)0);
+
+	TokenBuilder builder = {stream, data, 0};
+	// end of the last include directive, <file> is only a string after one
+	sizet includeEnd = 0;
 
 	sizet i = 0;
-	while (i < text.length) {
-		
-		switch(text.data[i]) {
-		default:
-			i++;
-			break;
-		case 'a':
-		case 'b':
-		case 'c':
-		case 'd':
-		case 'e':
-		case 'f':
-		case 'g':
-		case 'h':
-		case 'i':
-		case 'j':
-		case 'k':
-		case 'l':
-		case 'm':
-		case 'n':
-		case 'o':
-		case 'p':
-		case 'q':
-		case 'r':
-		case 's':
-		case 't':
-		case 'u':
-		case 'v':
-		case 'w':
-		case 'x':
-		case 'y':
-		case 'z':
-		case 'A':
-		case 'B':
-		case 'C':
-		case 'D':
-		case 'E':
-		case 'F':
-		case 'G':
-		case 'H':
-		case 'I':
-		case 'J':
-		case 'K':
-		case 'L':
-		case 'M':
-		case 'N':
-		case 'O':
-		case 'P':
-		case 'Q':
-		case 'R':
-		case 'S':
-		case 'T':
-		case 'U':
-		case 'V':
-		case 'W':
-		case 'X':
-		case 'Y':
-		case 'Z': {
-			Token token = {TOK_UNKNOWN, 0, i};
-			static char word[256];
-			while (is_char_identifier(text.data[i])) {
-
-				word[token.length] = text.data[i];
-				token.length++;
-				i++;
-			}
-			word[token.length] = '\0';
+	while (i < length) {
 
-			if (is_keyword(word)) {
-				
-				token.type = TOK_KEYWORD;
-			}
-			else if (is_type(word)) {
-				
-				token.type = TOK_TYPE;
-			}
-			else{
-				
-				token.type = TOK_IDENTIFIER;
-			}
+		u8 c = (u8)data[i];
 
-			array_push(&tokens, token);
+		switch (classes[c]) {
+		case CC_SKIP:
+			i++;
 			break;
-		}
 
-		case '0':
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9': {
-			Token token = {TOK_NUMBER, 0, i};
-			while (is_number(text.data[i])) {
-
-				token.length++;
-				i++;
-			}
-			array_push(&tokens, token);
+		case CC_SPACE:
+			// single blanks between words are the common case
+			i++;
+			if (i < length && classes[(u8)data[i]] == CC_SPACE)
+				i = space_run_end(data, i + 1, length);
 			break;
-		}
 
-		case '(': {
-			Token token = {TOK_OPEN_PAREN, 1, i};
+		case CC_NEWLINE:
+			line_push(&builder, i);
 			i++;
-			array_push(&tokens, token);
-			continue;
-		}
+			break;
 
-		case ')': {
-			Token token = {TOK_CLOSED_PAREN, 1, i};
-			i++;
-			array_push(&tokens, token);
-			continue;
-		}
+		case CC_IDENT: {
+			TokenSpan token = {TOK_IDENTIFIER, 0, i};
+			i = ident_run_end(data, i + 1, length);
+			token.length = i - token.pos;
+			token.type = keyword_lookup(&lang->keywords, data + token.pos, token.length);
+			token_push(&builder, token);
 
-		case '{': {
-			Token token = {TOK_OPEN_CURLY, 1, i};
-			i++;
-			array_push(&tokens, token);
-			continue;
+			if (token.length == 7 && memcmp(data + token.pos, "include", 7) == 0)
+				includeEnd = i;
+			break;
 		}
 
-		case '}': {
-			Token token = {TOK_CLOSED_CURLY, 1, i};
-			i++;
-			array_push(&tokens, token);
-			continue;
+		case CC_DIGIT: {
+			TokenSpan token = {TOK_NUMBER, 0, i};
+			while (i < length && classes[(u8)data[i]] == CC_DIGIT)
+				i++;
+			token.length = i - token.pos;
+			token_push(&builder, token);
+			break;
 		}
-		case '#': {
-			Token token = {TOK_HASH, 1, i};
+
+		case CC_SINGLE: {
+			TokenSpan token = {(TokenType)SingleTokens[c], 1, i};
 			i++;
-			array_push(&tokens, token);
-			continue;
+			token_push(&builder, token);
+			break;
 		}
-		case '"': {
-			Token token = {TOK_STRING, 0, i};
+
+		case CC_QUOTE: {
+			// ends at the closing quote or the end of the line, escaped
+			// quotes and line breaks are part of the string
+			TokenSpan token = {TOK_STRING, 0, i};
 			i++;
-			while (in_quote(text.data[i])) {
+			while (i < length && data[i] != (char)c && data[i] != '\n') {
+				if (data[i] == '\\' && i + 1 < length)
+					i++;
 				i++;
 			}
-			i++;
+			if (i < length && data[i] == (char)c)
+				i++;
 			token.length = i - token.pos;
-			array_push(&tokens, token);
-			continue;
+			token_push_lines(&builder, token);
+			break;
 		}
-		case '<': {
-			Token token = {TOK_STRING, 0, i};
-			i++;
-			while (text.data[i] != '>') {
+
+		case CC_ANGLE: {
+			if (!includeEnd || includeEnd < builder.lineStart ||
+				space_run_end(data, includeEnd, i) != i) {
 				i++;
+				break;
 			}
+
+			TokenSpan token = {TOK_STRING, 0, i};
 			i++;
+			while (i < length && data[i] != '>' && data[i] != '\n')
+				i++;
+			if (i < length && data[i] == '>')
+				i++;
 			token.length = i - token.pos;
-			array_push(&tokens, token);
-			continue;
-		}
-		case ';': {
-			Token token = {TOK_SEMICOLON, 1, i};
-			i++;
-			array_push(&tokens, token);
-			continue;
+			token_push(&builder, token);
+			break;
 		}
-		case '/': {
-			Token token = {TOK_COMMENT, 0, i};
-			if (text.data[i + 1] == '/') {
-				while (text.data[i] != '\n' && i < text.length) {
-					token.length++;
-					i++;
+
+		case CC_COMMENT: {
+			TokenSpan token = {TOK_COMMENT, 0, i};
+			if (marker_at(data, i, length, lang->lineComment)) {
+				const char* newline = (const char*)memchr(data + i, '\n', length - i);
+				i = newline ? newline - data : length;
+				token.length = i - token.pos;
+				token_push(&builder, token);
+			}
+			else if (marker_at(data, i, length, lang->blockOpen)) {
+				const char* close = lang->blockClose;
+				sizet closeLength = strlen(close);
+				sizet from = i + strlen(lang->blockOpen);
+				sizet end = length;
+				while (from + closeLength <= length) {
+					const char* first = (const char*)memchr(data + from, close[0], length - from - closeLength + 1);
+					if (!first)
+						break;
+					if (memcmp(first, close, closeLength) == 0) {
+						end = first - data + closeLength;
+						break;
+					}
+					from = first - data + 1;
 				}
+				i = end;
+				token.length = i - token.pos;
+				token_push_lines(&builder, token);
 			}
-			else if (text.data[i + 1] == '*') {
+			else if (SingleTokens[c]) {
+				token = {(TokenType)SingleTokens[c], 1, i};
 				i++;
-				while (i < text.length &&
-					   (text.data[i] != '*' && text.data[i + 1] != '/')) {
-					token.length++;
-					i++;
-				}
+				token_push(&builder, token);
 			}
 			else {
-			  token.length = 1;
-			  token.type = TOK_IDENTIFIER;
+				i++;
 			}
-			i++;
-			array_push(&tokens, token);
-			continue;
+			break;
 		}
 
 		}
 	}
 
-	return tokens;
+	array_push(&stream->lineFirst, (u32)stream->tokens.length);
+}
+
+TokenStream
+tokens_make(String text, Language* lang) {
+
+	// sized from the average density of source code so most files never
+	// grow the arrays
+	TokenStream stream;
+	array_init(&stream.tokens, text.length / 6 + INITIAL_TOKEN_CAPACITY);
+	array_init(&stream.lineFirst, text.length / 24 + INITIAL_TOKEN_CAPACITY);
+
+	tokens_lex(&stream, text.data, text.length, lang);
+
+	return stream;
+}
+
+void
+tokens_free(TokenStream* stream) {
+
+	array_free(&stream->tokens);
+	array_free(&stream->lineFirst);
+}
+
+u32
+tokens_line_count(TokenStream* stream) {
 
+	return stream->lineFirst.length ? stream->lineFirst.length - 1 : 0;
 }
 
 static void
@@ -375,11 +406,11 @@ print_token(TokenType type) {
 }
 
 void
-print_tokens(Array<Token> tokens) {
+print_tokens(TokenStream* stream) {
 
-	for (sizet i = 0; i < tokens.length; ++i) {
+	for (sizet i = 0; i < stream->tokens.length; ++i) {
 
-		print_token(tokens[i].type);
+		print_token((TokenType)stream->tokens[i].type);
 		
 	}
 	
@@ -2,6 +2,7 @@
 #include "my_string.h"
 #include "types.h"
 #include "container.h"
+#include "language.h"
 
 typedef enum TokenType {
 	
@@ -25,15 +26,30 @@ typedef enum TokenType {
 } TokenType;
 
 
+// 8 bytes, tokens crossing a line or longer than a u16 are split
 typedef struct Token {
 
-	TokenType type;
-	sizet length;
-	sizet pos;
+	// from the start of the token's line
+	u32 offset;
+	u16 length;
+	u8 type;
+	u8 unused;
 
 } Token;
 
+typedef struct TokenStream {
 
+	// tokens of every line in order, line by line
+	Array<Token> tokens;
+	// index of the first token of every line, plus one past the last
+	Array<u32> lineFirst;
 
-Array<Token> tokens_make(String args);
-void print_tokens(Token* tokens);
+} TokenStream;
+
+
+void lexer_init();
+TokenStream tokens_make(String text, Language* lang);
+void tokens_lex(TokenStream* stream, const char* data, sizet length, Language* lang);
+void tokens_free(TokenStream* stream);
+u32 tokens_line_count(TokenStream* stream);
+void print_tokens(TokenStream* stream);
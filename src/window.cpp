@@ -5,720 +5,683 @@
 #include "cursor.h"
 #include "globals.h"
 #include "renderer.h"
+#include "wrap.h"
+#include "fold.h"
+
+#include <string.h>
 
 #define MIN_WINDOW_WIDTH 256
 #define MIN_WINDOW_HEIGHT 256
-#define BIG_NUMBER 69696969
+#define WINDOW_POOL_BLOCK 64
 
+/* windows and the containers splitting them are taken from blocks that are
+   never moved or given back, a Node* stays valid until its node is closed.
+   a container lays out its children by their weights, so a split, a close
+   or a resize only lays out again the container it changed.
+ */
 
-static Window*
-find_window_at_point(Node* node, Vec2i point) {
-	
-	for (sizet i = 0; i < node->children.length; ++i) {
-		
-		if (node->children[i].nodeType == NODE_WINDOW) {
+static Array<Node*> FreeNodes;
 
-			if (is_point_in_rect_i(point,
-				 node->children[i].position,
-				 node->children[i].size)) {
+/* the sides of all windows cut the screen into a grid and every cell of it
+   is covered by one window, since windows tile the root. a point is found
+   with a binary search over the edges on each axis, a neighbour is the
+   window at the point just across a side. rebuilt on the first query
+   after a layout.
+ */
 
-				return &node->children[i];
-			}
-		}
-		else {
-			Window* out;
-			out = find_window_at_point(&node->children[i], point);
-			if (out)
-				return out;
-		}
-	}
+static Array<Window*> Panes;
+static Array<i32> EdgesX;
+static Array<i32> EdgesY;
+static Array<Window*> Cells;
+static b8 GridDirty = true;
 
-	return NULL;
-}
 
-Window
-window_create_empthy() {
-	Window window = {
-		new_window_id(),
-		{0, 0},
-		{0, 0},
-		{0, 0},
-		NULL,
-		NODE_WINDOW,
-		NULL
-	};
-	return window;
-}
+static Node*
+node_alloc(NodeType type) {
 
-void
-window_switch_up() {
+	if (!FreeNodes.data)
+		array_init(&FreeNodes, WINDOW_POOL_BLOCK);
 
-	Vec2i point;
-	point.x = FocusedWindow->position.x + 10.0f;
-	point.y = FocusedWindow->position.y - 10.0f;
+	if (!FreeNodes.length) {
 
-	Window* out = find_window_at_point(WinTree, point);
-	if (out != NULL)  {
-		FocusedWindow = out;
-		buffer_switch(FocusedWindow->key);
+		Node* block = (Node*)calloc(WINDOW_POOL_BLOCK, sizeof(Node));
+		for (sizet i = WINDOW_POOL_BLOCK; i-- > 0;)
+			array_push(&FreeNodes, block + i);
 	}
-}
 
-void
-window_switch_down() {
+	Node* node = array_pop(&FreeNodes);
+	memset(node, 0, sizeof(Node));
+	node->nodeType = type;
+	node->weight = 1.0f;
 
-	Vec2i point;
-	point.x = FocusedWindow->position.x + 10.0f;
-	point.y = FocusedWindow->position.y + FocusedWindow->size.h + 10.0f;
+	if (type == NODE_WINDOW)
+		node->id = new_window_id();
+	else
+		array_init(&node->children, 2);
 
-	Window* out = find_window_at_point(WinTree, point);
-	if (out != NULL)  {
-		FocusedWindow = out;
-		buffer_switch(FocusedWindow->key);
-	}
+	return node;
 }
 
-void
-window_switch_left() {
+static void
+node_free(Node* node) {
 
-	Vec2i point;
-	point.x = FocusedWindow->position.x - 10.0f;
-	point.y = FocusedWindow->position.y + 10.0f;
+	if (node->nodeType == NODE_CONTAINER)
+		array_free(&node->children);
 
-	Window* out = find_window_at_point(WinTree, point);
-	if (out != NULL)  {
-		FocusedWindow = out;
-		buffer_switch(FocusedWindow->key);
-	}
+	array_push(&FreeNodes, node);
 }
 
-void
-window_switch_right() {
+static sizet
+child_index(Node* parent, Node* child) {
 
-	Vec2i point;
-	point.x = FocusedWindow->position.x + FocusedWindow->size.w + 10.0f;
-	point.y = FocusedWindow->position.y + 10.0f;
+	for (sizet i = 0; i < parent->children.length; ++i)
+		if (parent->children[i] == child)
+			return i;
 
-	Window* out = find_window_at_point(WinTree, point);
-	if (out != NULL)  {
-		FocusedWindow = out;
-		buffer_switch(FocusedWindow->key);
-	}
+	ASSERT_MSG(false, "node is not a child of its parent");
+	return 0;
 }
 
+static Window*
+first_window(Node* node) {
 
-void
-windows_init(Buffer* buf) {
-  
-	WinTree = (Node*)malloc(sizeof(Node));
-	array_init(&WinTree->children, 1);
+	while (node->nodeType == NODE_CONTAINER)
+		node = node->children[0];
 
-	Window window = window_create_empthy();
-	window.size.w = TheWidth;
-	window.size.h = TheHeight;
-	window.parent = WinTree;
-	window.key = buf->path.as_cstr();
+	return node;
+}
 
-	array_push(&WinTree->children, window);
-	WinTree->isVertical = 0;
-	WinTree->nodeType = NODE_CONTAINER;
-	WinTree->containerSize.w = window.size.w;
-	WinTree->containerSize.h = window.size.h;
-	WinTree->parent = NULL;
+// rects of the children from the container's rect and their weights, and
+// of their children in turn
+static void
+layout_node(Node* node) {
 
-	FocusedWindow = &WinTree->children[0];
+	GridDirty = true;
 
+	if (node->nodeType == NODE_WINDOW) return;
 
-}
+	i32 start = node->isVertical ? node->position.x : node->position.y;
+	i32 total = node->isVertical ? node->size.w : node->size.h;
 
+	f32 share = 0.0f;
+	i32 from = 0;
 
-static void
-resize_windows_evenly_width(Node* parent, i32 xpos, i32 totalWidth, i32 winCount) {
-	
-	i32 remainder = totalWidth % winCount;
-	i32 width = totalWidth / winCount;
+	for (sizet i = 0; i < node->children.length; ++i) {
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+		Node* child = node->children[i];
+		share += child->weight;
 
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-			parent->children[i].position.x = xpos;
-			parent->children[i].size.w = width;
-			xpos += width;
-		}
-	}
+		// the last child takes whatever rounding left over
+		i32 to = i + 1 == node->children.length ? total : (i32)(total * share + 0.5f);
 
-	for (sizet i = parent->children.length - 1; i >= 0; --i) {
+		child->position = node->position;
+		child->size = node->size;
 
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-			parent->children[i].size.w += remainder;
-			break;
+		if (node->isVertical) {
+			child->position.x = start + from;
+			child->size.w = to - from;
+		}
+		else {
+			child->position.y = start + from;
+			child->size.h = to - from;
 		}
-	}
 
+		from = to;
+		layout_node(child);
+	}
 }
 
+// replaces the container at index of parent by its children, they split
+// its weight between them
 static void
-resize_windows_evenly_height(Node* parent, i32 ypos, i32 totalHeight, i32 winCount) {
-	
-	i32 remainder = totalHeight % winCount;
-	i32 height = totalHeight / winCount;
+node_lift(Node* parent, sizet index) {
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+	Node* container = parent->children[index];
+	array_erase(&parent->children, index);
 
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-			parent->children[i].position.y = ypos;
-			parent->children[i].size.h = height;
-			ypos += height;
-		}
-	}
+	for (sizet i = 0; i < container->children.length; ++i) {
 
-	for (sizet i = parent->children.length - 1; i >= 0; --i) {
-
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-			parent->children[i].size.h += remainder;
-			break;
-		}
+		Node* child = container->children[i];
+		child->weight *= container->weight;
+		child->parent = parent;
+		array_insert(&parent->children, child, index + i);
 	}
+
+	node_free(container);
 }
 
 static void
-resize_windows_recursively_width(Node* parent, i32 startX, i32 width) {
-	
-	for (sizet i = 0; i < parent->children.length; ++i) {
-
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-
-			if (!parent->isVertical) {
-				
-				parent->children[i].position.x = startX;
-				parent->children[i].size.w += width;
-			}
-			else {
-				
-				parent->children[i].position.x = startX;
-				parent->children[i].size.w += width;
-				startX += parent->children[i].size.w;
-			}
-		}
+tree_get_windows(Node* node, Array<Window*>* windows) {
+
+	for (sizet i = 0; i < node->children.length; ++i) {
+		
+		if (node->children[i]->nodeType == NODE_WINDOW) 
+			array_push(windows, node->children[i]);
+		else 
+			tree_get_windows(node->children[i], windows);
 	}
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+}
 
-		if (parent->children[i].nodeType == NODE_CONTAINER) {
+// last edge at or before value, -1 before the first one
+static i32
+edge_index(Array<i32>* edges, i32 value) {
 
-			if (!parent->isVertical)
-				resize_windows_recursively_width(&parent->children[i], startX, width / 2);
-			else 
-				resize_windows_recursively_width(&parent->children[i], startX, width);
-		}
+	sizet low = 0;
+	sizet high = edges->length;
+	while (low < high) {
+
+		sizet mid = (low + high) / 2;
+		if (edges->data[mid] <= value)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
+	return (i32)low - 1;
 }
 
 static void
-resize_windows_recursively_height(Node* parent, i32 startY, i32 height) {
-	
-	for (sizet i = 0; i < parent->children.length; ++i) {
-
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-
-			if (!parent->isVertical) {
-				
-				parent->children[i].position.y = startY;
-				parent->children[i].size.h += height;
-				startY += parent->children[i].size.h;
-			}
-			else {
-				
-				parent->children[i].position.y = startY;
-				parent->children[i].size.h += height;
-			}
-		}
+edge_add(Array<i32>* edges, i32 edge) {
+
+	i32 at = edge_index(edges, edge);
+	if (at >= 0 && edges->data[at] == edge)
+		return;
+
+	array_insert(edges, edge, (sizet)(at + 1));
+}
+
+static void
+grid_build() {
+
+	if (!Panes.data) {
+		array_init(&Panes, 8);
+		array_init(&EdgesX, 16);
+		array_init(&EdgesY, 16);
+		array_init(&Cells, 64);
 	}
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+	array_reset(&Panes);
+	array_reset(&EdgesX);
+	array_reset(&EdgesY);
+	tree_get_windows(WinTree, &Panes);
 
-		if (parent->children[i].nodeType == NODE_CONTAINER) {
+	for (sizet i = 0; i < Panes.length; ++i) {
 
-			if (!parent->isVertical)
-				resize_windows_recursively_height(&parent->children[i], startY, height);
-			else 
-				resize_windows_recursively_height(&parent->children[i], startY, height / 2);
-		}
+		Window* win = Panes[i];
+		edge_add(&EdgesX, win->position.x);
+		edge_add(&EdgesX, win->position.x + win->size.w);
+		edge_add(&EdgesY, win->position.y);
+		edge_add(&EdgesY, win->position.y + win->size.h);
 	}
 
-}
+	sizet columns = EdgesX.length - 1;
+	sizet cells = columns * (EdgesY.length - 1);
 
+	while (Cells.capacity < cells)
+		array_expand(&Cells);
+	Cells.length = cells;
 
-static Window*
-find_first_window_recursively(Node* node) {
+	for (sizet i = 0; i < Panes.length; ++i) {
 
-	for (sizet i = 0; i < node->children.length; ++i) {
+		Window* win = Panes[i];
+		i32 left = edge_index(&EdgesX, win->position.x);
+		i32 right = edge_index(&EdgesX, win->position.x + win->size.w);
+		i32 top = edge_index(&EdgesY, win->position.y);
+		i32 bottom = edge_index(&EdgesY, win->position.y + win->size.h);
 
-		if (node->children[i].nodeType == NODE_WINDOW) {
-			return &node->children[i];
-		}
+		for (i32 row = top; row < bottom; ++row)
+			for (i32 column = left; column < right; ++column)
+				Cells.data[row * columns + column] = win;
 	}
 
-	for (sizet i = 0; i < node->children.length; ++i) {
+	GridDirty = false;
+}
 
-		if (node->children[i].nodeType == NODE_CONTAINER) {
-			Window* out = find_first_window_recursively(&node->children[i]);
-			return out;
-		}
-	}
+// window under point, null outside of all of them
+Window*
+window_at_point(Vec2i point) {
+
+	if (GridDirty)
+		grid_build();
 
-	// ASSERT_MSG(NULL, "now window found");
-	return NULL;
+	i32 column = edge_index(&EdgesX, point.x);
+	i32 row = edge_index(&EdgesY, point.y);
+
+	if (column < 0 || column + 1 >= (i32)EdgesX.length ||
+		row < 0 || row + 1 >= (i32)EdgesY.length)
+		return NULL;
+
+	return Cells.data[row * (EdgesX.length - 1) + column];
 }
 
-static Window*
-find_first_window(Node* parent) {
+// the window just across a side of win, at the cursor's row or column
+// when win is focused so uneven splits lead where the cursor points
+Window*
+window_neighbour(Window* win, WinDirection direction) {
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+	Vec2i point = win->position;
 
-		if (parent->children[i].nodeType == NODE_WINDOW)
-			return &parent->children[i];
+	if (win == FocusedWindow && win->buffer == CurBuffer) {
+
+		Vec2 cursor = cursor_render_pos(CurBuffer, win);
+		point.x = (i32)cursor.x;
+		point.y = (i32)cursor.y;
+
+		if (point.x < win->position.x) point.x = win->position.x;
+		if (point.x >= win->position.x + win->size.w) point.x = win->position.x + win->size.w - 1;
+		if (point.y < win->position.y) point.y = win->position.y;
+		if (point.y >= win->position.y + win->size.h) point.y = win->position.y + win->size.h - 1;
+	}
+
+	switch (direction) {
+	case WIN_UP:
+		point.y = win->position.y - 1;
+		break;
+	case WIN_DOWN:
+		point.y = win->position.y + win->size.h;
+		break;
+	case WIN_LEFT:
+		point.x = win->position.x - 1;
+		break;
+	case WIN_RIGHT:
+		point.x = win->position.x + win->size.w;
+		break;
+	default:
+		return NULL;
 	}
-	return NULL;
+
+	return window_at_point(point);
 }
 
-static inline Window*
-find_window(Node* parent, i32 id) {
-	
-	for (sizet i = 0; i < parent->children.length; ++i) {
+void
+window_focus(Window* win) {
 
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-			if (parent->children[i].id == id) {
-				return &parent->children[i];
-			}
-		}
-		else {
-			find_window(&parent->children[i], id);
-		}
-	}
-	return NULL;
+	if (!win) return;
+
+	FocusedWindow = win;
+	// the command line keeps the keys, leaving it goes to the new focus
+	if (InputMod == MODE_COMMAND)
+		PrevBuffer = win->buffer;
+	else
+		CurBuffer = win->buffer;
+	buffer_view_activate(win->buffer, win->view);
 }
 
+// shows buf in win with a view of its own, starting at the buffer's live
+// cursor
 void
-window_close() {
+window_set_buffer(Window* win, Buffer* buf) {
 
-	// check if there is container or window at parent
-	if (FocusedWindow->parent->children.length == 1) return;
+	buffer_view_close(win->buffer, win->view);
 
+	win->buffer = buf;
+	win->view = buffer_view_open(buf);
+	buffer_view_activate(buf, win->view);
 
-	if (FocusedWindow->parent->children.length == 2) {
-		Node* parent = FocusedWindow->parent;
-		Window focusWinData = *FocusedWindow;
+	win->renderView.start = 0;
+	win->columnStart = 0;
+	win->rowStart = 0;
+}
 
-		// get the other child
-		Node* node;
-		if (parent->children[0].id == FocusedWindow->id)
-		  node = &parent->children[1];
-		else
-		  node = &parent->children[0];
+void
+window_switch_up() {
 
-		if (node->nodeType == NODE_CONTAINER) {
+	window_focus(window_neighbour(FocusedWindow, WIN_UP));
+}
 
-			Node* childWindow = find_first_window_recursively(node);
+void
+window_switch_down() {
 
-			if (parent->isVertical) {
-				
-				i32 xpos;
+	window_focus(window_neighbour(FocusedWindow, WIN_DOWN));
+}
 
-				if (parent->children[0].id == FocusedWindow->id)
-					array_erase(&parent->children, 0);
-				else
-					array_erase(&parent->children, 1);
+void
+window_switch_left() {
 
-				node = &parent->children[0];
+	window_focus(window_neighbour(FocusedWindow, WIN_LEFT));
+}
 
-				// if child window is to the right
-				if (childWindow->position.x > focusWinData.position.x)
-					xpos = focusWinData.position.x;
-				else
-					xpos = childWindow->position.x;
+void
+window_switch_right() {
 
-				resize_windows_recursively_width(node, xpos, focusWinData.size.w);
+	window_focus(window_neighbour(FocusedWindow, WIN_RIGHT));
+}
 
 
-			} else {
-				
-				i32 ypos;
+void
+windows_init(Buffer* buf) {
+  
+	WinTree = node_alloc(NODE_CONTAINER);
+	WinTree->isVertical = 0;
+	WinTree->size.w = TheWidth;
+	WinTree->size.h = TheHeight;
 
-				if (parent->children[0].id == FocusedWindow->id)
-					array_erase(&parent->children, 0);
-				else
-					array_erase(&parent->children, 1);
+	Window* window = node_alloc(NODE_WINDOW);
+	window->parent = WinTree;
+	window->buffer = buf;
+	window->view = buffer_view_open(buf);
+	array_push(&WinTree->children, window);
 
-				node = &parent->children[0];
+	layout_node(WinTree);
 
-				// if child window is down
-				if (childWindow->position.y > focusWinData.position.y) 
-					ypos = focusWinData.position.y;
-				else 
-					ypos = childWindow->position.y;
+	FocusedWindow = window;
+}
 
-				resize_windows_recursively_height(node, ypos, focusWinData.size.h);
+// a node of a tree built from a saved layout, appended to the children of
+// parent, the root when parent is null
+Node*
+window_node_add(Node* parent, NodeType type) {
 
-			}
-		} else {
+	Node* node = node_alloc(type);
+	node->parent = parent;
 
-			if (parent->isVertical) {
-				
-				Window* other;
+	if (parent)
+		array_push(&parent->children, node);
 
-				if (parent->children[0].id == FocusedWindow->id)
-					array_erase(&parent->children, 0);
-				else
-					array_erase(&parent->children, 1);
+	return node;
+}
 
-				other = &parent->children[0];
+// takes a built tree in place of windows_init, its windows have their
+// buffers and views set already
+void
+windows_init_tree(Node* root, Window* focus) {
 
-				if (focusWinData.position.x > other->position.x) {
-					
-					other->size.w += focusWinData.size.w;
-				}
-				else {
-					
-					other->position.x = focusWinData.position.x;
-					other->size.w += focusWinData.size.w;
-				}
+	WinTree = root;
+	WinTree->position.x = 0;
+	WinTree->position.y = 0;
+	WinTree->size.w = TheWidth;
+	WinTree->size.h = TheHeight;
 
-				FocusedWindow = other;
-			} else {
-				
-				Window* other;
+	layout_node(WinTree);
 
-				if (parent->children[0].id == FocusedWindow->id)
-					array_erase(&parent->children, 0);
-				else
-					array_erase(&parent->children, 1);
+	window_focus(focus);
+}
 
-				other = &parent->children[0];
+void
+windows_resize(i32 width, i32 height) {
 
-				if (focusWinData.position.y > other->position.y) {
-					
-					other->size.h += focusWinData.size.h;
-				}
-				else {
-					
-					other->position.y = focusWinData.position.y;
-					other->size.h += focusWinData.size.h;
-				}
+	WinTree->size.w = width;
+	WinTree->size.h = height;
 
-				FocusedWindow = other;
-			}
-		}
+	layout_node(WinTree);
+}
 
-		if (parent->parent != NULL && parent->children.length == 1) {
+void
+window_close() {
 
-			Node* root = parent->parent;
-			b8 isContainer = parent->children[0].nodeType == NODE_CONTAINER;
+	Window* win = FocusedWindow;
+	Node* parent = win->parent;
 
-			// move child children to parent children
-			// delete parent container
-			Array<Node> nodesToMoveUp;
-			Array<Node> toDelete;
+	// the last window stays open
+	if (parent == WinTree && parent->children.length == 1) return;
 
-			if (isContainer) {
-				// if its a container we move parent->children->children
-				// to root
-				nodesToMoveUp = parent->children[0].children;
-				toDelete = parent->children;
-			}
-			else {
-				// if not we only move the window parent->children[0]
-				nodesToMoveUp = parent->children;
-			}
+	sizet index = child_index(parent, win);
+	array_erase(&parent->children, index);
 
+	// the space goes to the sibling before it, or after it for the first
+	Node* neighbour = parent->children[index ? index - 1 : 0];
+	neighbour->weight += win->weight;
+	buffer_view_close(win->buffer, win->view);
+	node_free(win);
 
-			sizet insertIndex = 0;
-			// get parent index
-			for (sizet i = 0; i < root->children.length; ++i) {
+	Window* focus = first_window(neighbour);
+	Node* changed = parent;
 
-				if (&root->children[i] == parent) {
-					insertIndex = i;
-					break;
-				}
-			}
-			// convert parent to 1 window
-			root->children[insertIndex] = nodesToMoveUp[0];
-			root->children[insertIndex].parent = root;
+	if (parent->children.length == 1) {
 
-			if (isContainer) {
+		Node* only = parent->children[0];
 
-				for (sizet i = 1; i < nodesToMoveUp.length; ++i) {
+		if (parent != WinTree) {
 
-					array_insert(&root->children, nodesToMoveUp[i], insertIndex);
-					root->children[insertIndex].parent = root;
-					insertIndex++;
-				}
+			// a container of one is replaced by what it holds, a container
+			// going the same way as the one it lands in joins it
+			Node* grand = parent->parent;
+			sizet at = child_index(grand, parent);
 
-				for (sizet i = 0; i < root->children.length; ++i) {
+			node_lift(grand, at);
+			if (only->nodeType == NODE_CONTAINER && only->isVertical == grand->isVertical)
+				node_lift(grand, at);
 
-					if (root->children[i].nodeType == NODE_CONTAINER) {
+			changed = grand;
+		}
+		else if (only->nodeType == NODE_CONTAINER) {
 
-						for (sizet k = 0; k < root->children[i].children.length; ++k)
-							root->children[i].children[k].parent = &root->children[i];
-					}
-				}
-			}
+			WinTree->isVertical = only->isVertical;
+			node_lift(WinTree, 0);
+		}
+	}
 
+	layout_node(changed);
 
-			array_free(&nodesToMoveUp);
-			if (isContainer)
-				array_free(&toDelete);
+	window_focus(focus);
+}
 
-			FocusedWindow = find_first_window_recursively(root);
+static void
+window_split(b8 vertical) {
 
-		}
-		NORMAL_MSG("--------- \nTREE _______ \n", NULL);
-		print_tree(WinTree);
+	Window* win = FocusedWindow;
 
-	} else if (FocusedWindow->parent->children.length > 2) {
-		// TODO:
-		
-		/*
-		Node* parent = FocusedWindow.parent;
-		Window focusWinData = focusedWindow;
+	if (vertical && win->size.w / 2 <= MIN_WINDOW_WIDTH) return;
+	if (!vertical && win->size.h / 2 <= MIN_WINDOW_HEIGHT) return;
 
-		i32 xpos = BIG_NUMBER;
-		if (parent->isVertical) {
+	Node* parent = win->parent;
 
-			for (sizet i = 0; i < ARRAY_LENGTH(parent->children); ++i) {
+	// a lone window turns its container instead of nesting a new one
+	if (parent->children.length == 1)
+		parent->isVertical = vertical;
 
-				if (parent->children[i].nodeType == NODE_WINDOW) {
-					
-					if (xpos > parent->children[i].position.x) 
-						xpos = parent->children[i].position.x;
-				}
-			}
+	if (parent->isVertical != vertical) {
 
-			for (sizet i = 0; i < ARRAY_LENGTH(parent->children); ++i) {
+		Node* container = node_alloc(NODE_CONTAINER);
+		container->isVertical = vertical;
+		container->parent = parent;
+		container->weight = win->weight;
+		container->position = win->position;
+		container->size = win->size;
 
-				if (parent->children[i].nodeType == NODE_WINDOW) {
+		parent->children[child_index(parent, win)] = container;
 
-					if (parent->children[i].id == focusWinData.id) 
-						array_erase(parent->children, i);
-				}
-			}
+		win->parent = container;
+		win->weight = 1.0f;
+		array_push(&container->children, win);
 
-		}
-		Window* out = find_first_window(parent);
-		*/
+		parent = container;
 	}
 
-}
+	Window* split = node_alloc(NODE_WINDOW);
+	split->parent = parent;
+	split->buffer = win->buffer;
+	split->view = buffer_view_open(win->buffer);
+	split->renderView = win->renderView;
+	split->columnStart = win->columnStart;
+	split->rowStart = win->rowStart;
+	split->softWrap = win->softWrap;
+
+	win->weight /= 2.0f;
+	split->weight = win->weight;
 
+	array_insert(&parent->children, split, child_index(parent, win) + 1);
 
+	layout_node(parent);
+}
 
 void
 window_split_horizontal() {
-	
-	if (FocusedWindow->size.h / 2 <= MIN_WINDOW_HEIGHT) return;
-
-	Node* parent = FocusedWindow->parent;
 
-	if (parent->isVertical) {
-		
-		Array<Window> children;
-		array_init(&children , 2);
-		array_push(&children, *FocusedWindow);
+	window_split(false);
+}
 
-		Vec2i winSize = FocusedWindow->size;
-		Node* container = FocusedWindow;
-		container->nodeType = NODE_CONTAINER;
-		container->isVertical = 0;
-		container->children = children;
-		container->containerSize = winSize;
+void
+window_split_vertical() {
 
-		FocusedWindow = &children[0];
-		FocusedWindow->parent = container;
-		FocusedWindow->size.h /= 2;
+	window_split(true);
+}
 
-		Window newWindow = window_create_empthy();
-		newWindow.position.x = FocusedWindow->position.x;
-		newWindow.position.y = FocusedWindow->position.y + FocusedWindow->size.h;
-		newWindow.size = FocusedWindow->size;
-		newWindow.key = FocusedWindow->key;
-		newWindow.parent = container;
+void
+windows_get_all(Array<Window*>* windows) {
 
-		array_push(&container->children, newWindow);
+	array_init(windows, 10);
 
-		NORMAL_MSG("\n\n TREE \n\n", NULL);
-		print_tree(WinTree);
+	tree_get_windows(WinTree, windows);
+}
 
-		return;
-	}
 
-	Window win;
-	i32 height = 0;
-	i32 ypos = BIG_NUMBER;
-
-	Window* childWindow = find_first_window(parent);
-	ASSERT(childWindow);
-
-	win = window_create_empthy();
-	win.size.w = childWindow->size.w;
-	win.position.x = childWindow->position.x;
-	win.size.h = 0;
-	win.parent = parent;
-	win.key = FocusedWindow->key;
-
-	i32 winCount = 0;
-	i32 focusedwinId = FocusedWindow->id;
-
-	for (sizet i = 0; i < parent->children.length; ++i) {
-
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-
-			winCount++;
-			height += parent->children[i].size.h;
-			if (ypos > parent->children[i].position.y) {
-				ypos = parent->children[i].position.y;
-			}
-			if (parent->children[i].id == FocusedWindow->id) {
-				array_insert(&parent->children, win, i + 1);
-				i++;
-				winCount++;
-			}
-		}
-	}
+i32
+window_visible_lines(Window* win) {
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+	// last line is covered by the status line
+	i32 lines = win->size.h / renderer_font_size() - 1;
+	if (lines < 1)
+		lines = 1;
 
-		if (parent->children[i].nodeType == NODE_CONTAINER) {
+	return lines;
+}
 
-			for (sizet k = 0; k < parent->children[i].children.length; ++k)
-				parent->children[i].children[k].parent = &parent->children[i];
-		}
-	}
+void
+window_scroll_to_line(Window* win, Buffer* buf, i32 line) {
 
-	FocusedWindow = find_window(parent, focusedwinId);
-	ASSERT_MSG(FocusedWindow, "No window with that id in parent->children");
+	i32 visible = window_visible_lines(win);
+	i32 row = fold_row_of_line(buf, line);
+	i32 startRow = fold_row_of_line(buf, win->renderView.start);
 
-	resize_windows_evenly_height(parent, ypos, height, winCount);
+	if (row < startRow)
+		win->renderView.start = fold_visible_line(buf, line);
+	else if (row >= startRow + visible)
+		win->renderView.start = fold_line_of_row(buf, row - visible + 1);
+	else
+		return;
 
-	NORMAL_MSG("\n\n TREE \n\n", NULL);
-	print_tree(WinTree);
+	win->rowStart = 0;
 }
 
+i32
+window_visible_columns(Window* win) {
 
-void
-window_split_vertical() {
-	
-	if (FocusedWindow->size.w / 2 <= MIN_WINDOW_WIDTH) return;
+	f32 advance = buffer_char_advance(' ');
+	if (advance <= 0.0f)
+		return 1;
 
-	Node* parent = FocusedWindow->parent;
+	i32 columns = (i32)(win->size.w / advance) - 1;
+	if (columns < 1)
+		columns = 1;
 
-	if (!parent->isVertical) {
+	return columns;
+}
 
-		Array<Window> children;
-		array_init(&children, 2);
-		array_push(&children, *FocusedWindow);
+i32
+window_rows_before(Window* win, Buffer* buf, i32 line, i32 row) {
 
-		Vec2i winSize = FocusedWindow->size;
-		Node* container = FocusedWindow;
-		container->nodeType = NODE_CONTAINER;
-		container->isVertical = 1;
-		container->children = children;
-		container->containerSize = winSize;
+	if (!win->softWrap)
+		return fold_row_of_line(buf, line) - fold_row_of_line(buf, win->renderView.start);
 
-		FocusedWindow = &children[0];
-		FocusedWindow->parent = container;
-		FocusedWindow->size.w /= 2;
+	if (line < win->renderView.start)
+		return -1;
 
-		Window newWindow = window_create_empthy();
-		newWindow.position.x = FocusedWindow->size.w + FocusedWindow->position.x;
-		newWindow.position.y = FocusedWindow->position.y;
-		newWindow.size = FocusedWindow->size;
-		newWindow.key = FocusedWindow->key;
-		newWindow.parent = container;
+	i32 rows = row - win->rowStart;
+	for (i32 i = win->renderView.start; i < line; i = fold_next_line(buf, i))
+		rows += wrap_row_count(buf, i, win->size.w);
 
-		array_push(&container->children, newWindow);
+	return rows;
+}
+
+static void
+scroll_to_cursor_wrapped(Window* win, Buffer* buf) {
 
-		NORMAL_MSG("\n\n TREE \n\n", NULL);
-		print_tree(WinTree);
+	i32 line = buf->currentLine;
+	WrapLine* wrap = wrap_line_get(buf, line, win->size.w);
+	i32 row = wrap_row_of_offset(wrap, buf->curX);
+	i32 visible = window_visible_lines(win);
 
+	if (win->renderView.start < (i32)buf->lineLengths.length &&
+		win->rowStart >= wrap_row_count(buf, win->renderView.start, win->size.w))
+		win->rowStart = 0;
+
+	if (line < win->renderView.start ||
+		(line == win->renderView.start && row < win->rowStart)) {
+
+		win->renderView.start = line;
+		win->rowStart = row;
 		return;
 	}
 
-	Window win;
-	i32 width = 0;
-	i32 xpos = BIG_NUMBER;
-
-	Window* childWindow = find_first_window(parent);
-	ASSERT(childWindow);
-
-	win = window_create_empthy();
-	win.size.w = 0;
-	win.size.h = childWindow->size.h;
-	win.position.y = childWindow->position.y;
-	win.parent = parent;
-	win.key = FocusedWindow->key;
-
-	i32 winCount = 0;
-	i32 focusedwinId = FocusedWindow->id;
-
-	for (sizet i = 0; i < parent->children.length; ++i) {
-
-		if (parent->children[i].nodeType == NODE_WINDOW) {
-
-			winCount++;
-			width += parent->children[i].size.w;
-			if (xpos > parent->children[i].position.x) {
-				xpos = parent->children[i].position.x;
-			}
-			if (parent->children[i].id == FocusedWindow->id) {
-				array_insert(&parent->children, win, i + 1);
-				i++;
-				winCount++;
-			}
-			
+	// lines are at least one row, only count when the cursor might be visible
+	if (fold_row_of_line(buf, line) - fold_row_of_line(buf, win->renderView.start) < visible &&
+		window_rows_before(win, buf, line, row) < visible)
+		return;
+
+	// walk back from the cursor to the row that puts it at the bottom
+	for (i32 count = visible - 1; count > 0; --count) {
+
+		if (row > 0) {
+			row--;
+		}
+		else {
+			line = fold_prev_line(buf, line);
+			row = wrap_row_count(buf, line, win->size.w) - 1;
 		}
 	}
 
-	for (sizet i = 0; i < parent->children.length; ++i) {
+	win->renderView.start = line;
+	win->rowStart = row;
+}
+
+void
+window_scroll_to_cursor(Window* win, Buffer* buf) {
 
-		if (parent->children[i].nodeType == NODE_CONTAINER) {
+	// a jump into a fold opens it, a fold over the top line shows its header
+	fold_reveal(buf, buf->currentLine);
+	win->renderView.start = fold_visible_line(buf, win->renderView.start);
 
-			for (sizet k = 0; k < parent->children[i].children.length; ++k)
-				parent->children[i].children[k].parent = &parent->children[i];
-		}
-	}
+	if (win->softWrap) {
 
-	FocusedWindow = find_window(parent, focusedwinId);
-	ASSERT_MSG(FocusedWindow, "No window with that id in parent->children");
+		win->columnStart = 0;
+		scroll_to_cursor_wrapped(win, buf);
+		return;
+	}
 
-	resize_windows_evenly_width(parent, xpos, width, winCount);
+	window_scroll_to_line(win, buf, buf->currentLine);
 
-	NORMAL_MSG("\n\n TREE \n\n", NULL);
-	print_tree(WinTree);
+	i32 visible = window_visible_columns(win);
 
+	if (buf->cursorXtabed < win->columnStart)
+		win->columnStart = buf->cursorXtabed;
+	else if (buf->cursorXtabed >= win->columnStart + visible)
+		win->columnStart = buf->cursorXtabed - visible + 1;
 }
 
-static void
-tree_get_windows(Node* node, Array<Window>* windows) {
-
-	for (sizet i = 0; i < node->children.length; ++i) {
-		
-		if (node->children[i].nodeType == NODE_WINDOW) 
-			array_push(windows, node->children[i]);
-		else 
-			tree_get_windows(&node->children[i], windows);
-	}
+void
+window_toggle_wrap() {
 
+	FocusedWindow->softWrap = !FocusedWindow->softWrap;
+	FocusedWindow->columnStart = 0;
+	FocusedWindow->rowStart = 0;
 }
 
+// keeps the windows on buf over the same text after lines were taken off
+// or put in above it
 void
-windows_get_all(Array<Window>* windows) {
+windows_shift_lines(Buffer* buf, i64 lines) {
 
-	array_init(windows, 10);
+	if (!lines) return;
 
-	tree_get_windows(WinTree, windows);
-}
+	Array<Window*> windows;
+	windows_get_all(&windows);
+
+	i64 last = (i64)buf->lineLengths.length - 1;
+	for (sizet i = 0; i < windows.length; ++i) {
 
+		Window* win = windows[i];
+		if (win->buffer != buf) continue;
+
+		i64 start = win->renderView.start + lines;
+		win->renderView.start = (i32)(start < 0 ? 0 : start > last ? last : start);
+		if (start < 0 || start > last)
+			win->rowStart = 0;
+	}
+
+	array_free(&windows);
+}
 
 i32
 new_window_id() {
@@ -739,28 +702,31 @@ print_tree(Node* node) {
 	ALERT_MSG("---- Container ---- \n", NULL);
 	NORMAL_MSG("Adress : %p \n", node, NULL);
 	NORMAL_MSG("Parent : %p \n", node->parent);
-	NORMAL_MSG("Children : %p \n", node->children);
 	NORMAL_MSG("Is Vertical : %i \n", node->isVertical);
+	NORMAL_MSG("Weight : %f \n", node->weight);
 	NORMAL_MSG("Children count : %zu \n", node->children.length);
 	NORMAL_MSG("Size : ", NULL);
-	vec2i_print(node->containerSize);
+	vec2i_print(node->size);
 
 	for (sizet i = 0; i < node->children.length; ++i)  {
 
-		if (node->children[i].nodeType == NODE_WINDOW) {
+		Node* child = node->children[i];
+
+		if (child->nodeType == NODE_WINDOW) {
 			NORMAL_MSG("\n", NULL);
 			ALERT_MSG("---- Window ----\n", NULL);
-			NORMAL_MSG("Adress : %p \n", &node->children[i]);
-			NORMAL_MSG("Parent : %p \n", node->children[i].parent);
-			NORMAL_MSG("Buffer key : %s \n", node->children[i].key);
-			NORMAL_MSG("id : %i \n", node->children[i].id);
+			NORMAL_MSG("Adress : %p \n", child);
+			NORMAL_MSG("Parent : %p \n", child->parent);
+			NORMAL_MSG("Buffer : %s \n", child->buffer->name.as_cstr());
+			NORMAL_MSG("id : %i \n", child->id);
+			NORMAL_MSG("Weight : %f \n", child->weight);
 			NORMAL_MSG("Position :", NULL);
-			vec2i_print(node->children[i].position);
+			vec2i_print(child->position);
 			NORMAL_MSG("Size :", NULL);
-			vec2i_print(node->children[i].size);
+			vec2i_print(child->size);
 		}
 		else {
-			print_tree(&node->children[i]);
+			print_tree(child);
 		}
 	}
 
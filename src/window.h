@@ -20,24 +20,39 @@ typedef enum NodeType {
 	
 } NodeType;
 
+struct Buffer;
+
 typedef struct Node {
   
+	NodeType nodeType;
+	struct Node* parent;
+
+	// rect from the last layout of the container the node is in
+	Vec2i position;
+	Vec2i size;
+	// share of the parent's width or height, the shares of siblings add to 1
+	f32 weight;
+
 	union {
 		struct {
 			i32 id;
 			Vec2i renderView;
-			Vec2i position;
-			Vec2i size;
-			char* key;
+			// shown in the window, stays valid while the buffer is open
+			struct Buffer* buffer;
+			// its own cursors in the buffer, see BufferView
+			i32 view;
+			// first visible tabbed column
+			i32 columnStart;
+			// first visible row of renderView.start when soft wrapping
+			i32 rowStart;
+			b8 softWrap;
 		};
 		struct {
 			b8 isVertical;
-			Vec2i containerSize;
-			struct Array<Node> children;
+			// nodes never move, a container holds them by pointer
+			struct Array<Node*> children;
 		};
 	};
-	NodeType nodeType;
-	struct Node* parent;
 
 } Node;
 
@@ -47,18 +62,30 @@ typedef Node Window;
 typedef Node* WindowArray;
 
 
-struct Buffer;
 void window_split_vertical();
 void window_split_horizontal();
+Window* window_at_point(Vec2i point);
+Window* window_neighbour(Window* win, WinDirection direction);
+void window_focus(Window* win);
+void window_set_buffer(Window* win, Buffer* buf);
 void window_switch_up();
 void window_switch_down();
 void window_switch_left();
 void window_switch_right();
 void window_close();
-Window window_create_empthy();
 void windows_init(Buffer* buf);
-void windows_get_all(Array<Window>* windows);
+Node* window_node_add(Node* parent, NodeType type);
+void windows_init_tree(Node* root, Window* focus);
+void windows_resize(i32 width, i32 height);
+void windows_get_all(Array<Window*>* windows);
 void print_tree(Node* node);
 i32 new_window_id();
+i32 window_visible_lines(Window* win);
+void window_scroll_to_line(Window* win, Buffer* buf, i32 line);
+i32 window_visible_columns(Window* win);
+void window_scroll_to_cursor(Window* win, Buffer* buf);
+i32 window_rows_before(Window* win, Buffer* buf, i32 line, i32 row);
+void window_toggle_wrap();
+void windows_shift_lines(Buffer* buf, i64 lines);
 
 void window_render_all();
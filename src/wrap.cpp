@@ -0,0 +1,137 @@
+#include "wrap.h"
+#include "buffer.h"
+#include "container.h"
+#include "debug.h"
+
+
+static void
+wrap_line_layout(Buffer* buf, WrapLine* wrap, i32 line, f32 width) {
+
+	array_reset(&wrap->rows);
+
+	WrapRow row = {0, 0.0f};
+	array_push(&wrap->rows, row);
+
+	sizet start = buffer_index_based_on_line(buf, line);
+	sizet bufLength = buffer_length(buf);
+	i32 length = buf->lineLengths[line];
+
+	f32 pixelX = 0.0f;
+	i32 lastSpace = -1;
+	f32 lastSpaceX = 0.0f;
+
+	for (i32 i = 0; i < length && start + i < bufLength; ++i) {
+
+		char c = buffer_char_at(buf, start + i);
+		if (c == '\n')
+			break;
+
+		f32 advance = buffer_char_advance(c);
+
+		if (pixelX + advance - row.pixelX > width && i > row.offset) {
+
+			// prefer breaking after the last space on the row
+			if (lastSpace >= row.offset) {
+				row.offset = lastSpace + 1;
+				row.pixelX = lastSpaceX;
+			}
+			else {
+				row.offset = i;
+				row.pixelX = pixelX;
+			}
+
+			array_push(&wrap->rows, row);
+			lastSpace = -1;
+		}
+
+		pixelX += advance;
+
+		if (c == ' ' || c == '\t') {
+			lastSpace = i;
+			lastSpaceX = pixelX;
+		}
+	}
+
+	wrap->line = line;
+	wrap->width = width;
+	wrap->generation = buffers_font_generation();
+}
+
+WrapLine*
+wrap_line_get(Buffer* buf, i32 line, f32 width) {
+
+	if (!buf->wrapCache) {
+
+		buf->wrapCache = (WrapLine*)calloc(WRAP_CACHE_SIZE, sizeof(WrapLine));
+		for (sizet i = 0; i < WRAP_CACHE_SIZE; ++i) {
+
+			buf->wrapCache[i].line = -1;
+			array_init(&buf->wrapCache[i].rows, 1);
+		}
+	}
+
+	WrapLine* wrap = &buf->wrapCache[line % WRAP_CACHE_SIZE];
+
+	// only lines that are asked for get laid out, so a resize costs
+	// nothing until a line is drawn again
+	if (wrap->line != line ||
+		wrap->width != width ||
+		wrap->generation != buffers_font_generation()) {
+
+		wrap_line_layout(buf, wrap, line, width);
+	}
+
+	return wrap;
+}
+
+i32
+wrap_row_count(Buffer* buf, i32 line, f32 width) {
+
+	return wrap_line_get(buf, line, width)->rows.length;
+}
+
+i32
+wrap_row_of_offset(WrapLine* wrap, i32 offset) {
+
+	sizet low = 0;
+	sizet high = wrap->rows.length;
+
+	while (high - low > 1) {
+
+		sizet mid = (low + high) / 2;
+		if (wrap->rows[mid].offset <= offset)
+			low = mid;
+		else
+			high = mid;
+	}
+
+	return (i32)low;
+}
+
+i32
+wrap_row_end(Buffer* buf, WrapLine* wrap, i32 row) {
+
+	if (row + 1 < (i32)wrap->rows.length)
+		return wrap->rows[row + 1].offset;
+
+	return buf->lineLengths[wrap->line];
+}
+
+void
+wrap_cache_invalidate(Buffer* buf, i32 line) {
+
+	if (!buf->wrapCache) return;
+
+	WrapLine* wrap = &buf->wrapCache[line % WRAP_CACHE_SIZE];
+	if (wrap->line == line)
+		wrap->line = -1;
+}
+
+void
+wrap_cache_reset(Buffer* buf) {
+
+	if (!buf->wrapCache) return;
+
+	for (sizet i = 0; i < WRAP_CACHE_SIZE; ++i)
+		buf->wrapCache[i].line = -1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "types.h"
+
+struct Buffer;
+struct WrapLine;
+
+WrapLine* wrap_line_get(Buffer* buf, i32 line, f32 width);
+i32 wrap_row_count(Buffer* buf, i32 line, f32 width);
+i32 wrap_row_of_offset(WrapLine* wrap, i32 offset);
+i32 wrap_row_end(Buffer* buf, WrapLine* wrap, i32 row);
+void wrap_cache_invalidate(Buffer* buf, i32 line);
+void wrap_cache_reset(Buffer* buf);